@@ -0,0 +1,669 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * cache.c  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+/* INCLUDES BEGIN */
+
+// Library includes
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <errno.h>
+#include <string.h>
+
+// Woofer core includes
+#include <woofer/song.h>
+
+// Module includes
+#include "cache.h"
+
+// Dependency includes
+/*< none >*/
+
+// Resource includes
+/*< none >*/
+
+/* INCLUDES END */
+
+/* DESCRIPTION BEGIN */
+
+/*
+ * This module remembers the size and modification time of the file of every
+ * song at the time its metadata was last read.  A file with the same size
+ * and modification time has not changed since, so its metadata does not need
+ * to be read again; Checking that only takes a stat instead of reading the
+ * file.  The cache is stored in the user cache directory as a binary file:
+ * a header (magic, version and amount of entries) followed by the entries,
+ * each holding the length of the URI, the URI, the size and the modification
+ * time.  All numbers are stored little-endian.
+ *
+ * Location specific notes:
+ * [1] A file is only known to be up-to-date once the back-end has actually
+ *     read its metadata, which happens later on the main thread.  So the
+ *     worker threads that look at the files only stage the new size and
+ *     time, and they enter the cache once the metadata has been read.
+ *     Every operation stages its entries under its own stage, so only the
+ *     entries of files the operation had read are committed.  Staged
+ *     entries of an operation that was cancelled are discarded, and worker
+ *     threads that keep on staging after that are ignored, as their stage
+ *     is closed.
+ * [2] The cache is used by worker threads, so every access is guarded by a
+ *     mutex.  Worker threads are not always joined before shutdown (see
+ *     importer.c), so the mutex is static and never cleared, and the tables
+ *     are only checked for and taken away while holding it.  A worker that
+ *     comes late finds no tables and does nothing.
+ * [3] An entry is only valid while its song is in the library, as a file
+ *     that is in the cache is considered to be in the library already.  So
+ *     entries are removed together with their songs, and entries of songs
+ *     that are not in the library (anymore) are pruned at startup.
+ * [4] Songs that were added before the cache existed have no entry.  Their
+ *     files are not known to have changed, so looking for changes enters
+ *     their current size and time, instead of having all of them read
+ *     again.
+ */
+
+/* DESCRIPTION END */
+
+/* DEFINES BEGIN */
+
+// Location of the cache within the user cache directory
+#define CACHE_DIR_NAME "woofer-gtk"
+#define CACHE_FILE_NAME "files"
+
+// First bytes of the file and version of its layout
+#define CACHE_MAGIC "WGFC"
+#define CACHE_MAGIC_LENGTH 4
+#define CACHE_VERSION 1
+
+/* DEFINES END */
+
+/* CUSTOM TYPES BEGIN */
+
+typedef struct _CacheEntry CacheEntry;
+typedef struct _CacheDetails CacheDetails;
+
+struct _CacheEntry
+{
+	guint64 size;
+	// Modification time in microseconds
+	gint64 mtime;
+	// Stage the entry belongs to while it is staged (see note [1] at module description)
+	guint stage;
+};
+
+struct _CacheDetails
+{
+	gchar *path;
+
+	// Map of URIs to their CacheEntry
+	GHashTable *entries;
+	// Entries waiting to be committed (see note [1] at module description)
+	GHashTable *staged;
+	// Set of stages that are open
+	GHashTable *stages;
+	guint last_stage;
+
+	// Whether the entries changed since they were written
+	gboolean changed;
+};
+
+/* CUSTOM TYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+static void interface_cache_read(void);
+static gboolean interface_cache_get_info(GFileInfo *info, CacheEntry *entry);
+static void interface_cache_close_stage(guint stage, gboolean commit);
+static gboolean interface_cache_read_uint32(const guchar **data, const guchar *end, guint32 *value);
+static gboolean interface_cache_read_uint64(const guchar **data, const guchar *end, guint64 *value);
+
+/* FUNCTION PROTOTYPES END */
+
+/* GLOBAL VARIABLES BEGIN */
+
+static CacheDetails CacheData = { 0 };
+
+// Never cleared (see note [2] at module description)
+static GMutex CacheLock;
+
+/* GLOBAL VARIABLES END */
+
+/* CONSTRUCTORS BEGIN */
+
+void
+interface_cache_init(void)
+{
+	gchar *dir;
+
+	dir = g_build_filename(g_get_user_cache_dir(), CACHE_DIR_NAME, NULL /* terminator */);
+
+	if (g_mkdir_with_parents(dir, 0700) != 0)
+	{
+		g_warning("Failed to create directory %s: %s", dir, g_strerror(errno));
+	}
+
+	CacheData.path = g_build_filename(dir, CACHE_FILE_NAME, NULL /* terminator */);
+
+	g_free(dir);
+
+	g_mutex_lock(&CacheLock);
+
+	CacheData.entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	CacheData.staged = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	CacheData.stages = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	// No worker runs yet, but keep every access to the tables under the lock
+	interface_cache_read();
+
+	g_mutex_unlock(&CacheLock);
+}
+
+/* CONSTRUCTORS END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+// Whether the file of @uri has the same size and modification time as when its metadata was read
+gboolean
+interface_cache_is_unchanged(const gchar *uri, GFileInfo *info)
+{
+	CacheEntry current, *entry;
+	gboolean unchanged = FALSE;
+
+	g_return_val_if_fail(uri != NULL, FALSE);
+
+	if (!interface_cache_get_info(info, &current))
+	{
+		return FALSE;
+	}
+
+	g_mutex_lock(&CacheLock);
+
+	// See note [2] at module description
+	entry = (CacheData.entries != NULL) ? g_hash_table_lookup(CacheData.entries, uri) : NULL;
+
+	if (entry != NULL)
+	{
+		unchanged = (entry->size == current.size && entry->mtime == current.mtime);
+	}
+
+	g_mutex_unlock(&CacheLock);
+
+	return unchanged;
+}
+
+// Enter the file of @uri if it has no entry yet; Returns %TRUE if it had none (see note [4] at module description)
+gboolean
+interface_cache_seed(const gchar *uri, GFileInfo *info)
+{
+	CacheEntry *entry;
+	gboolean seeded = FALSE;
+
+	g_return_val_if_fail(uri != NULL, FALSE);
+
+	entry = g_new(CacheEntry, 1);
+
+	if (!interface_cache_get_info(info, entry))
+	{
+		g_free(entry);
+		return FALSE;
+	}
+
+	g_mutex_lock(&CacheLock);
+
+	// See note [2] at module description
+	if (CacheData.entries != NULL && !g_hash_table_contains(CacheData.entries, uri))
+	{
+		g_hash_table_insert(CacheData.entries, g_strdup(uri), entry);
+		CacheData.changed = TRUE;
+		seeded = TRUE;
+		entry = NULL;
+	}
+
+	g_mutex_unlock(&CacheLock);
+
+	g_free(entry);
+
+	return seeded;
+}
+
+// Open a stage for an operation that is about to read files (see note [1] at module description)
+guint
+interface_cache_stage_begin(void)
+{
+	guint stage;
+
+	g_mutex_lock(&CacheLock);
+
+	// Zero is never a stage
+	do
+	{
+		stage = ++CacheData.last_stage;
+	}
+	while (stage == 0);
+
+	if (CacheData.stages != NULL)
+	{
+		g_hash_table_add(CacheData.stages, GUINT_TO_POINTER(stage));
+	}
+
+	g_mutex_unlock(&CacheLock);
+
+	return stage;
+}
+
+// Remember the size and modification time of a file whose metadata is about to be read (see note [1] at module description)
+void
+interface_cache_stage(guint stage, const gchar *uri, GFileInfo *info)
+{
+	CacheEntry *entry;
+
+	g_return_if_fail(uri != NULL);
+
+	entry = g_new(CacheEntry, 1);
+
+	if (!interface_cache_get_info(info, entry))
+	{
+		g_free(entry);
+		return;
+	}
+
+	g_mutex_lock(&CacheLock);
+
+	entry->stage = stage;
+
+	// See notes [1] and [2] at module description
+	if (CacheData.stages != NULL && g_hash_table_contains(CacheData.stages, GUINT_TO_POINTER(stage)))
+	{
+		g_hash_table_insert(CacheData.staged, g_strdup(uri), entry);
+		entry = NULL;
+	}
+
+	g_mutex_unlock(&CacheLock);
+
+	g_free(entry);
+}
+
+// The metadata of @uri has been read; Enter its entry staged in @stage in the cache
+void
+interface_cache_commit(guint stage, const gchar *uri)
+{
+	gpointer key, entry;
+
+	g_return_if_fail(uri != NULL);
+
+	g_mutex_lock(&CacheLock);
+
+	if (CacheData.staged != NULL && g_hash_table_lookup_extended(CacheData.staged, uri, &key, &entry) &&
+	    ((CacheEntry *) entry)->stage == stage)
+	{
+		g_hash_table_steal(CacheData.staged, key);
+		g_hash_table_insert(CacheData.entries, key, entry);
+		CacheData.changed = TRUE;
+	}
+
+	g_mutex_unlock(&CacheLock);
+}
+
+// The metadata of all files staged in @stage has been read; Closes @stage
+void
+interface_cache_commit_all(guint stage)
+{
+	interface_cache_close_stage(stage, TRUE);
+}
+
+// Forget the entries staged in @stage, as their metadata has not been read; Closes @stage
+void
+interface_cache_discard(guint stage)
+{
+	interface_cache_close_stage(stage, FALSE);
+}
+
+// Forget the file of a song that is removed from the library (see note [3] at module description)
+void
+interface_cache_remove(const gchar *uri)
+{
+	if (uri == NULL)
+	{
+		return;
+	}
+
+	g_mutex_lock(&CacheLock);
+
+	if (CacheData.entries != NULL && g_hash_table_remove(CacheData.entries, uri))
+	{
+		CacheData.changed = TRUE;
+	}
+
+	g_mutex_unlock(&CacheLock);
+}
+
+// Forget the files that are not in the library (see note [3] at module description)
+void
+interface_cache_prune(void)
+{
+	GHashTableIter iter;
+	GHashTable *uris;
+	gpointer key;
+	WfSong *song;
+	guint pruned = 0;
+
+	uris = g_hash_table_new(g_str_hash, g_str_equal);
+
+	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
+	{
+		if (wf_song_get_uri(song) != NULL)
+		{
+			g_hash_table_add(uris, (gpointer) wf_song_get_uri(song));
+		}
+	}
+
+	g_mutex_lock(&CacheLock);
+
+	if (CacheData.entries != NULL)
+	{
+		g_hash_table_iter_init(&iter, CacheData.entries);
+
+		while (g_hash_table_iter_next(&iter, &key, NULL /* value */))
+		{
+			if (!g_hash_table_contains(uris, key))
+			{
+				g_hash_table_iter_remove(&iter);
+				pruned++;
+			}
+		}
+	}
+
+	CacheData.changed |= (pruned > 0);
+
+	g_mutex_unlock(&CacheLock);
+
+	g_hash_table_destroy(uris);
+
+	g_debug("Pruned %u entries from the file cache", pruned);
+}
+
+// Write the cache file if anything changed; Returns %FALSE if writing failed
+gboolean
+interface_cache_write(void)
+{
+	GHashTableIter iter;
+	GByteArray *data;
+	GError *error = NULL;
+	gpointer key, value;
+	CacheEntry *entry;
+	guint32 length;
+	guint64 number;
+	gboolean success;
+
+	g_mutex_lock(&CacheLock);
+
+	if (CacheData.entries == NULL || CacheData.path == NULL || !CacheData.changed)
+	{
+		g_mutex_unlock(&CacheLock);
+		return TRUE;
+	}
+
+	data = g_byte_array_new();
+
+	g_byte_array_append(data, (const guint8 *) CACHE_MAGIC, CACHE_MAGIC_LENGTH);
+	length = GUINT32_TO_LE(CACHE_VERSION);
+	g_byte_array_append(data, (const guint8 *) &length, sizeof(length));
+	length = GUINT32_TO_LE(g_hash_table_size(CacheData.entries));
+	g_byte_array_append(data, (const guint8 *) &length, sizeof(length));
+
+	g_hash_table_iter_init(&iter, CacheData.entries);
+
+	while (g_hash_table_iter_next(&iter, &key, &value))
+	{
+		entry = value;
+
+		length = GUINT32_TO_LE(strlen(key));
+		g_byte_array_append(data, (const guint8 *) &length, sizeof(length));
+		g_byte_array_append(data, key, strlen(key));
+
+		number = GUINT64_TO_LE(entry->size);
+		g_byte_array_append(data, (const guint8 *) &number, sizeof(number));
+		number = GUINT64_TO_LE((guint64) entry->mtime);
+		g_byte_array_append(data, (const guint8 *) &number, sizeof(number));
+	}
+
+	CacheData.changed = FALSE;
+
+	g_mutex_unlock(&CacheLock);
+
+	success = g_file_set_contents(CacheData.path, (const gchar *) data->data, data->len, &error);
+
+	if (!success)
+	{
+		g_warning("Failed to write file cache: %s", error->message);
+		g_error_free(error);
+	}
+
+	g_byte_array_unref(data);
+
+	return success;
+}
+
+/* MODULE FUNCTIONS END */
+
+/* MODULE UTILITIES BEGIN */
+
+static void
+interface_cache_read(void)
+{
+	const guchar *data, *end;
+	CacheEntry *entry;
+	GError *error = NULL;
+	gchar *contents = NULL;
+	gchar *uri;
+	gsize size = 0;
+	guint32 version, count, length, i;
+	guint64 mtime;
+
+	if (!g_file_get_contents(CacheData.path, &contents, &size, &error))
+	{
+		if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+		{
+			g_warning("Failed to read file cache: %s", error->message);
+		}
+
+		g_error_free(error);
+
+		return;
+	}
+
+	data = (const guchar *) contents;
+	end = data + size;
+
+	if (size < CACHE_MAGIC_LENGTH || memcmp(data, CACHE_MAGIC, CACHE_MAGIC_LENGTH) != 0)
+	{
+		g_warning("Ignoring invalid file cache");
+		g_free(contents);
+		return;
+	}
+
+	data += CACHE_MAGIC_LENGTH;
+
+	if (!interface_cache_read_uint32(&data, end, &version) || version != CACHE_VERSION ||
+	    !interface_cache_read_uint32(&data, end, &count))
+	{
+		g_info("Ignoring file cache of another version");
+		g_free(contents);
+		return;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		if (!interface_cache_read_uint32(&data, end, &length) || length > (gsize) (end - data))
+		{
+			break;
+		}
+
+		uri = g_strndup((const gchar *) data, length);
+		data += length;
+
+		entry = g_new(CacheEntry, 1);
+
+		if (!interface_cache_read_uint64(&data, end, &entry->size) ||
+		    !interface_cache_read_uint64(&data, end, &mtime))
+		{
+			g_free(entry);
+			g_free(uri);
+			break;
+		}
+
+		entry->mtime = (gint64) mtime;
+		entry->stage = 0;
+
+		g_hash_table_insert(CacheData.entries, uri, entry);
+	}
+
+	if (i < count)
+	{
+		g_warning("File cache is truncated, read %u of %u entries", i, count);
+	}
+
+	g_free(contents);
+}
+
+static void
+interface_cache_close_stage(guint stage, gboolean commit)
+{
+	GHashTableIter iter;
+	gpointer key, entry;
+
+	g_mutex_lock(&CacheLock);
+
+	if (CacheData.stages == NULL || !g_hash_table_remove(CacheData.stages, GUINT_TO_POINTER(stage)))
+	{
+		g_mutex_unlock(&CacheLock);
+		return;
+	}
+
+	g_hash_table_iter_init(&iter, CacheData.staged);
+
+	while (g_hash_table_iter_next(&iter, &key, &entry))
+	{
+		if (((CacheEntry *) entry)->stage != stage)
+		{
+			continue;
+		}
+
+		if (commit)
+		{
+			g_hash_table_iter_steal(&iter);
+			g_hash_table_insert(CacheData.entries, key, entry);
+			CacheData.changed = TRUE;
+		}
+		else
+		{
+			g_hash_table_iter_remove(&iter);
+		}
+	}
+
+	g_mutex_unlock(&CacheLock);
+}
+
+static gboolean
+interface_cache_get_info(GFileInfo *info, CacheEntry *entry)
+{
+	if (info == NULL ||
+	    !g_file_info_has_attribute(info, G_FILE_ATTRIBUTE_STANDARD_SIZE) ||
+	    !g_file_info_has_attribute(info, G_FILE_ATTRIBUTE_TIME_MODIFIED))
+	{
+		return FALSE;
+	}
+
+	entry->size = g_file_info_get_attribute_uint64(info, G_FILE_ATTRIBUTE_STANDARD_SIZE);
+	entry->mtime = (gint64) g_file_info_get_attribute_uint64(info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+	               g_file_info_get_attribute_uint32(info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+	entry->stage = 0;
+
+	return TRUE;
+}
+
+static gboolean
+interface_cache_read_uint32(const guchar **data, const guchar *end, guint32 *value)
+{
+	if ((gsize) (end - *data) < sizeof(guint32))
+	{
+		return FALSE;
+	}
+
+	memcpy(value, *data, sizeof(guint32));
+	*value = GUINT32_FROM_LE(*value);
+	*data += sizeof(guint32);
+
+	return TRUE;
+}
+
+static gboolean
+interface_cache_read_uint64(const guchar **data, const guchar *end, guint64 *value)
+{
+	if ((gsize) (end - *data) < sizeof(guint64))
+	{
+		return FALSE;
+	}
+
+	memcpy(value, *data, sizeof(guint64));
+	*value = GUINT64_FROM_LE(*value);
+	*data += sizeof(guint64);
+
+	return TRUE;
+}
+
+/* MODULE UTILITIES END */
+
+/* DESTRUCTORS BEGIN */
+
+void
+interface_cache_finalize(void)
+{
+	GHashTable *entries, *staged, *stages;
+
+	interface_cache_write();
+
+	// Take the tables away first, so workers that are still running leave them alone (see note [2] at module description)
+	g_mutex_lock(&CacheLock);
+
+	entries = CacheData.entries;
+	staged = CacheData.staged;
+	stages = CacheData.stages;
+
+	CacheData.entries = NULL;
+	CacheData.staged = NULL;
+	CacheData.stages = NULL;
+	CacheData.changed = FALSE;
+
+	g_mutex_unlock(&CacheLock);
+
+	if (entries != NULL)
+	{
+		g_hash_table_destroy(entries);
+		g_hash_table_destroy(staged);
+		g_hash_table_destroy(stages);
+	}
+
+	g_clear_pointer(&CacheData.path, g_free);
+}
+
+/* DESTRUCTORS END */
+
+/* END OF FILE */
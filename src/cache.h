@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * cache.h  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+#ifndef __CACHE__
+#define __CACHE__
+
+/* INCLUDES BEGIN */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+/* INCLUDES END */
+
+/* DEFINES BEGIN */
+
+// Attributes interface_cache_is_unchanged(), interface_cache_seed() and interface_cache_stage() need
+#define INTERFACE_CACHE_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+                                   G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+                                   G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC
+
+/* DEFINES END */
+
+/* MODULE TYPES BEGIN */
+/* MODULE TYPES END */
+
+/* CONSTRUCTOR PROTOTYPES BEGIN */
+
+void interface_cache_init(void);
+
+/* CONSTRUCTOR PROTOTYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+gboolean interface_cache_is_unchanged(const gchar *uri, GFileInfo *info);
+gboolean interface_cache_seed(const gchar *uri, GFileInfo *info);
+guint interface_cache_stage_begin(void);
+void interface_cache_stage(guint stage, const gchar *uri, GFileInfo *info);
+void interface_cache_commit(guint stage, const gchar *uri);
+void interface_cache_commit_all(guint stage);
+void interface_cache_discard(guint stage);
+void interface_cache_remove(const gchar *uri);
+void interface_cache_prune(void);
+gboolean interface_cache_write(void);
+
+/* FUNCTION PROTOTYPES END */
+
+/* DESTRUCTOR PROTOTYPES BEGIN */
+
+void interface_cache_finalize(void);
+
+/* DESTRUCTOR PROTOTYPES END */
+
+#endif /* __CACHE__ */
+
+/* END OF FILE */
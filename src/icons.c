@@ -52,18 +52,52 @@
  * constructors, destructors, etc are left out.
  */
 
+/*
+ * Location specific notes:
+ * [1] Themed icons that are drawn for many rows (like the status icons in the
+ *     library) are cached by name, size and scale factor, so every row can
+ *     share the same image instead of looking it up in the icon theme again.
+ *     Looking up an icon is done for every row that is drawn, so it doesn't
+ *     allocate anything, and icons that failed to load are remembered as
+ *     well, so a missing icon is only warned about once.  The cache is
+ *     cleared and all windows are redrawn when the icon theme changes, so
+ *     the icons of the new theme are loaded.
+ */
+
 /* DESCRIPTION END */
 
 /* DEFINES BEGIN */
+
+// Key of an icon of a size and scale factor within the table of its name
+#define ICONS_CACHE_KEY(size, scale) GUINT_TO_POINTER(((guint) (size) << 8) | ((guint) (scale) & 0xff))
+
 /* DEFINES END */
 
 /* CUSTOM TYPES BEGIN */
+
+typedef struct _IconsCacheItem IconsCacheItem;
+
+struct _IconsCacheItem
+{
+	GdkPixbuf *pixbuf;
+	cairo_surface_t *surface;
+};
+
 /* CUSTOM TYPES END */
 
 /* FUNCTION PROTOTYPES BEGIN */
+
+static IconsCacheItem * icons_cache_lookup(const gchar *icon_name, gint size, gint scale);
+static void icons_cache_item_free(gpointer data);
+static void icons_theme_changed_cb(GtkIconTheme *icon_theme, gpointer user_data);
+
 /* FUNCTION PROTOTYPES END */
 
 /* GLOBAL VARIABLES BEGIN */
+
+// Cached themed icons; Maps names to tables of sizes and scale factors (see note [1] at module description)
+static GHashTable *IconsCache = NULL;
+
 /* GLOBAL VARIABLES END */
 
 /* MODULE FUNCTIONS BEGIN */
@@ -79,7 +113,7 @@ icons_get_themed_image(const gchar *icon_name)
 	g_return_val_if_fail(icon_name != NULL, NULL);
 
 	icon_theme = gtk_icon_theme_get_default();
-	pixbuf = gtk_icon_theme_load_icon(icon_theme, icon_name, 16, 0, &error);
+	pixbuf = gtk_icon_theme_load_icon(icon_theme, icon_name, ICONS_THEMED_SIZE, 0, &error);
 
 	if (error != NULL)
 	{
@@ -120,6 +154,152 @@ icons_get_static_image(const gchar *resource_path)
 	return image;
 }
 
+// Get a cached themed icon; The returned pixbuf is owned by the cache, do not unref
+GdkPixbuf *
+icons_get_cached_image(const gchar *icon_name, gint size, gint scale)
+{
+	IconsCacheItem *item;
+
+	g_return_val_if_fail(icon_name != NULL, NULL);
+
+	item = icons_cache_lookup(icon_name, size, scale);
+
+	return (item == NULL) ? NULL : item->pixbuf;
+}
+
+// Get a cached themed icon as surface that draws sharp on HiDPI screens; Do not destroy
+cairo_surface_t *
+icons_get_cached_surface(const gchar *icon_name, gint size, gint scale)
+{
+	IconsCacheItem *item;
+
+	g_return_val_if_fail(icon_name != NULL, NULL);
+
+	item = icons_cache_lookup(icon_name, size, scale);
+
+	if (item == NULL)
+	{
+		return NULL;
+	}
+
+	// Only create the surface when someone actually asks for it
+	if (item->surface == NULL)
+	{
+		item->surface = gdk_cairo_surface_create_from_pixbuf(item->pixbuf, scale, NULL /* for_window */);
+	}
+
+	return item->surface;
+}
+
+// Drop all cached icons (for example because the scale factor changed)
+void
+icons_clear_cache(void)
+{
+	if (IconsCache != NULL)
+	{
+		g_hash_table_remove_all(IconsCache);
+	}
+}
+
+static IconsCacheItem *
+icons_cache_lookup(const gchar *icon_name, gint size, gint scale)
+{
+	GError *error = NULL;
+	GtkIconTheme *icon_theme;
+	IconsCacheItem *item;
+	GHashTable *sizes;
+	GdkPixbuf *pixbuf;
+	gpointer value;
+
+	if (size <= 0)
+	{
+		size = ICONS_THEMED_SIZE;
+	}
+	if (scale <= 0)
+	{
+		scale = 1;
+	}
+
+	icon_theme = gtk_icon_theme_get_default();
+
+	if (IconsCache == NULL)
+	{
+		IconsCache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_hash_table_destroy);
+
+		// Make sure the next look-up uses the new theme (see note [1] at module description)
+		g_signal_connect(icon_theme, "changed", G_CALLBACK(icons_theme_changed_cb), NULL /* user_data */);
+	}
+
+	sizes = g_hash_table_lookup(IconsCache, icon_name);
+
+	if (sizes == NULL)
+	{
+		sizes = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL /* key_destroy_func */, icons_cache_item_free);
+		g_hash_table_insert(IconsCache, g_strdup(icon_name), sizes);
+	}
+	else if (g_hash_table_lookup_extended(sizes, ICONS_CACHE_KEY(size, scale), NULL /* orig_key */, &value))
+	{
+		// NULL if it failed to load before
+		return value;
+	}
+
+	pixbuf = gtk_icon_theme_load_icon_for_scale(icon_theme, icon_name, size, scale, 0, &error);
+
+	if (error != NULL)
+	{
+		g_warning("Couldn’t load icon: %s", error->message);
+		g_error_free(error);
+
+		item = NULL;
+	}
+	else
+	{
+		item = g_slice_new0(IconsCacheItem);
+		item->pixbuf = pixbuf;
+	}
+
+	g_hash_table_insert(sizes, ICONS_CACHE_KEY(size, scale), item);
+
+	return item;
+}
+
+static void
+icons_cache_item_free(gpointer data)
+{
+	IconsCacheItem *item = data;
+
+	// Icons that failed to load are cached as NULL
+	if (item == NULL)
+	{
+		return;
+	}
+
+	g_clear_object(&item->pixbuf);
+	g_clear_pointer(&item->surface, cairo_surface_destroy);
+
+	g_slice_free(IconsCacheItem, item);
+}
+
+static void
+icons_theme_changed_cb(GtkIconTheme *icon_theme, gpointer user_data)
+{
+	GList *windows, *l;
+
+	g_debug("Icon theme changed, clearing icon cache");
+
+	icons_clear_cache();
+
+	// Rows are only drawn again when asked to (see note [1] at module description)
+	windows = gtk_window_list_toplevels();
+
+	for (l = windows; l != NULL; l = l->next)
+	{
+		gtk_widget_queue_draw(l->data);
+	}
+
+	g_list_free(windows);
+}
+
 /* MODULE FUNCTIONS END */
 
 /* END OF FILE */
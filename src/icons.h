@@ -26,10 +26,15 @@
 
 #include <glib.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
+#include <cairo.h>
 
 /* INCLUDES END */
 
 /* DEFINES BEGIN */
+
+// Size in (unscaled) pixels of themed icons
+#define ICONS_THEMED_SIZE 16
+
 /* DEFINES END */
 
 /* MODULE TYPES BEGIN */
@@ -40,6 +45,10 @@
 GdkPixbuf * icons_get_themed_image(const gchar *icon_name);
 GdkPixbuf * icons_get_static_image(const gchar *resource_name);
 
+GdkPixbuf * icons_get_cached_image(const gchar *icon_name, gint size, gint scale);
+cairo_surface_t * icons_get_cached_surface(const gchar *icon_name, gint size, gint scale);
+void icons_clear_cache(void);
+
 /* FUNCTION PROTOTYPES END */
 
 #endif /* __ICONS__ */
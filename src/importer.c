@@ -0,0 +1,719 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * importer.c  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+/* INCLUDES BEGIN */
+
+// Library includes
+#include <glib.h>
+#include <gio/gio.h>
+
+// Woofer core includes
+#include <woofer/song.h>
+#include <woofer/library.h>
+
+// Module includes
+#include "importer.h"
+
+// Dependency includes
+#include "cache.h"
+
+// Resource includes
+/*< none >*/
+
+/* INCLUDES END */
+
+/* DESCRIPTION BEGIN */
+
+/*
+ * This module adds files and directories to the library without blocking
+ * the interface.  A worker thread walks the given files and directories and
+ * checks whether the files may be added, which is where most of the time
+ * goes (especially on network shares).  Directories are enumerated
+ * asynchronously, many at once, so the time it takes to list one directory
+ * overlaps with the others.  The accepted files are put on a
+ * queue, from which the main thread takes them in batches and adds them to
+ * the library.  The interface gets the new songs and the progress after
+ * every batch and can cancel the import at any time.
+ *
+ * Location specific notes:
+ * [1] The back-end is not thread-safe, so adding files to the library (which
+ *     reads their metadata) has to be done on the main thread.  It is done
+ *     in slices of a few milliseconds, so the main loop keeps drawing and
+ *     handling input in between.  The size of a batch is adjusted to how
+ *     long the last files took, so a slice takes about the same time on
+ *     fast and slow disks.
+ * [2] The files are already checked by the worker thread, so the back-end
+ *     is told not to check them again.  The check uses the content type
+ *     that is guessed from the filename, which does not need to read the
+ *     file.
+ * [3] The job is shared by the worker thread and the main thread and freed
+ *     by whichever is done with it last.  Canceling therefore never waits
+ *     for the worker thread, which may be stuck on a slow file system.
+ * [4] Files that are in the file cache (see cache.c) are in the library
+ *     already and have not changed since their metadata was read, so they
+ *     are skipped.  The other files are staged in the cache under the stage
+ *     of the job and committed once the back-end has added them; Whatever
+ *     is left is discarded when the job stops, even if the worker thread
+ *     is still staging files.
+ * [5] The worker thread runs its own main context, so the callbacks of the
+ *     asynchronous enumerations all run on the worker thread and the state
+ *     of the walk needs no locking.  GIO does the actual file system calls
+ *     in its own threads.
+ * [6] Every directory is only walked once, identified by its device and
+ *     inode, so symbolic links that point to a parent directory (or to a
+ *     directory that is walked anyway) don't make the walk go round in
+ *     circles.  Some file systems (like several GVFS back-ends) don't tell
+ *     the inode, so directories without one are not walked deeper than a
+ *     maximum depth instead.  The depth of a directory is kept on its GFile
+ *     and passed on to its enumerator.
+ */
+
+/* DESCRIPTION END */
+
+/* DEFINES BEGIN */
+
+// Attributes needed to walk directories and check files
+#define IMPORTER_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+                            G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+                            G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE "," \
+                            G_FILE_ATTRIBUTE_ID_FILE "," \
+                            INTERFACE_CACHE_ATTRIBUTES
+
+// Directories without id::file nested deeper than this are not walked (see note [6] at module description)
+#define IMPORTER_MAX_DEPTH 32
+
+// Key of the depth of a directory on its GFile and GFileEnumerator
+#define IMPORTER_DEPTH_KEY "importer-depth"
+
+// Amount of directories that are enumerated at once, and files requested at once per directory
+#define IMPORTER_MAX_DIRECTORIES 16
+#define IMPORTER_FILES_PER_REQUEST 64
+
+// Time the main thread may spend adding files at once, and the time between those slices
+#define IMPORTER_SLICE_MS 12
+#define IMPORTER_INTERVAL_MS 4
+
+// Amount of files added to the library at once
+#define IMPORTER_MIN_BATCH 1
+#define IMPORTER_MAX_BATCH 256
+
+/* DEFINES END */
+
+/* CUSTOM TYPES BEGIN */
+
+typedef struct _ImporterJob ImporterJob;
+typedef struct _ImporterScan ImporterScan;
+typedef struct _ImporterDetails ImporterDetails;
+
+struct _ImporterJob
+{
+	// Atomic; Shared by the worker thread and the main thread (see note [3] at module description)
+	gint ref_count;
+
+	// Only used by the worker thread
+	GSList *uris;
+	WfLibraryFileChecks checks;
+
+	gboolean skip_metadata;
+	GCancellable *cancellable;
+
+	// Stage of the file cache (see note [4] at module description)
+	guint stage;
+
+	// URIs of the files to add
+	GAsyncQueue *queue;
+	// Atomic; Amount of files found so far
+	gint found;
+	// Atomic; Whether the worker thread is still looking for files
+	gint scanning;
+};
+
+// State of the walk; Only used by the worker thread (see note [5] at module description)
+struct _ImporterScan
+{
+	ImporterJob *job;
+
+	// Directories waiting to be enumerated
+	GQueue directories;
+	// Amount of directories that are being enumerated
+	gint active;
+	// Identifiers of the directories that have been found (see note [6] at module description)
+	GHashTable *seen;
+};
+
+struct _ImporterDetails
+{
+	InterfaceImporterSongFunc song_func;
+	InterfaceImporterProgressFunc progress_func;
+	InterfaceImporterDoneFunc done_func;
+
+	// The running import; NULL if none
+	ImporterJob *job;
+	guint source_id;
+
+	guint batch_size;
+	gint added;
+	gint handled;
+};
+
+/* CUSTOM TYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+static gpointer interface_importer_thread(gpointer data);
+static void interface_importer_scan(ImporterScan *scan, GFile *file, GFileInfo *info, gint depth);
+static void interface_importer_scan_next(ImporterScan *scan);
+static void interface_importer_enumerate_cb(GObject *source, GAsyncResult *result, gpointer user_data);
+static void interface_importer_next_files_cb(GObject *source, GAsyncResult *result, gpointer user_data);
+static void interface_importer_enumerate_done(ImporterScan *scan);
+static gboolean interface_importer_check(ImporterJob *job, GFileInfo *info);
+
+static gboolean interface_importer_process_cb(gpointer user_data);
+static void interface_importer_song_cb(WfSong *song, gint item, gint total);
+static void interface_importer_stop(void);
+
+static ImporterJob * interface_importer_job_ref(ImporterJob *job);
+static void interface_importer_job_unref(ImporterJob *job);
+
+/* FUNCTION PROTOTYPES END */
+
+/* GLOBAL VARIABLES BEGIN */
+
+static ImporterDetails ImporterData = { 0 };
+
+/* GLOBAL VARIABLES END */
+
+/* CONSTRUCTORS BEGIN */
+
+void
+interface_importer_init(InterfaceImporterSongFunc song_func, InterfaceImporterProgressFunc progress_func, InterfaceImporterDoneFunc done_func)
+{
+	ImporterData.song_func = song_func;
+	ImporterData.progress_func = progress_func;
+	ImporterData.done_func = done_func;
+}
+
+/* CONSTRUCTORS END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+// Start adding the files and directories of @uris to the library; Returns %FALSE if an import is already running
+gboolean
+interface_importer_start(GSList *uris, WfLibraryFileChecks checks, gboolean skip_metadata)
+{
+	ImporterJob *job;
+	GThread *thread;
+
+	g_return_val_if_fail(uris != NULL, FALSE);
+
+	if (ImporterData.job != NULL)
+	{
+		return FALSE;
+	}
+
+	job = g_new0(ImporterJob, 1);
+	job->ref_count = 1;
+	job->uris = g_slist_copy_deep(uris, (GCopyFunc) g_strdup, NULL /* user_data */);
+	job->checks = checks;
+	job->skip_metadata = skip_metadata;
+	job->cancellable = g_cancellable_new();
+	job->queue = g_async_queue_new_full(g_free);
+	job->scanning = TRUE;
+	job->stage = interface_cache_stage_begin();
+
+	ImporterData.job = job;
+	ImporterData.batch_size = IMPORTER_MIN_BATCH;
+	ImporterData.added = 0;
+	ImporterData.handled = 0;
+
+	// The thread is not joined (see note [3] at module description)
+	thread = g_thread_new("importer", interface_importer_thread, interface_importer_job_ref(job));
+	g_thread_unref(thread);
+
+	// See note [1] at module description
+	ImporterData.source_id = g_timeout_add_full(G_PRIORITY_DEFAULT_IDLE, IMPORTER_INTERVAL_MS, interface_importer_process_cb, NULL /* data */, NULL /* notify */);
+
+	return TRUE;
+}
+
+// Stop the running import; The songs added so far stay in the library
+void
+interface_importer_cancel(void)
+{
+	if (ImporterData.job != NULL)
+	{
+		// Finished by interface_importer_process_cb()
+		g_cancellable_cancel(ImporterData.job->cancellable);
+	}
+}
+
+gboolean
+interface_importer_is_running(void)
+{
+	return (ImporterData.job != NULL);
+}
+
+/* MODULE FUNCTIONS END */
+
+/* MODULE UTILITIES BEGIN */
+
+static gpointer
+interface_importer_thread(gpointer data)
+{
+	ImporterJob *job = data;
+	ImporterScan scan = { 0 };
+	GMainContext *context;
+	GFile *file;
+	GSList *l;
+
+	// See note [5] at module description
+	context = g_main_context_new();
+	g_main_context_push_thread_default(context);
+
+	scan.job = job;
+	scan.seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL /* value_destroy_func */);
+	g_queue_init(&scan.directories);
+
+	for (l = job->uris; l != NULL && !g_cancellable_is_cancelled(job->cancellable); l = l->next)
+	{
+		file = g_file_new_for_uri(l->data);
+		interface_importer_scan(&scan, file, NULL /* info */, 0 /* depth */);
+		g_object_unref(file);
+	}
+
+	interface_importer_scan_next(&scan);
+
+	while (scan.active > 0)
+	{
+		g_main_context_iteration(context, TRUE /* may_block */);
+	}
+
+	g_atomic_int_set(&job->scanning, FALSE);
+
+	// Left over when canceled
+	while ((file = g_queue_pop_head(&scan.directories)) != NULL)
+	{
+		g_object_unref(file);
+	}
+
+	g_hash_table_destroy(scan.seen);
+
+	g_main_context_pop_thread_default(context);
+	g_main_context_unref(context);
+
+	interface_importer_job_unref(job);
+
+	return NULL;
+}
+
+// Queue @file if it may be added, or remember to walk it if it is a directory
+static void
+interface_importer_scan(ImporterScan *scan, GFile *file, GFileInfo *info, gint depth)
+{
+	ImporterJob *job = scan->job;
+	GError *error = NULL;
+	const gchar *id;
+	gchar *uri;
+
+	if (info == NULL)
+	{
+		info = g_file_query_info(file, IMPORTER_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, job->cancellable, &error);
+
+		if (info == NULL)
+		{
+			if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			{
+				g_info("Skipping file: %s", error->message);
+			}
+
+			g_error_free(error);
+
+			return;
+		}
+	}
+	else
+	{
+		g_object_ref(info);
+	}
+
+	switch (g_file_info_get_file_type(info))
+	{
+		case G_FILE_TYPE_DIRECTORY:
+			// See note [6] at module description
+			id = g_file_info_get_attribute_string(info, G_FILE_ATTRIBUTE_ID_FILE);
+
+			if (id != NULL)
+			{
+				if (g_hash_table_contains(scan->seen, id))
+				{
+					break;
+				}
+
+				g_hash_table_add(scan->seen, g_strdup(id));
+			}
+			else if (depth >= IMPORTER_MAX_DEPTH)
+			{
+				g_info("Skipping directory nested too deep");
+				break;
+			}
+
+			g_object_set_data(G_OBJECT(file), IMPORTER_DEPTH_KEY, GINT_TO_POINTER(depth));
+			g_queue_push_tail(&scan->directories, g_object_ref(file));
+			break;
+		case G_FILE_TYPE_REGULAR:
+			if (!interface_importer_check(job, info))
+			{
+				break;
+			}
+
+			uri = g_file_get_uri(file);
+
+			// See note [4] at module description
+			if (interface_cache_is_unchanged(uri, info))
+			{
+				g_free(uri);
+				break;
+			}
+
+			interface_cache_stage(job->stage, uri, info);
+
+			g_async_queue_push(job->queue, uri);
+			g_atomic_int_inc(&job->found);
+			break;
+		default:
+			break;
+	}
+
+	g_object_unref(info);
+}
+
+// Start enumerating waiting directories, as long as not too many are enumerated already
+static void
+interface_importer_scan_next(ImporterScan *scan)
+{
+	GFile *dir;
+
+	while (scan->active < IMPORTER_MAX_DIRECTORIES && !g_cancellable_is_cancelled(scan->job->cancellable))
+	{
+		dir = g_queue_pop_head(&scan->directories);
+
+		if (dir == NULL)
+		{
+			break;
+		}
+
+		scan->active++;
+
+		g_file_enumerate_children_async(dir, IMPORTER_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT,
+		                                scan->job->cancellable, interface_importer_enumerate_cb, scan);
+
+		g_object_unref(dir);
+	}
+}
+
+static void
+interface_importer_enumerate_cb(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	ImporterScan *scan = user_data;
+	GFileEnumerator *enumerator;
+	GError *error = NULL;
+
+	enumerator = g_file_enumerate_children_finish(G_FILE(source), result, &error);
+
+	if (enumerator == NULL)
+	{
+		if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		{
+			g_info("Skipping directory: %s", error->message);
+		}
+
+		g_error_free(error);
+
+		interface_importer_enumerate_done(scan);
+
+		return;
+	}
+
+	// See note [6] at module description
+	g_object_set_data(G_OBJECT(enumerator), IMPORTER_DEPTH_KEY, g_object_get_data(source, IMPORTER_DEPTH_KEY));
+
+	g_file_enumerator_next_files_async(enumerator, IMPORTER_FILES_PER_REQUEST, G_PRIORITY_DEFAULT,
+	                                   scan->job->cancellable, interface_importer_next_files_cb, scan);
+
+	// The asynchronous request keeps its own reference
+	g_object_unref(enumerator);
+}
+
+static void
+interface_importer_next_files_cb(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	ImporterScan *scan = user_data;
+	GFileEnumerator *enumerator = G_FILE_ENUMERATOR(source);
+	GFileInfo *info;
+	GFile *child;
+	GList *infos, *l;
+	gint depth;
+
+	infos = g_file_enumerator_next_files_finish(enumerator, result, NULL /* error */);
+
+	if (infos == NULL)
+	{
+		// Done (or failed); Closed when the last reference is dropped
+		interface_importer_enumerate_done(scan);
+
+		return;
+	}
+
+	depth = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(enumerator), IMPORTER_DEPTH_KEY));
+
+	for (l = infos; l != NULL; l = l->next)
+	{
+		info = l->data;
+
+		if (!g_file_info_get_is_hidden(info))
+		{
+			child = g_file_enumerator_get_child(enumerator, info);
+			interface_importer_scan(scan, child, info, depth + 1);
+			g_object_unref(child);
+		}
+	}
+
+	g_list_free_full(infos, g_object_unref);
+
+	// Start on the directories that were just found, while continuing this one
+	interface_importer_scan_next(scan);
+
+	g_file_enumerator_next_files_async(enumerator, IMPORTER_FILES_PER_REQUEST, G_PRIORITY_DEFAULT,
+	                                   scan->job->cancellable, interface_importer_next_files_cb, scan);
+}
+
+// A directory has been enumerated completely
+static void
+interface_importer_enumerate_done(ImporterScan *scan)
+{
+	scan->active--;
+
+	interface_importer_scan_next(scan);
+}
+
+// Whether the file of @info may be added to the library (see note [2] at module description)
+static gboolean
+interface_importer_check(ImporterJob *job, GFileInfo *info)
+{
+	const gchar *content_type;
+	gchar *mime_type;
+	gboolean allowed;
+
+	if (job->checks != WF_LIBRARY_CHECK_AUDIO && job->checks != WF_LIBRARY_CHECK_MEDIA)
+	{
+		return TRUE;
+	}
+
+	content_type = g_file_info_get_attribute_string(info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
+
+	if (content_type == NULL)
+	{
+		return FALSE;
+	}
+
+	mime_type = g_content_type_get_mime_type(content_type);
+
+	allowed = (mime_type != NULL &&
+	           (g_str_has_prefix(mime_type, "audio/") ||
+	            (job->checks == WF_LIBRARY_CHECK_MEDIA && g_str_has_prefix(mime_type, "video/"))));
+
+	g_free(mime_type);
+
+	return allowed;
+}
+
+// Add the next batches of queued files to the library (see note [1] at module description)
+static gboolean
+interface_importer_process_cb(gpointer user_data)
+{
+	ImporterJob *job = ImporterData.job;
+	GTimer *timer;
+	GSList *batch;
+	gchar *uri;
+	gdouble elapsed = 0.0, start;
+	gboolean scanning;
+	guint amount;
+	gint handled;
+
+	g_return_val_if_fail(job != NULL, G_SOURCE_REMOVE);
+
+	// Read before looking at the queue, so no file that is queued last is missed
+	scanning = g_atomic_int_get(&job->scanning);
+	handled = ImporterData.handled;
+	timer = g_timer_new();
+
+	while (elapsed * 1000.0 < IMPORTER_SLICE_MS && !g_cancellable_is_cancelled(job->cancellable))
+	{
+		batch = NULL;
+
+		for (amount = 0; amount < ImporterData.batch_size; amount++)
+		{
+			uri = g_async_queue_try_pop(job->queue);
+
+			if (uri == NULL)
+			{
+				break;
+			}
+
+			batch = g_slist_prepend(batch, uri);
+		}
+
+		if (batch == NULL)
+		{
+			break;
+		}
+
+		batch = g_slist_reverse(batch);
+		start = g_timer_elapsed(timer, NULL /* microseconds */);
+
+		// Already checked (see note [2] at module description)
+		ImporterData.added += wf_library_add_uris(batch, interface_importer_song_cb, WF_LIBRARY_CHECK_NONE, job->skip_metadata);
+		ImporterData.handled += amount;
+
+		g_slist_free_full(batch, g_free);
+
+		elapsed = g_timer_elapsed(timer, NULL /* microseconds */);
+
+		// Fill a slice with a single batch next time
+		ImporterData.batch_size = CLAMP((guint) (IMPORTER_SLICE_MS / 1000.0 / MAX((elapsed - start) / amount, 1e-6)), IMPORTER_MIN_BATCH, IMPORTER_MAX_BATCH);
+	}
+
+	g_timer_destroy(timer);
+
+	if (g_cancellable_is_cancelled(job->cancellable) || (!scanning && g_async_queue_length(job->queue) <= 0))
+	{
+		interface_importer_stop();
+
+		return G_SOURCE_REMOVE;
+	}
+
+	if (ImporterData.handled != handled || scanning)
+	{
+		if (ImporterData.progress_func != NULL)
+		{
+			ImporterData.progress_func(ImporterData.handled, g_atomic_int_get(&job->found), scanning);
+		}
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+interface_importer_song_cb(WfSong *song, gint item, gint total)
+{
+	// The back-end reports the start of a batch without a song
+	if (song == NULL)
+	{
+		return;
+	}
+
+	// Its metadata has been read (see note [4] at module description)
+	if (ImporterData.job != NULL)
+	{
+		interface_cache_commit(ImporterData.job->stage, wf_song_get_uri(song));
+	}
+
+	if (ImporterData.song_func != NULL)
+	{
+		ImporterData.song_func(song);
+	}
+}
+
+// Finish the running import and report it
+static void
+interface_importer_stop(void)
+{
+	ImporterJob *job = ImporterData.job;
+	gboolean cancelled;
+	guint stage;
+	gint added;
+
+	cancelled = g_cancellable_is_cancelled(job->cancellable);
+	added = ImporterData.added;
+	stage = job->stage;
+
+	ImporterData.job = NULL;
+	ImporterData.source_id = 0;
+
+	// Let the worker thread stop as well, if it did not already
+	g_cancellable_cancel(job->cancellable);
+	interface_importer_job_unref(job);
+
+	// Files that were not added are not in the library
+	interface_cache_discard(stage);
+	interface_cache_write();
+
+	g_info("%s import after adding %d songs", cancelled ? "Cancelled" : "Finished", added);
+
+	if (ImporterData.done_func != NULL)
+	{
+		ImporterData.done_func(added, cancelled);
+	}
+}
+
+static ImporterJob *
+interface_importer_job_ref(ImporterJob *job)
+{
+	g_atomic_int_inc(&job->ref_count);
+
+	return job;
+}
+
+static void
+interface_importer_job_unref(ImporterJob *job)
+{
+	if (!g_atomic_int_dec_and_test(&job->ref_count))
+	{
+		return;
+	}
+
+	g_slist_free_full(job->uris, g_free);
+	g_object_unref(job->cancellable);
+	g_async_queue_unref(job->queue);
+	g_free(job);
+}
+
+/* MODULE UTILITIES END */
+
+/* DESTRUCTORS BEGIN */
+
+void
+interface_importer_finalize(void)
+{
+	if (ImporterData.job != NULL)
+	{
+		g_source_remove(ImporterData.source_id);
+
+		g_cancellable_cancel(ImporterData.job->cancellable);
+		interface_importer_job_unref(ImporterData.job);
+	}
+
+	ImporterData = (ImporterDetails) { 0 };
+}
+
+/* DESTRUCTORS END */
+
+/* END OF FILE */
@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * importer.h  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+#ifndef __IMPORTER__
+#define __IMPORTER__
+
+/* INCLUDES BEGIN */
+
+#include <glib.h>
+
+#include <woofer/song.h>
+#include <woofer/library.h>
+
+/* INCLUDES END */
+
+/* DEFINES BEGIN */
+/* DEFINES END */
+
+/* MODULE TYPES BEGIN */
+
+typedef void (*InterfaceImporterSongFunc)(WfSong *song);
+typedef void (*InterfaceImporterProgressFunc)(gint handled, gint found, gboolean scanning);
+typedef void (*InterfaceImporterDoneFunc)(gint added, gboolean cancelled);
+
+/* MODULE TYPES END */
+
+/* CONSTRUCTOR PROTOTYPES BEGIN */
+
+void interface_importer_init(InterfaceImporterSongFunc song_func, InterfaceImporterProgressFunc progress_func, InterfaceImporterDoneFunc done_func);
+
+/* CONSTRUCTOR PROTOTYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+gboolean interface_importer_start(GSList *uris, WfLibraryFileChecks checks, gboolean skip_metadata);
+void interface_importer_cancel(void);
+gboolean interface_importer_is_running(void);
+
+/* FUNCTION PROTOTYPES END */
+
+/* DESTRUCTOR PROTOTYPES BEGIN */
+
+void interface_importer_finalize(void);
+
+/* DESTRUCTOR PROTOTYPES END */
+
+#endif /* __IMPORTER__ */
+
+/* END OF FILE */
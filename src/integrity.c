@@ -0,0 +1,440 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * integrity.c  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+
+/* INCLUDES BEGIN */
+
+// Library includes
+#include <glib.h>
+#include <gio/gio.h>
+
+// Woofer core includes
+#include <woofer/song.h>
+
+// Module includes
+#include "integrity.h"
+
+// Dependency includes
+/*< none >*/
+
+// Resource includes
+/*< none >*/
+
+/* INCLUDES END */
+
+/* DESCRIPTION BEGIN */
+
+/*
+ * This module checks whether the files of songs still exist and can be read,
+ * so songs that can't be played are known before the back-end tries to play
+ * them.  Only file information is asked for (nothing is read), by a small
+ * pool of threads, so a local library of any size is checked in seconds.
+ *
+ * Location specific notes:
+ * [1] The songs are handed to the pool in batches, so a thread checks a few
+ *     dozen files per task instead of one.  The amount of threads is fixed:
+ *     a stat is cheap, and more threads would only keep a slow disk or
+ *     network share busy for longer without being much faster.
+ * [2] Usually nearly all files are fine, so only problems are put in the
+ *     queue of results.  The main thread empties the queue a few times per
+ *     second, so the rows are updated while the check is still running.
+ * [3] Canceling skips the batches that were not checked yet.  Every batch
+ *     holds a reference to the job, like the job of the importer (see note
+ *     [3] of importer.c), so the pool is freed without waiting for the
+ *     batches in progress and the job is freed by whichever is done with it
+ *     last.  Quitting therefore never waits for a thread that is stuck on a
+ *     slow file system.  The songs are released by the main thread, as they
+ *     are not thread-safe.
+ */
+
+/* DESCRIPTION END */
+
+/* DEFINES BEGIN */
+
+// Attributes needed to tell whether a file can be played
+#define INTEGRITY_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+                             G_FILE_ATTRIBUTE_ACCESS_CAN_READ
+
+// Amount of threads checking files at once (see note [1] at module description)
+#define INTEGRITY_THREADS 8
+
+// Amount of files checked per task (see note [1] at module description)
+#define INTEGRITY_BATCH 64
+
+// Time between handing results to the interface
+#define INTEGRITY_REPORT_MS 100
+
+/* DEFINES END */
+
+/* CUSTOM TYPES BEGIN */
+
+typedef struct _IntegrityJob IntegrityJob;
+typedef struct _IntegrityDetails IntegrityDetails;
+
+struct _IntegrityJob
+{
+	// Atomic; One for the main thread and one per batch that is not handled yet (see note [3] at module description)
+	gint ref_count;
+
+	// The songs and a copy of their URIs, as songs are not thread-safe; The songs are NULL once released
+	GPtrArray *songs;
+	gchar **uris;
+	guint count;
+	GThreadPool *pool;
+
+	// Indexes of songs with a problem, with their state in the upper bits (see note [2] at module description)
+	GAsyncQueue *results;
+
+	// Atomic; Amount of batches that have been handled
+	gint batches_done;
+	gint batches;
+	// Atomic
+	gint cancelled;
+
+	gint missing;
+	gint unreadable;
+};
+
+struct _IntegrityDetails
+{
+	InterfaceIntegrityResultFunc result_func;
+	InterfaceIntegrityDoneFunc done_func;
+
+	// The running job; NULL if none
+	IntegrityJob *job;
+	guint source_id;
+};
+
+/* CUSTOM TYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+static void interface_integrity_worker(gpointer data, gpointer user_data);
+static InterfaceIntegrityState interface_integrity_check(const gchar *uri);
+static gboolean interface_integrity_report_cb(gpointer user_data);
+static void interface_integrity_report(IntegrityJob *job);
+static void interface_integrity_stop(void);
+static IntegrityJob * interface_integrity_job_ref(IntegrityJob *job);
+static void interface_integrity_job_unref(IntegrityJob *job);
+static void interface_integrity_job_release(IntegrityJob *job);
+
+/* FUNCTION PROTOTYPES END */
+
+/* GLOBAL VARIABLES BEGIN */
+
+static IntegrityDetails IntegrityData = { 0 };
+
+/* GLOBAL VARIABLES END */
+
+/* CONSTRUCTORS BEGIN */
+
+void
+interface_integrity_init(InterfaceIntegrityResultFunc result_func, InterfaceIntegrityDoneFunc done_func)
+{
+	IntegrityData.result_func = result_func;
+	IntegrityData.done_func = done_func;
+}
+
+/* CONSTRUCTORS END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+// Start checking the files of @songs (transfer full); Returns %FALSE if already checking
+gboolean
+interface_integrity_start(GPtrArray *songs)
+{
+	IntegrityJob *job;
+	GError *error = NULL;
+	const gchar *uri;
+	guint i;
+
+	g_return_val_if_fail(songs != NULL, FALSE);
+
+	if (IntegrityData.job != NULL)
+	{
+		g_ptr_array_unref(songs);
+		return FALSE;
+	}
+
+	job = g_new0(IntegrityJob, 1);
+	job->ref_count = 1;
+	job->songs = songs;
+	job->uris = g_new0(gchar *, songs->len + 1);
+	job->count = songs->len;
+	job->results = g_async_queue_new();
+	job->batches = (songs->len + INTEGRITY_BATCH - 1) / INTEGRITY_BATCH;
+
+	for (i = 0; i < songs->len; i++)
+	{
+		uri = wf_song_get_uri(g_ptr_array_index(songs, i));
+		job->uris[i] = g_strdup((uri != NULL) ? uri : "");
+	}
+
+	job->pool = g_thread_pool_new(interface_integrity_worker, job, INTEGRITY_THREADS, FALSE /* exclusive */, &error);
+
+	if (job->pool == NULL)
+	{
+		g_warning("Failed to create thread pool: %s", error->message);
+		g_error_free(error);
+
+		interface_integrity_job_release(job);
+
+		return FALSE;
+	}
+
+	for (i = 0; i < (guint) job->batches; i++)
+	{
+		// Zero can't be pushed, so push the batch plus one; The reference is dropped by the worker (see note [3] at module description)
+		interface_integrity_job_ref(job);
+		g_thread_pool_push(job->pool, GUINT_TO_POINTER(i + 1), NULL /* error */);
+	}
+
+	IntegrityData.job = job;
+	IntegrityData.source_id = g_timeout_add_full(G_PRIORITY_LOW, INTEGRITY_REPORT_MS, interface_integrity_report_cb, NULL /* data */, NULL /* notify */);
+
+	return TRUE;
+}
+
+void
+interface_integrity_cancel(void)
+{
+	if (IntegrityData.job != NULL)
+	{
+		// Finished by interface_integrity_report_cb() (see note [3] at module description)
+		g_atomic_int_set(&IntegrityData.job->cancelled, TRUE);
+	}
+}
+
+gboolean
+interface_integrity_is_running(void)
+{
+	return (IntegrityData.job != NULL);
+}
+
+/* MODULE FUNCTIONS END */
+
+/* MODULE UTILITIES BEGIN */
+
+static void
+interface_integrity_worker(gpointer data, gpointer user_data)
+{
+	IntegrityJob *job = user_data;
+	InterfaceIntegrityState state;
+	guint first, last, i;
+
+	first = (GPOINTER_TO_UINT(data) - 1) * INTEGRITY_BATCH;
+	last = MIN(first + INTEGRITY_BATCH, job->count);
+
+	for (i = first; i < last && !g_atomic_int_get(&job->cancelled); i++)
+	{
+		state = interface_integrity_check(job->uris[i]);
+
+		if (state != INTERFACE_INTEGRITY_OK)
+		{
+			// The index plus one, as zero can't be pushed either
+			g_async_queue_push(job->results, GUINT_TO_POINTER(((i + 1) << 2) | state));
+		}
+	}
+
+	g_atomic_int_inc(&job->batches_done);
+
+	interface_integrity_job_unref(job);
+}
+
+static InterfaceIntegrityState
+interface_integrity_check(const gchar *uri)
+{
+	InterfaceIntegrityState state = INTERFACE_INTEGRITY_OK;
+	GFileInfo *info;
+	GError *error = NULL;
+	GFile *file;
+
+	if (*uri == '\0')
+	{
+		return INTERFACE_INTEGRITY_MISSING;
+	}
+
+	file = g_file_new_for_uri(uri);
+	info = g_file_query_info(file, INTEGRITY_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, NULL /* cancellable */, &error);
+	g_object_unref(file);
+
+	if (info == NULL)
+	{
+		if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND) ||
+		    g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NOT_DIRECTORY))
+		{
+			state = INTERFACE_INTEGRITY_MISSING;
+		}
+		else
+		{
+			state = INTERFACE_INTEGRITY_UNREADABLE;
+		}
+
+		g_error_free(error);
+
+		return state;
+	}
+
+	// Only local files tell whether they can be read; Others are assumed to be
+	if (g_file_info_get_file_type(info) != G_FILE_TYPE_REGULAR ||
+	    (g_file_info_has_attribute(info, G_FILE_ATTRIBUTE_ACCESS_CAN_READ) &&
+	     !g_file_info_get_attribute_boolean(info, G_FILE_ATTRIBUTE_ACCESS_CAN_READ)))
+	{
+		state = INTERFACE_INTEGRITY_UNREADABLE;
+	}
+
+	g_object_unref(info);
+
+	return state;
+}
+
+static gboolean
+interface_integrity_report_cb(gpointer user_data)
+{
+	IntegrityJob *job = IntegrityData.job;
+
+	g_return_val_if_fail(job != NULL, G_SOURCE_REMOVE);
+
+	// Read before reporting, so no result can come in after the last report
+	if (g_atomic_int_get(&job->batches_done) >= job->batches)
+	{
+		interface_integrity_report(job);
+		interface_integrity_stop();
+
+		return G_SOURCE_REMOVE;
+	}
+
+	interface_integrity_report(job);
+
+	return G_SOURCE_CONTINUE;
+}
+
+// Hand the problems found so far to the interface (see note [2] at module description)
+static void
+interface_integrity_report(IntegrityJob *job)
+{
+	InterfaceIntegrityState state;
+	gpointer result;
+	guint index;
+
+	while ((result = g_async_queue_try_pop(job->results)) != NULL)
+	{
+		index = (GPOINTER_TO_UINT(result) >> 2) - 1;
+		state = GPOINTER_TO_UINT(result) & 3;
+
+		if (state == INTERFACE_INTEGRITY_MISSING)
+		{
+			job->missing++;
+		}
+		else
+		{
+			job->unreadable++;
+		}
+
+		if (IntegrityData.result_func != NULL)
+		{
+			IntegrityData.result_func(g_ptr_array_index(job->songs, index), state);
+		}
+	}
+}
+
+static void
+interface_integrity_stop(void)
+{
+	IntegrityJob *job = IntegrityData.job;
+	gboolean cancelled;
+	gint checked, missing, unreadable;
+
+	cancelled = g_atomic_int_get(&job->cancelled);
+	checked = job->count;
+	missing = job->missing;
+	unreadable = job->unreadable;
+
+	IntegrityData.job = NULL;
+	IntegrityData.source_id = 0;
+
+	interface_integrity_job_release(job);
+
+	if (IntegrityData.done_func != NULL)
+	{
+		IntegrityData.done_func(checked, missing, unreadable, cancelled);
+	}
+}
+
+static IntegrityJob *
+interface_integrity_job_ref(IntegrityJob *job)
+{
+	g_atomic_int_inc(&job->ref_count);
+
+	return job;
+}
+
+static void
+interface_integrity_job_unref(IntegrityJob *job)
+{
+	if (!g_atomic_int_dec_and_test(&job->ref_count))
+	{
+		return;
+	}
+
+	g_async_queue_unref(job->results);
+	g_strfreev(job->uris);
+	g_free(job);
+}
+
+// Drop the reference of the main thread without waiting for the batches in progress (see note [3] at module description)
+static void
+interface_integrity_job_release(IntegrityJob *job)
+{
+	if (job->pool != NULL)
+	{
+		// Batches that were not handled yet still run, to drop their reference, but are skipped when canceled
+		g_thread_pool_free(job->pool, FALSE /* immediate */, FALSE /* wait */);
+		job->pool = NULL;
+	}
+
+	g_ptr_array_unref(job->songs);
+	job->songs = NULL;
+
+	interface_integrity_job_unref(job);
+}
+
+/* MODULE UTILITIES END */
+
+/* DESTRUCTORS BEGIN */
+
+void
+interface_integrity_finalize(void)
+{
+	if (IntegrityData.job != NULL)
+	{
+		g_source_remove(IntegrityData.source_id);
+
+		g_atomic_int_set(&IntegrityData.job->cancelled, TRUE);
+		interface_integrity_job_release(IntegrityData.job);
+	}
+
+	IntegrityData = (IntegrityDetails) { 0 };
+}
+
+/* DESTRUCTORS END */
+
+/* END OF FILE */
@@ -0,0 +1,75 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * integrity.h  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+
+#ifndef __INTEGRITY__
+#define __INTEGRITY__
+
+/* INCLUDES BEGIN */
+
+#include <glib.h>
+
+#include <woofer/song.h>
+
+/* INCLUDES END */
+
+/* DEFINES BEGIN */
+/* DEFINES END */
+
+/* MODULE TYPES BEGIN */
+
+typedef enum _InterfaceIntegrityState InterfaceIntegrityState;
+
+enum _InterfaceIntegrityState
+{
+	INTERFACE_INTEGRITY_OK,
+	INTERFACE_INTEGRITY_MISSING,
+	INTERFACE_INTEGRITY_UNREADABLE
+};
+
+typedef void (*InterfaceIntegrityResultFunc)(WfSong *song, InterfaceIntegrityState state);
+typedef void (*InterfaceIntegrityDoneFunc)(gint checked, gint missing, gint unreadable, gboolean cancelled);
+
+/* MODULE TYPES END */
+
+/* CONSTRUCTOR PROTOTYPES BEGIN */
+
+void interface_integrity_init(InterfaceIntegrityResultFunc result_func, InterfaceIntegrityDoneFunc done_func);
+
+/* CONSTRUCTOR PROTOTYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+gboolean interface_integrity_start(GPtrArray *songs);
+void interface_integrity_cancel(void);
+gboolean interface_integrity_is_running(void);
+
+/* FUNCTION PROTOTYPES END */
+
+/* DESTRUCTOR PROTOTYPES BEGIN */
+
+void interface_integrity_finalize(void);
+
+/* DESTRUCTOR PROTOTYPES END */
+
+#endif /* __INTEGRITY__ */
+
+/* END OF FILE */
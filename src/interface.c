@@ -42,13 +42,24 @@
 
 // Dependency includes
 #include "about.h"
+#include "cache.h"
 #include "config.h"
 #include "icons.h"
+#include "importer.h"
+#include "integrity.h"
+#include "journal.h"
+#include "prefetch.h"
 #include "preferences.h"
 #include "question_dialog.h"
+#include "relocate.h"
+#include "search.h"
 #include "settings.h"
+#include "sort.h"
 #include "utils.h"
+#include "watch.h"
+#include "writer.h"
 #include "widgets/song_info.h"
+#include "widgets/song_model.h"
 
 // Resource includes
 /*< none >*/
@@ -77,6 +88,120 @@
  * [4] Hide the window first, then quit application;
  *     This makes the window disappear immediately even if the application
  *     takes a short while to quit.
+ * [5] The tree model does not hold any copies of song information; it asks
+ *     the song for it when a row is drawn.  So when a song changes, only
+ *     "row-changed" needs to be emitted for it and the tree view will fetch
+ *     the new values (but only if the row is visible).  Unlike a tree store,
+ *     the model is no drag destination, so the default handlers of the tree
+ *     view refuse every drop; Dropped files are handled here instead.
+ * [6] The back-end only reports that statistics have been updated, not for
+ *     which songs.  Statistics only change for the song that was playing, so
+ *     the songs that were recently playing are remembered and only those are
+ *     checked for changes.  If no song is known, all rows are compared to the
+ *     statistics the model has last seen, which is cheap as it does not
+ *     allocate anything and only emits "row-changed" for changed rows.
+ * [7] Most songs show no status icon at all.  The songs that do are kept in
+ *     a set, so when the playing songs change only those (and the previous,
+ *     current and next song) need to be checked instead of the complete
+ *     library.  Any song that gets a status other than STATUS_ICON_NONE
+ *     enters the set and it leaves the set when it returns to it.
+ * [8] Adding many songs while the model is attached to the tree view makes
+ *     the view handle every single insertion.  So while adding files, new
+ *     songs are only collected and are added to the model per batch.  If
+ *     there are many of them, the model is detached from the view while
+ *     adding them, which makes the view handle them in one go.
+ * [9] By default, the tree view measures every row to size its columns and
+ *     rows, which gets slower as the library grows.  For large libraries all
+ *     columns use a fixed width and all rows a fixed height, so only the
+ *     visible rows are ever measured.  The widths are stored in the settings
+ *     when the window closes.  Without stored widths, the width of a column
+ *     is estimated by measuring a sample of its rows.
+ * [10] Values are only fetched for columns that are drawn, so hidden columns
+ *      cost nothing as long as no "row-changed" is emitted for changes that
+ *      only affect them.  So the model knows what columns are visible and
+ *      ignores those changes.  In large libraries, measuring the width of a
+ *      hidden column is postponed until it is shown and done when idle.
+ * [11] The tree view does not show the song model directly, but a filter
+ *      model on top of it that hides the songs that don't match the search
+ *      query.  Paths and iters of the tree view (and its selection) belong to
+ *      this filter model, while the song model is used to look up rows by
+ *      song.  Whether a song matches is looked up in the search index (see
+ *      search.c), which is kept up-to-date when songs are added, removed or
+ *      their metadata is refreshed.
+ * [12] Between the song model and the filter model sits a sort model (see
+ *      sort.c), so the filter model shows the rows in the order of the column
+ *      the user clicked.  Clicking the status column goes back to the order of
+ *      the library.  Moving rows only makes sense in the order of the library,
+ *      so it is refused while the view is sorted.
+ * [13] Both the sort model and the filter model walk their rows for every row
+ *      that gets deleted from their child model, so removing many rows one by
+ *      one takes quadratic time.  When removing many rows at once, the view
+ *      is detached and both models are dropped; the rows are removed from the
+ *      song model, after which new sort and filter models are created.
+ * [14] Adjacent selected rows are moved as one block, which the song model
+ *      does in a single step that emits only one "rows-reordered".  Dragging
+ *      rows within the view uses the same move, handled here like dropped
+ *      files (see note [5]), as neither the sort model nor the filter model
+ *      are drag destinations either.
+ * [15] Editing many songs at once (ratings, queue and stop flags) happens
+ *      within an edit scope.  Inside it, songs are only remembered and the
+ *      statistics events of the back-end are postponed.  When the scope ends,
+ *      every edited row is refreshed once, postponed events are handled once
+ *      and the changes are saved once.
+ * [16] The library is not written right after every change, but a write is
+ *      requested from the writer (see writer.c).  It waits until the changes
+ *      stop coming in for a moment, so a burst of changes leads to a single
+ *      write, and reports the result in the status bar.  Saving manually
+ *      writes right away and pending changes are written on shutdown.
+ * [17] Ratings are not written to the library right away either, but added
+ *      to a journal (see journal.c), which only costs a small append instead
+ *      of writing the whole library.  The library is written once the
+ *      journal gets big or old, and on shutdown, after which the journal is
+ *      cleared.  Whatever is left in the journal at startup is applied
+ *      again before the songs are added to the view.
+ * [18] Files are added in the background by the importer (see importer.c),
+ *      so the main loop keeps running while adding them and the progress
+ *      window does not need to run a nested main loop.  The progress window
+ *      is not modal and can cancel the import; Only one import runs at once.
+ * [19] The back-end reads the metadata of all songs one after the other, on
+ *      the main thread.  Before refreshing the metadata, the files are read
+ *      ahead by a pool of threads (see prefetch.c), so the back-end finds
+ *      them in the cache.  Only the back-end can update the songs, so the
+ *      rows are updated at once when it is done.
+ * [20] The file cache (see cache.c) knows the size and modification time
+ *      of every file at the time its metadata was read.  Refreshing only
+ *      reads the files that changed, and skips the back-end completely if
+ *      none did.  The back-end can only refresh all songs at once, so
+ *      refreshing the selection only saves time if none of it changed.
+ *      Removed songs are removed from the cache as well.
+ * [21] Progress can be reported thousands of times per second, so reporting
+ *      it only stores the numbers.  A tick callback of the progress bar
+ *      shows them, so the window is updated at most once per frame, and
+ *      the speed and remaining time are only recalculated twice a second.
+ * [22] Watched folders (see watch.c) are added like any other folder once;
+ *      After that, only the files that are created, deleted or changed on
+ *      disk are handled.  Deleted files are removed at once and new files
+ *      go through the importer, so they wait until whatever runs in the
+ *      background is done.  Nobody asked for those imports, so they don't
+ *      show the progress window and are only reported in the status bar.  The back-end can only read the metadata of all
+ *      songs at once, so changed files are only counted in the status bar
+ *      until the user refreshes the metadata.  Folders on shares that don't
+ *      report changes are rescanned periodically and on request; The
+ *      differences found are handled the same way.
+ * [23] The back-end only marks a song as unavailable once it fails to play
+ *      it.  So the files of all songs are checked in the background at
+ *      startup and on request (see integrity.c), and the songs that can't
+ *      be played are kept in a set that the status icon also looks at.
+ *      While checking, the old marks stay, so rows don't flicker; Only the
+ *      rows of which the outcome differs are updated.
+ * [24] The back-end can't change the URI of a song, so relocating a
+ *      directory (see relocate.c) adds the files that were found in the new
+ *      location and only then removes the old songs.  The old songs are
+ *      remembered by the new URI; Once a new song is added, it gets the
+ *      rating of its old song and the old song is removed when the import
+ *      is done.  The old songs of files that failed to be added (or were
+ *      not added because the import was cancelled) stay.  The other
+ *      statistics can't be set, so they start over.
  */
 
 /* DESCRIPTION END */
@@ -86,6 +211,37 @@
 // Minimum column width to use
 #define COLUMN_MIN_WIDTH 5
 
+// Time over which the speed shown in the progress window is measured, in microseconds
+#define PROGRESS_RATE_INTERVAL (G_USEC_PER_SEC / 2)
+
+// Amount of rows from which the model is detached from the view while adding them
+#define BULK_DETACH_THRESHOLD 500
+
+// Drag and drop targets of the tree view
+#define DRAG_TARGET_URIS 0
+#define DRAG_TARGET_ROWS 1
+
+// Model columns that show metadata of a song
+#define METADATA_COLUMNS (WIDGET_SONG_MODEL_COLUMN_MASK(WIDGET_SONG_MODEL_COLUMN_URI) | \
+                          WIDGET_SONG_MODEL_COLUMN_MASK(WIDGET_SONG_MODEL_COLUMN_NAME) | \
+                          WIDGET_SONG_MODEL_COLUMN_MASK(WIDGET_SONG_MODEL_COLUMN_NUMBER) | \
+                          WIDGET_SONG_MODEL_COLUMN_MASK(WIDGET_SONG_MODEL_COLUMN_TITLE) | \
+                          WIDGET_SONG_MODEL_COLUMN_MASK(WIDGET_SONG_MODEL_COLUMN_ARTIST) | \
+                          WIDGET_SONG_MODEL_COLUMN_MASK(WIDGET_SONG_MODEL_COLUMN_ALBUM) | \
+                          WIDGET_SONG_MODEL_COLUMN_MASK(WIDGET_SONG_MODEL_COLUMN_DURATION))
+
+// Amount of songs from which the library view uses fixed column sizes
+#define LARGE_LIBRARY_ROWS 20000
+
+// Amount of rows to measure when estimating the width of a column
+#define COLUMN_WIDTH_SAMPLES 200
+
+// Maximum width an estimated column width may get
+#define COLUMN_MAX_ESTIMATED_WIDTH 300
+
+// Width to use for hidden columns until their width is estimated
+#define COLUMN_PLACEHOLDER_WIDTH 100
+
 /* DEFINES END */
 
 /* CUSTOM TYPES BEGIN */
@@ -93,10 +249,9 @@
 typedef struct _InterfaceDetails InterfaceDetails;
 
 typedef enum _DialogResponse DialogResponse;
-typedef enum _TreeColumns TreeColumns;
 typedef enum _SongStatusIcon SongStatusIcon;
 
-typedef void (*func_tree_update_item) (GtkTreeStore *store, GtkTreeIter *iter, WfSong *song);
+typedef void (*func_tree_update_item) (WidgetSongModel *model, WfSong *song);
 
 enum _DialogResponse
 {
@@ -105,25 +260,6 @@ enum _DialogResponse
 	DIALOG_QUIT
 };
 
-enum _TreeColumns
-{
-	STATUS_COLUMN,
-	URI_COLUMN,
-	NAME_COLUMN,
-	NUMBER_COLUMN,
-	TITLE_COLUMN,
-	ARTIST_COLUMN,
-	ALBUM_COLUMN,
-	DURATION_COLUMN,
-	RATING_COLUMN,
-	SCORE_COLUMN,
-	PLAYCOUNT_COLUMN,
-	SKIPCOUNT_COLUMN,
-	LASTPLAYED_COLUMN,
-	SONGOBJ_COLUMN,
-	N_COLUMNS
-};
-
 enum _SongStatusIcon
 {
 	STATUS_ICON_INVALID,
@@ -150,6 +286,13 @@ struct _InterfaceDetails
 	GtkWidget *window_widget;
 	GtkWidget *progress;
 	GtkWidget *prog_bar;
+	GtkWidget *prog_label;
+	gint prog_done;
+	gint prog_total;
+	gint prog_shown;
+	gint prog_rate_done;
+	gint64 prog_rate_time;
+	gdouble prog_rate;
 	GtkWidget *header_bar;
 	GtkWidget *subtitle_box;
 	GtkWidget *subtitle_label;
@@ -175,7 +318,23 @@ struct _InterfaceDetails
 	GtkToolItem *edit_rating;
 
 	GtkTreeView *tree_view;
-	GtkTreeStore *tree_store;
+	gboolean large_library;
+	WidgetSongModel *tree_model;
+	GtkTreeModel *view_model;
+	GtkWidget *search_entry;
+	GHashTable *stats_dirty;
+	GHashTable *status_songs;
+	GHashTable *invalid_songs;
+	GHashTable *invalid_stale;
+	GHashTable *relocating;
+	GPtrArray *relocated;
+	GPtrArray *bulk_songs;
+	GHashTable *edited_songs;
+	gint edit_depth;
+	gboolean edit_stats_pending;
+	// Whether the running import shows no progress window (see note [22] at module description)
+	gboolean import_silent;
+	gboolean edit_write;
 	GtkTreeViewColumn *uri_column;
 	GtkTreeViewColumn *filename_column;
 	GtkTreeViewColumn *track_number_column;
@@ -190,6 +349,7 @@ struct _InterfaceDetails
 	GtkTreeViewColumn *lastplayed_column;
 
 	guint tree_row_activate_handler;
+	guint tree_select_handler;
 	guint position_updated_handler;
 };
 
@@ -212,6 +372,10 @@ static gboolean interface_tree_button_pressed_cb(GtkWidget *widget, GdkEventButt
 static void interface_menu_quit_cb(GtkMenuItem *menuitem, gpointer user_data);
 static void interface_open_items_cb(GtkWidget *widget, gpointer user_data);
 static void interface_open_directory_cb(GtkWidget *widget, gpointer user_data);
+static void interface_watch_directory_cb(GtkWidget *widget, gpointer user_data);
+static void interface_watch_rescan_cb(GtkWidget *widget, gpointer user_data);
+static void interface_watch_stop_cb(GtkWidget *widget, gpointer user_data);
+static void interface_relocate_cb(GtkWidget *widget, gpointer user_data);
 static void interface_remove_items_cb(GtkWidget *widget, gpointer user_data);
 static void interface_move_items_up_cb(GtkWidget *widget, gpointer user_data);
 static void interface_move_items_down_cb(GtkWidget *widget, gpointer user_data);
@@ -224,6 +388,7 @@ static void interface_play_pause_cb(GtkWidget *widget, gpointer user_data);
 static void interface_stop_cb(GtkWidget *widget, gpointer user_data);
 static void interface_library_write_cb(GtkWidget *widget, gpointer user_data);
 static void interface_metadata_refresh_cb(GtkWidget *widget, gpointer user_data);
+static void interface_integrity_sweep_cb(GtkWidget *widget, gpointer user_data);
 static void interface_fullscreen_toggle_cb(GtkCheckMenuItem *checkmenuitem, gpointer user_data);
 static void interface_toggle_toolbar_cb(GtkCheckMenuItem *checkmenuitem, gpointer user_data);
 static void interface_hide_window_cb(GtkWidget *widget, gpointer user_data);
@@ -241,21 +406,58 @@ static void interface_scroll_to_playing_cb(GtkWidget *widget, gpointer user_data
 static void interface_dialog_stop_cb(GtkEntry *entry, gpointer user_data);
 static void interface_dialog_value_changed_cb(GtkWidget *widget, gpointer user_data);
 
-static void interface_items_are_added_cb(WfSong *song, gint item, gint total);
+static void interface_import_progress_cb(gint handled, gint found, gboolean scanning);
+static void interface_import_done_cb(gint added, gboolean cancelled);
+static gboolean interface_watch_add_cb(GSList *uris);
+static void interface_watch_remove_cb(GPtrArray *songs);
+static void interface_watch_changed_cb(guint amount);
+static void interface_integrity_result_cb(WfSong *song, InterfaceIntegrityState state);
+static void interface_integrity_done_cb(gint checked, gint missing, gint unreadable, gboolean cancelled);
+static void interface_relocate_done_cb(GPtrArray *songs, GPtrArray *uris, gint missing, gboolean cancelled);
+static void interface_prefetch_progress_cb(gint done, gint total);
+static void interface_prefetch_done_cb(guint stage, gint changed, gboolean cancelled);
+static void interface_metadata_refresh_selection_cb(GtkWidget *widget, gpointer user_data);
+static void interface_metadata_refresh_start(GPtrArray *uris);
+static void interface_metadata_refresh(guint stage);
 static void interface_update_song_info_cb(WfApp *app, WfSong *song_previous, WfSong *song_current, WfSong *song_next, gpointer user_data);
 static void interface_statusbar_update_cb(WfApp *app, const gchar *message, gpointer user_data);
 static void interface_playing_state_changed_cb(WfApp *app, WfAppStatus state, gdouble duration, gpointer user_data);
 static void interface_playback_position_cb(WfApp *app, gdouble position, gdouble duration, gpointer user_data);
 static void interface_position_slider_updated_cb(GtkRange *range, gpointer user_data);
 
-static void interface_tree_update_song_stat_cb(GtkTreeStore *store, GtkTreeIter *iter, WfSong *song);
-static void interface_tree_update_song_metadata_cb(GtkTreeStore *store, GtkTreeIter *iter, WfSong *song);
+static void interface_tree_update_song_stat_cb(WidgetSongModel *model, WfSong *song);
+static void interface_tree_update_song_metadata_cb(WidgetSongModel *model, WfSong *song);
 static void interface_tree_update_all_stats_cb(void);
+static void interface_tree_mark_stats_dirty(WfSong *song);
 static void interface_tree_update_all_song_icons(void);
-static void interface_tree_update_song_status(GtkTreeStore *store, GtkTreeIter *iter, WfSong *song);
+static void interface_tree_update_changed_song_icons(WfSong *song_previous, WfSong *song_current, WfSong *song_next);
+static void interface_tree_update_song_status(WidgetSongModel *model, WfSong *song);
+static SongStatusIcon interface_tree_get_song_status(WfSong *song);
+static void interface_tree_track_song_status(WfSong *song, SongStatusIcon status);
+static void interface_tree_status_cell_data_cb(GtkTreeViewColumn *column, GtkCellRenderer *cell, GtkTreeModel *model, GtkTreeIter *iter, gpointer data);
+static void interface_tree_scale_factor_changed_cb(GObject *object, GParamSpec *pspec, gpointer user_data);
+static void interface_tree_int_cell_data_cb(GtkTreeViewColumn *column, GtkCellRenderer *cell, GtkTreeModel *model, GtkTreeIter *iter, gpointer data);
+static void interface_tree_number_cell_data_cb(GtkTreeViewColumn *column, GtkCellRenderer *cell, GtkTreeModel *model, GtkTreeIter *iter, gpointer data);
+static void interface_tree_rating_cell_data_cb(GtkTreeViewColumn *column, GtkCellRenderer *cell, GtkTreeModel *model, GtkTreeIter *iter, gpointer data);
+static void interface_tree_edit_begin(void);
+static void interface_tree_edit_song(WfSong *song);
+static void interface_tree_edit_end(gboolean write);
+static void interface_tree_bulk_begin(void);
+static void interface_tree_set_fixed_sizing(GtkCellRenderer *status_renderer);
+static gint interface_tree_estimate_column_width(GtkTreeViewColumn *column);
+static gint interface_tree_column_get_model_column(GtkTreeViewColumn *column);
+static void interface_tree_column_visibility_cb(GObject *object, GParamSpec *pspec, gpointer user_data);
+static void interface_tree_column_clicked_cb(GtkTreeViewColumn *column, gpointer user_data);
+static void interface_tree_update_sort_indicators(void);
+static gboolean interface_tree_estimate_column_width_cb(gpointer user_data);
+static void interface_tree_store_column_widths(void);
+static void interface_tree_bulk_end(void);
 static void interface_tree_scroll_to_row(GtkTreePath *path);
 static void interface_tree_activated_cb(GtkTreeView *view, GtkTreePath *path, GtkTreeViewColumn *column, gpointer user_data);
+static gboolean interface_drag_drop_cb(GtkWidget *widget, GdkDragContext *context, gint x, gint y, guint time, gpointer user_data);
 static void interface_drag_data_received_cb(GtkWidget *widget, GdkDragContext *context, gint x, gint y, GtkSelectionData *data, guint info, guint time, gpointer user_data);
+static void interface_library_written_cb(gboolean success, gboolean forced);
+static void interface_journal_compact_cb(void);
 
 static gboolean interface_handle_notification_cb(WfApp *app, WfSong *song, gint64 duration, gpointer user_data);
 
@@ -271,11 +473,25 @@ static void interface_update_playback_position(gdouble position, gdouble duratio
 static void interface_update_position_slider_marks(void);
 
 static void interface_add_items(GSList *files, WfLibraryFileChecks checks, gboolean skip_metadata);
+static gboolean interface_add_items_silently(GSList *files);
+static void interface_integrity_sweep(void);
 static void interface_update_toolbar(gint items_selected, gint items_total);
 static void interface_update_library_info(gint selected, gint total);
 static void interface_report_items_added(gint amount);
 static void interface_tree_update_song_data(func_tree_update_item cb_func);
 static gboolean interface_tree_get_iter_for_song(WfSong *song, GtkTreeIter *iter);
+static void interface_tree_create_view_model(void);
+static void interface_tree_move_selection(gboolean down);
+static void interface_tree_move_songs(GPtrArray *songs, WfSong *sibling, gboolean after);
+static gint interface_tree_remove_songs(GPtrArray *songs);
+static void interface_tree_relocate_song(WfSong *song);
+static void interface_tree_remove_relocated(void);
+static gchar * interface_relocate_dialog_get_uri(GtkWidget *entry);
+static gboolean interface_tree_drop_rows(gint x, gint y);
+static gint interface_tree_compare_song_positions(gconstpointer a, gconstpointer b, gpointer user_data);
+static gboolean interface_tree_visible_func(GtkTreeModel *model, GtkTreeIter *iter, gpointer data);
+static void interface_tree_refilter(void);
+static void interface_search_changed_cb(GtkSearchEntry *entry, gpointer user_data);
 static WfSong * interface_tree_get_song_for_iter(GtkTreeModel *model, GtkTreeIter *iter);
 static WfSong * interface_tree_get_song_for_path(GtkTreeModel *model, GtkTreePath *path);
 
@@ -285,7 +501,9 @@ static gint interface_edit_rating_dialog(GtkWindow *parent, gint amount);
 static DialogResponse interface_close_confirm(GtkWindow *parent);
 
 static void interface_progress_window_create(const gchar *description);
-static void interface_progress_window_update(gdouble complete);
+static void interface_progress_window_update(gint done, gint total);
+static gboolean interface_progress_window_tick_cb(GtkWidget *widget, GdkFrameClock *frame_clock, gpointer user_data);
+static void interface_progress_window_response_cb(GtkDialog *dialog, gint response_id, gpointer user_data);
 static void interface_progress_window_destroy(void);
 
 static void interface_set_subtitle(gchar *subtitle);
@@ -294,7 +512,7 @@ static void interface_set_button_pause(void);
 
 static gboolean interface_tree_pop_menu(GtkWidget *widget, GdkEventButton *event, gpointer subwidget);
 static GtkWidget * interface_get_default_media_icon(const gchar *icon_name);
-static GdkPixbuf * interface_get_pixbuf_icon(SongStatusIcon state);
+static cairo_surface_t * interface_get_status_icon(SongStatusIcon state, gint scale);
 static void interface_window_set_default_widget(GtkWindow *window, GtkWidget *widget);
 static void interface_update_gtk_events(void);
 
@@ -348,7 +566,7 @@ interface_construct(WfApp *app)
 	GtkWidget *controls;
 	GtkWidget *status_bar;
 	GtkToolItem *tool_item;
-	GtkTreeStore *tree_store;
+	WidgetSongModel *tree_model;
 	GtkTreeSelection *tree_select;
 	GtkTreeViewColumn *column;
 	GtkCellRenderer *text_renderer;
@@ -357,12 +575,18 @@ interface_construct(WfApp *app)
 	GtkStyleContext *style;
 	GdkPixbuf *icon;
 	GList *hide_widgets = NULL, *list;
+	GList *columns;
+	GTimer *timer;
 	gdouble app_time;
 	gchar *str;
 	gchar *time;
 	gint total_items;
 
-	const GtkTargetEntry targets[] = { { "text/uri-list", GTK_TARGET_OTHER_APP, 0 } };
+	const GtkTargetEntry targets[] =
+	{
+		{ "text/uri-list", GTK_TARGET_OTHER_APP, DRAG_TARGET_URIS },
+		{ "WOOFER_LIBRARY_ROWS", GTK_TARGET_SAME_WIDGET, DRAG_TARGET_ROWS }
+	};
 
 	g_info("Application activation: Constructing main window");
 
@@ -484,6 +708,22 @@ interface_construct(WfApp *app)
 	g_signal_connect(menu_item, "activate", G_CALLBACK(interface_open_directory_cb), NULL /* user_data */);
 	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_item);
 
+	menu_item = gtk_menu_item_new_with_mnemonic("_Watch directory...");
+	g_signal_connect(menu_item, "activate", G_CALLBACK(interface_watch_directory_cb), NULL /* user_data */);
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_item);
+
+	menu_item = gtk_menu_item_new_with_mnemonic("Re_scan watched directories");
+	g_signal_connect(menu_item, "activate", G_CALLBACK(interface_watch_rescan_cb), NULL /* user_data */);
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_item);
+
+	menu_item = gtk_menu_item_new_with_mnemonic("Re_locate directory...");
+	g_signal_connect(menu_item, "activate", G_CALLBACK(interface_relocate_cb), NULL /* user_data */);
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_item);
+
+	menu_item = gtk_menu_item_new_with_mnemonic("Stop _watching directories");
+	g_signal_connect(menu_item, "activate", G_CALLBACK(interface_watch_stop_cb), NULL /* user_data */);
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_item);
+
 	menu_item = gtk_separator_menu_item_new();
 	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_item);
 
@@ -491,6 +731,10 @@ interface_construct(WfApp *app)
 	g_signal_connect(menu_item, "activate", G_CALLBACK(interface_metadata_refresh_cb), NULL /* user_data */);
 	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_item);
 
+	menu_item = gtk_menu_item_new_with_mnemonic("_Check files");
+	g_signal_connect(menu_item, "activate", G_CALLBACK(interface_integrity_sweep_cb), NULL /* user_data */);
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_item);
+
 	menu_item = gtk_menu_item_new_with_mnemonic("_Force write to disk");
 	g_signal_connect(menu_item, "activate", G_CALLBACK(interface_library_write_cb), NULL /* user_data */);
 	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_item);
@@ -506,6 +750,10 @@ interface_construct(WfApp *app)
 	g_signal_connect(menu_item, "activate", G_CALLBACK(interface_remove_items_cb), NULL /* user_data */);
 	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_item);
 
+	menu_item = gtk_menu_item_new_with_mnemonic("Re_fresh metadata");
+	g_signal_connect(menu_item, "activate", G_CALLBACK(interface_metadata_refresh_selection_cb), NULL /* user_data */);
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_item);
+
 	menu_item = gtk_separator_menu_item_new();
 	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_item);
 
@@ -719,6 +967,12 @@ interface_construct(WfApp *app)
 	// Set initial content (empty labels)
 	interface_set_song_labels(NULL, NULL, NULL);
 
+	// Search entry to filter the library (see note [11] at module description)
+	InterfaceData.search_entry = gtk_search_entry_new();
+	gtk_entry_set_placeholder_text(GTK_ENTRY(InterfaceData.search_entry), "Search title, artist, album or filename");
+	g_signal_connect(InterfaceData.search_entry, "search-changed", G_CALLBACK(interface_search_changed_cb), NULL /* user_data */);
+	gtk_box_pack_start(GTK_BOX(vbox), InterfaceData.search_entry, FALSE, TRUE, 0);
+
 	// Tree frame
 	frame = gtk_frame_new(NULL /* label */);
 	gtk_box_pack_start(GTK_BOX(vbox), frame, TRUE, TRUE, 0);
@@ -735,6 +989,7 @@ interface_construct(WfApp *app)
 	gtk_tree_view_set_reorderable(GTK_TREE_VIEW(tree_view), FALSE);
 	gtk_tree_view_set_rubber_banding(GTK_TREE_VIEW(tree_view), TRUE);
 	InterfaceData.tree_row_activate_handler = g_signal_connect(tree_view, "row-activated", G_CALLBACK(interface_tree_activated_cb), NULL /* user_data */);
+	g_signal_connect(tree_view, "notify::scale-factor", G_CALLBACK(interface_tree_scale_factor_changed_cb), NULL /* user_data */);
 	gtk_container_add(GTK_CONTAINER(scroll_window), tree_view);
 	InterfaceData.tree_view = GTK_TREE_VIEW(tree_view);
 
@@ -750,45 +1005,59 @@ interface_construct(WfApp *app)
 
 	// Tree content
 	total_items = wf_song_get_count();
-	tree_store = gtk_tree_store_new(N_COLUMNS,
-	                                GDK_TYPE_PIXBUF, // Icon
-	                                G_TYPE_STRING, // URI
-	                                G_TYPE_STRING, // Filename
-	                                G_TYPE_STRING, // Track number
-	                                G_TYPE_STRING, // Title
-	                                G_TYPE_STRING, // Artist
-	                                G_TYPE_STRING, // Album
-	                                G_TYPE_STRING, // Duration
-	                                G_TYPE_STRING, // Rating
-	                                G_TYPE_INT, // Score (rounded)
-	                                G_TYPE_INT, // Play count
-	                                G_TYPE_INT, // Skip count
-	                                G_TYPE_STRING, // Timestamp / time since last played
-	                                G_TYPE_OBJECT); // SongObj pointer
-	gtk_tree_view_set_model(GTK_TREE_VIEW(tree_view), GTK_TREE_MODEL(tree_store));
-	InterfaceData.tree_store = tree_store;
+	tree_model = widget_song_model_new();
+	InterfaceData.tree_model = tree_model;
+	widget_song_model_set_last_played_timestamp(tree_model, interface_settings_get_last_played_timestamp());
+
+	// Index of the metadata to search in (see note [11] at module description)
+	interface_search_init();
+
+	// Index of the URIs to find the songs in a directory (see note [24] at module description)
+	interface_relocate_init(interface_relocate_done_cb);
+	InterfaceData.relocating = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
+	InterfaceData.relocated = g_ptr_array_new_with_free_func(g_object_unref);
+
+	// Sorts the rows by the column that was clicked (see note [12] at module description)
+	interface_sort_init(tree_model);
+
+	// The model that is actually shown; Only contains rows that match the search query
+	interface_tree_create_view_model();
+
+	// Songs of which the statistics may have changed (see note [6] at module description)
+	InterfaceData.stats_dirty = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, NULL /* value_destroy_func */);
+
+	// Songs that currently show a status icon (see note [7] at module description)
+	InterfaceData.status_songs = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, NULL /* value_destroy_func */);
+
+	// Songs of which the file is missing or unreadable (see note [23] at module description)
+	InterfaceData.invalid_songs = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, NULL /* value_destroy_func */);
 
 	// Only now connect to this signal so it doesn't trigger while still setting stuff up
-	g_signal_connect(tree_select, "changed", G_CALLBACK(interface_selection_changed_cb), NULL /* user_data */);
+	InterfaceData.tree_select_handler = g_signal_connect(tree_select, "changed", G_CALLBACK(interface_selection_changed_cb), NULL /* user_data */);
 
-	gtk_tree_view_enable_model_drag_dest(GTK_TREE_VIEW(tree_view), targets, 1, GDK_ACTION_PRIVATE);
+	// Accept files from other applications and rows dragged within the view (see notes [5] and [14] at module description)
+	gtk_tree_view_enable_model_drag_dest(GTK_TREE_VIEW(tree_view), targets, G_N_ELEMENTS(targets), GDK_ACTION_PRIVATE | GDK_ACTION_MOVE);
+	gtk_tree_view_enable_model_drag_source(GTK_TREE_VIEW(tree_view), GDK_BUTTON1_MASK, &targets[DRAG_TARGET_ROWS], 1, GDK_ACTION_MOVE);
+	g_signal_connect(tree_view, "drag-drop", G_CALLBACK(interface_drag_drop_cb), NULL /* user_data */);
 	g_signal_connect(tree_view, "drag-data-received", G_CALLBACK(interface_drag_data_received_cb), NULL /* user_data */);
 
 	text_renderer = gtk_cell_renderer_text_new();
 	pixbuf_renderer = gtk_cell_renderer_pixbuf_new();
 
 	// Columns
-	column = gtk_tree_view_column_new_with_attributes(NULL, pixbuf_renderer, "pixbuf", STATUS_COLUMN, NULL /* terminator */);
+	column = gtk_tree_view_column_new_with_attributes(NULL, pixbuf_renderer, NULL /* terminator */);
+	gtk_tree_view_column_set_cell_data_func(column, pixbuf_renderer, interface_tree_status_cell_data_cb, NULL /* func_data */, NULL /* destroy */);
 	gtk_tree_view_column_set_resizable(column, FALSE);
 	gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view), column);
 
-	column = gtk_tree_view_column_new_with_attributes("Track", text_renderer, "text", NUMBER_COLUMN, NULL /* terminator */);
+	column = gtk_tree_view_column_new_with_attributes("Track", text_renderer, NULL /* terminator */);
+	gtk_tree_view_column_set_cell_data_func(column, text_renderer, interface_tree_number_cell_data_cb, GINT_TO_POINTER(WIDGET_SONG_MODEL_COLUMN_NUMBER), NULL /* destroy */);
 	gtk_tree_view_column_set_min_width(column, COLUMN_MIN_WIDTH);
 	gtk_tree_view_column_set_resizable(column, TRUE);
 	gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view), column);
 	InterfaceData.track_number_column = column;
 
-	column = gtk_tree_view_column_new_with_attributes("Filepath", text_renderer, "text", URI_COLUMN, NULL /* terminator */);
+	column = gtk_tree_view_column_new_with_attributes("Filepath", text_renderer, "text", WIDGET_SONG_MODEL_COLUMN_URI, NULL /* terminator */);
 	gtk_tree_view_column_set_min_width(column, COLUMN_MIN_WIDTH);
 	gtk_tree_view_column_set_fixed_width(column, 120);
 	gtk_tree_view_column_set_resizable(column, TRUE);
@@ -796,79 +1065,141 @@ interface_construct(WfApp *app)
 	gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view), column);
 	InterfaceData.uri_column = column;
 
-	column = gtk_tree_view_column_new_with_attributes("Filename", text_renderer, "text", NAME_COLUMN, NULL /* terminator */);
+	column = gtk_tree_view_column_new_with_attributes("Filename", text_renderer, "text", WIDGET_SONG_MODEL_COLUMN_NAME, NULL /* terminator */);
 	gtk_tree_view_column_set_min_width(column, COLUMN_MIN_WIDTH);
 	gtk_tree_view_column_set_resizable(column, TRUE);
 	gtk_tree_view_column_set_expand(column, TRUE);
 	gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view), column);
 	InterfaceData.filename_column = column;
 
-	column = gtk_tree_view_column_new_with_attributes("Title", text_renderer, "text", TITLE_COLUMN, NULL /* terminator */);
+	column = gtk_tree_view_column_new_with_attributes("Title", text_renderer, "text", WIDGET_SONG_MODEL_COLUMN_TITLE, NULL /* terminator */);
 	gtk_tree_view_column_set_min_width(column, COLUMN_MIN_WIDTH);
 	gtk_tree_view_column_set_resizable(column, TRUE);
 	gtk_tree_view_column_set_expand(column, TRUE);
 	gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view), column);
 	InterfaceData.title_column = column;
 
-	column = gtk_tree_view_column_new_with_attributes("Artist", text_renderer, "text", ARTIST_COLUMN, NULL /* terminator */);
+	column = gtk_tree_view_column_new_with_attributes("Artist", text_renderer, "text", WIDGET_SONG_MODEL_COLUMN_ARTIST, NULL /* terminator */);
 	gtk_tree_view_column_set_min_width(column, COLUMN_MIN_WIDTH);
 	gtk_tree_view_column_set_resizable(column, TRUE);
 	gtk_tree_view_column_set_expand(column, TRUE);
 	gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view), column);
 	InterfaceData.artist_column = column;
 
-	column = gtk_tree_view_column_new_with_attributes("Album", text_renderer, "text", ALBUM_COLUMN, NULL /* terminator */);
+	column = gtk_tree_view_column_new_with_attributes("Album", text_renderer, "text", WIDGET_SONG_MODEL_COLUMN_ALBUM, NULL /* terminator */);
 	gtk_tree_view_column_set_min_width(column, COLUMN_MIN_WIDTH);
 	gtk_tree_view_column_set_resizable(column, TRUE);
 	gtk_tree_view_column_set_expand(column, TRUE);
 	gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view), column);
 	InterfaceData.album_column = column;
 
-	column = gtk_tree_view_column_new_with_attributes("Duration", text_renderer, "text", DURATION_COLUMN, NULL /* terminator */);
+	column = gtk_tree_view_column_new_with_attributes("Duration", text_renderer, "text", WIDGET_SONG_MODEL_COLUMN_DURATION, NULL /* terminator */);
 	gtk_tree_view_column_set_min_width(column, COLUMN_MIN_WIDTH);
 	gtk_tree_view_column_set_resizable(column, TRUE);
 	gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view), column);
 	InterfaceData.duration_column = column;
 
-	column = gtk_tree_view_column_new_with_attributes("Rating", text_renderer, "text", RATING_COLUMN, NULL /* terminator */);
+	column = gtk_tree_view_column_new_with_attributes("Rating", text_renderer, NULL /* terminator */);
+	gtk_tree_view_column_set_cell_data_func(column, text_renderer, interface_tree_rating_cell_data_cb, NULL /* func_data */, NULL /* destroy */);
 	gtk_tree_view_column_set_min_width(column, COLUMN_MIN_WIDTH);
 	gtk_tree_view_column_set_resizable(column, TRUE);
 	gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view), column);
 	InterfaceData.rating_column = column;
 
-	column = gtk_tree_view_column_new_with_attributes("Score", text_renderer, "text", SCORE_COLUMN, NULL /* terminator */);
+	column = gtk_tree_view_column_new_with_attributes("Score", text_renderer, NULL /* terminator */);
+	gtk_tree_view_column_set_cell_data_func(column, text_renderer, interface_tree_int_cell_data_cb, GINT_TO_POINTER(WIDGET_SONG_MODEL_COLUMN_SCORE), NULL /* destroy */);
 	gtk_tree_view_column_set_min_width(column, COLUMN_MIN_WIDTH);
 	gtk_tree_view_column_set_resizable(column, TRUE);
 	gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view), column);
 	InterfaceData.score_column = column;
 
-	column = gtk_tree_view_column_new_with_attributes("Play count", text_renderer, "text", PLAYCOUNT_COLUMN, NULL /* terminator */);
+	column = gtk_tree_view_column_new_with_attributes("Play count", text_renderer, NULL /* terminator */);
+	gtk_tree_view_column_set_cell_data_func(column, text_renderer, interface_tree_int_cell_data_cb, GINT_TO_POINTER(WIDGET_SONG_MODEL_COLUMN_PLAYCOUNT), NULL /* destroy */);
 	gtk_tree_view_column_set_min_width(column, COLUMN_MIN_WIDTH);
 	gtk_tree_view_column_set_resizable(column, TRUE);
 	gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view), column);
 	InterfaceData.playcount_column = column;
 
-	column = gtk_tree_view_column_new_with_attributes("Skip count", text_renderer, "text", SKIPCOUNT_COLUMN, NULL /* terminator */);
+	column = gtk_tree_view_column_new_with_attributes("Skip count", text_renderer, NULL /* terminator */);
+	gtk_tree_view_column_set_cell_data_func(column, text_renderer, interface_tree_int_cell_data_cb, GINT_TO_POINTER(WIDGET_SONG_MODEL_COLUMN_SKIPCOUNT), NULL /* destroy */);
 	gtk_tree_view_column_set_min_width(column, COLUMN_MIN_WIDTH);
 	gtk_tree_view_column_set_resizable(column, TRUE);
 	gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view), column);
 	InterfaceData.skipcount_column = column;
 
-	column = gtk_tree_view_column_new_with_attributes("Last played", text_renderer, "text", LASTPLAYED_COLUMN, NULL /* terminator */);
+	column = gtk_tree_view_column_new_with_attributes("Last played", text_renderer, "text", WIDGET_SONG_MODEL_COLUMN_LASTPLAYED, NULL /* terminator */);
 	gtk_tree_view_column_set_min_width(column, COLUMN_MIN_WIDTH);
 	gtk_tree_view_column_set_resizable(column, TRUE);
 	gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view), column);
 	InterfaceData.lastplayed_column = column;
 
+	// Apply changes that did not make it into the library last time (see note [17] at module description)
+	interface_journal_init(interface_journal_compact_cb);
+	interface_journal_replay();
+
 	// Adding tree items
+	timer = g_timer_new();
+
 	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
 	{
 		interface_tree_add_item(song);
 	}
 
+	// Only attach the model when it is filled, so the view does not handle every single insertion
+	gtk_tree_view_set_model(GTK_TREE_VIEW(tree_view), InterfaceData.view_model);
+
+	g_debug("Populated the library view with %d rows in %.3f seconds", total_items, g_timer_elapsed(timer, NULL /* microseconds */));
+	g_timer_destroy(timer);
+
+	// Let the model follow the visibility of the columns (see note [10] at module description)
+	columns = gtk_tree_view_get_columns(GTK_TREE_VIEW(tree_view));
+
+	for (list = columns; list != NULL; list = list->next)
+	{
+		g_signal_connect(list->data, "notify::visible", G_CALLBACK(interface_tree_column_visibility_cb), NULL /* user_data */);
+		interface_tree_column_visibility_cb(list->data, NULL /* pspec */, NULL /* user_data */);
+
+		// Sort when the header is clicked (see note [12] at module description)
+		gtk_tree_view_column_set_clickable(list->data, TRUE);
+		g_signal_connect(list->data, "clicked", G_CALLBACK(interface_tree_column_clicked_cb), NULL /* user_data */);
+	}
+
+	g_list_free(columns);
+
 	// Hide columns if there is no information in them
 	interface_show_hide_columns();
 
+	// Do not measure all rows of large libraries (see note [9] at module description)
+	if (total_items >= LARGE_LIBRARY_ROWS)
+	{
+		interface_tree_set_fixed_sizing(pixbuf_renderer);
+	}
+
+	// Write the library in the background after changes (see note [16] at module description)
+	interface_writer_init(interface_library_written_cb);
+
+	if (!interface_journal_is_empty())
+	{
+		// Fold the replayed journal into the library
+		interface_writer_request(TRUE);
+	}
+
+	// Remember which files have not changed since their metadata was read (see note [20] at module description)
+	interface_cache_init();
+	interface_cache_prune();
+
+	// Add files in the background (see note [18] at module description)
+	interface_importer_init(interface_tree_add_item, interface_import_progress_cb, interface_import_done_cb);
+
+	// Read files in the background before refreshing their metadata (see note [19] at module description)
+	interface_prefetch_init(interface_prefetch_progress_cb, interface_prefetch_done_cb);
+
+	// Follow changes on disk in the watched folders (see note [22] at module description)
+	interface_watch_init(interface_watch_add_cb, interface_watch_remove_cb, interface_watch_changed_cb);
+
+	// Find songs that can't be played in the background (see note [23] at module description)
+	interface_integrity_init(interface_integrity_result_cb, interface_integrity_done_cb);
+
 	// Connect to player events (run function when statistics are updated)
 	wf_library_connect_event_stats_updated(interface_tree_update_all_stats_cb);
 
@@ -998,6 +1329,9 @@ interface_construct(WfApp *app)
 	{
 		interface_hide_window();
 	}
+
+	// Mark the songs that can't be played before anyone tries to
+	interface_integrity_sweep();
 }
 
 /* CONSTRUCTORS END */
@@ -1176,6 +1510,9 @@ interface_destroy_cb(GtkWidget *object, gpointer user_data)
 static void
 interface_preferences_closed_cb(const gchar *message)
 {
+	// Redraws the last played column only if the format changed
+	widget_song_model_set_last_played_timestamp(InterfaceData.tree_model, interface_settings_get_last_played_timestamp());
+
 	// Update statusbar in case there was a message
 	if (message != NULL)
 	{
@@ -1204,7 +1541,24 @@ interface_key_pressed_cb(GtkWidget *widget, GdkEventKey *event, gpointer user_da
 				handled = TRUE;
 				g_info("Key press: <Esc>");
 
-				interface_leave_fullscreen();
+				if (gtk_widget_has_focus(InterfaceData.search_entry))
+				{
+					// Clear the search query instead
+					gtk_entry_set_text(GTK_ENTRY(InterfaceData.search_entry), "");
+				}
+				else
+				{
+					interface_leave_fullscreen();
+				}
+				break;
+			case GDK_KEY_f:
+				if (event->state & GDK_CONTROL_MASK)
+				{
+					handled = TRUE;
+					g_info("Key press: <Ctrl>F");
+
+					gtk_widget_grab_focus(InterfaceData.search_entry);
+				}
 				break;
 			default:
 				// Do nothing
@@ -1328,7 +1682,6 @@ interface_open_items_cb(GtkWidget *widget, gpointer user_data)
 
 		// Destroy the chooser, so the user knows file selection is over
 		gtk_widget_destroy(dialog);
-		interface_update_gtk_events();
 
 		// Try adding items
 		interface_add_items(files, checks, skip_metadata);
@@ -1413,7 +1766,6 @@ interface_open_directory_cb(GtkWidget *widget, gpointer user_data)
 
 		// Destroy the chooser, so the user knows file selection is over
 		gtk_widget_destroy(dialog);
-		interface_update_gtk_events();
 
 		// Try adding items
 		interface_add_items(files, checks, skip_metadata);
@@ -1428,226 +1780,226 @@ interface_open_directory_cb(GtkWidget *widget, gpointer user_data)
 }
 
 static void
-interface_remove_items_cb(GtkWidget *widget, gpointer user_data)
+interface_watch_directory_cb(GtkWidget *widget, gpointer user_data)
 {
-	const gchar *name, *amount_str;
-	WfSong *song;
-	gint amount, count = 0;
-	gchar *string;
-	GList *rows, *l;
-	GSList *refs = NULL, *sl;
-	GtkTreeView *view;
-	GtkTreeModel *model;
-	GtkTreeSelection *selection;
-	GtkTreePath *path;
-	GtkTreeRowReference *row_ref;
-
-	g_debug("Event remove from list");
+	gint result;
+	GSList *files, *l;
+	GtkWidget *dialog;
 
-	view = InterfaceData.tree_view;
+	g_debug("Event watch directory.");
 
-	selection = gtk_tree_view_get_selection(view);
-	amount = gtk_tree_selection_count_selected_rows(selection);
+	dialog = gtk_file_chooser_dialog_new("Select one or multiple directories to keep the library in sync with",
+	                                     InterfaceData.main_window, GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER,
+	                                     "Cancel", GTK_RESPONSE_CANCEL,
+	                                     "Watch", GTK_RESPONSE_OK,
+	                                     NULL);
+	gtk_file_chooser_set_select_multiple(GTK_FILE_CHOOSER(dialog), TRUE);
 
-	if (amount <= 0)
-	{
-		g_info("Nothing selected");
-		interface_update_status("Nothing is selected");
-		return;
-	}
+	result = gtk_dialog_run(GTK_DIALOG(dialog));
 
-	// Confirm dialog
-	if (!interface_remove_confirm_dialog(amount))
+	if (result != GTK_RESPONSE_OK)
 	{
-		g_info("Action canceled by user");
+		gtk_widget_destroy(dialog);
 		return;
 	}
 
-	rows = gtk_tree_selection_get_selected_rows(selection, &model);
+	files = gtk_file_chooser_get_uris(GTK_FILE_CHOOSER(dialog));
+	gtk_widget_destroy(dialog);
 
-	// First convert all paths into rowreferences so they don't get invalid if items get removed
-	for (l = rows; l != NULL; l = l->next)
+	for (l = files; l != NULL; l = l->next)
 	{
-		path = l->data;
-
-		if (path == NULL)
-		{
-			continue;
-		}
-		else
-		{
-			// Convert the path into a row reference and add it to the list
-			row_ref = gtk_tree_row_reference_new(model, path);
-			refs = g_slist_append(refs, row_ref);
-		}
+		interface_watch_add_folder(l->data);
 	}
 
-	// Free the list containing the selection, we don't need it since we have the row references
-	g_list_free_full(rows, (GDestroyNotify) gtk_tree_path_free);
+	// Add what is in there already; From now on only changes are handled (see note [22] at module description)
+	interface_add_items(files, WF_LIBRARY_CHECK_AUDIO, FALSE /* skip_metadata */);
 
-	// Run through all rowreferences and remove them from the tree and the *struct from the library
-	for (sl = refs; sl != NULL; sl = sl->next)
-	{
-		row_ref = sl->data;
+	g_slist_free_full(files, g_free);
+}
 
-		if (row_ref == NULL)
-		{
-			continue;
-		}
+static void
+interface_watch_rescan_cb(GtkWidget *widget, gpointer user_data)
+{
+	g_debug("Event rescan watched directories.");
 
-		// Allocate here (see note [2] at module description)
-		GtkTreeIter iter;
+	if (*interface_settings_get_watch_folders() == '\0')
+	{
+		interface_update_status("No directories are being watched");
+	}
+	else if (interface_watch_rescan())
+	{
+		// The differences are handled like any reported change (see note [22] at module description)
+		interface_update_status("Rescanning watched directories in the background...");
+	}
+	else
+	{
+		interface_update_status("Already rescanning watched directories");
+	}
+}
 
-		// Get song
-		path = gtk_tree_row_reference_get_path(row_ref);
+static void
+interface_watch_stop_cb(GtkWidget *widget, gpointer user_data)
+{
+	g_debug("Event stop watching directories.");
 
-		if (gtk_tree_model_get_iter(model, &iter, path))
-		{
-			// Get the song from the tree
-			song = interface_tree_get_song_for_iter(model, &iter);
-			g_warn_if_fail(WF_IS_SONG(song));
+	interface_watch_clear();
+	interface_update_status("Stopped watching directories; The songs stay in the library");
+}
 
-			// Remove from the tree
-			gtk_tree_store_remove(InterfaceData.tree_store, &iter);
+static void
+interface_relocate_cb(GtkWidget *widget, gpointer user_data)
+{
+	GtkWidget *dialog, *grid, *label, *old_entry, *new_chooser;
+	gchar *old_uri, *new_uri, *message;
+	guint count;
+	gint result;
 
-			if (song != NULL)
-			{
-				// Copy the song name temporarily to use in a message after the song and it's name are freed
-				name = wf_song_get_name(song);
-				string = g_strdup(name);
+	g_debug("Event relocate directory.");
 
-				// Remove the item
-				wf_library_remove_song(song);
+	if (interface_importer_is_running() || interface_prefetch_is_running() || interface_relocate_is_running())
+	{
+		interface_update_status("Still adding or reading items, try again when done");
+		return;
+	}
 
-				g_object_unref(song);
-				g_free(string);
-				g_debug("Successfully removed %s", string);
-				count++;
-			}
-		}
-		else
-		{
-			g_warning("Song is not valid before removal");
-		}
+	dialog = gtk_dialog_new_with_buttons("Relocate directory", InterfaceData.main_window,
+	                                     GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+	                                     "Cancel", GTK_RESPONSE_CANCEL,
+	                                     "Relocate", GTK_RESPONSE_OK,
+	                                     NULL);
 
-		gtk_tree_path_free(path);
-	}
+	grid = gtk_grid_new();
+	gtk_grid_set_row_spacing(GTK_GRID(grid), 6);
+	gtk_grid_set_column_spacing(GTK_GRID(grid), 12);
+	gtk_container_set_border_width(GTK_CONTAINER(grid), 12);
+	gtk_container_add(GTK_CONTAINER(gtk_dialog_get_content_area(GTK_DIALOG(dialog))), grid);
 
-	// Write the library file
-	wf_library_write(FALSE);
+	// The old directory is most likely gone, so it can't be chosen with a file chooser
+	label = gtk_label_new("Old location:");
+	gtk_widget_set_halign(label, GTK_ALIGN_END);
+	gtk_grid_attach(GTK_GRID(grid), label, 0, 0, 1, 1);
 
-	interface_show_hide_columns();
+	old_entry = gtk_entry_new();
+	gtk_entry_set_placeholder_text(GTK_ENTRY(old_entry), "/media/music");
+	gtk_widget_set_hexpand(old_entry, TRUE);
+	gtk_grid_attach(GTK_GRID(grid), old_entry, 1, 0, 1, 1);
 
-	amount_str = wf_utils_string_to_single_multiple(count, "item", "items");
-	string = g_strdup_printf("Removed %d %s from the library", count, amount_str);
-	interface_update_status(string);
-	g_free(string);
+	label = gtk_label_new("New location:");
+	gtk_widget_set_halign(label, GTK_ALIGN_END);
+	gtk_grid_attach(GTK_GRID(grid), label, 0, 1, 1, 1);
 
-	g_slist_free_full(refs, (GDestroyNotify) gtk_tree_row_reference_free);
-}
+	new_chooser = gtk_file_chooser_button_new("Select the new location", GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER);
+	gtk_grid_attach(GTK_GRID(grid), new_chooser, 1, 1, 1, 1);
 
-static void
-interface_move_items_up_cb(GtkWidget *widget, gpointer user_data)
-{
-	WfSong *song;
-	WfSong *song_prev;
-	GtkTreeView *view;
-	GtkTreeModel *model;
-	GtkTreePath *path;
-	GtkTreeSelection *selection;
-	GtkTreeIter iter;
-	GtkTreeIter iter_prev;
-	GList *rows, *list;
+	gtk_widget_show_all(dialog);
 
-	view = InterfaceData.tree_view;
+	result = gtk_dialog_run(GTK_DIALOG(dialog));
 
-	selection = gtk_tree_view_get_selection(view);
+	old_uri = interface_relocate_dialog_get_uri(old_entry);
+	new_uri = gtk_file_chooser_get_uri(GTK_FILE_CHOOSER(new_chooser));
 
-	rows = gtk_tree_selection_get_selected_rows(selection, &model);
+	gtk_widget_destroy(dialog);
 
-	if (rows == NULL)
+	if (result != GTK_RESPONSE_OK || old_uri == NULL || new_uri == NULL)
 	{
-		interface_update_status("Nothing is selected");
+		g_free(old_uri);
+		g_free(new_uri);
+		return;
 	}
 
-	for (list = rows; list != NULL; list = list->next)
-	{
-		// Get node
-		path = list->data;
-		gtk_tree_model_get_iter(model, &iter, path);
-		iter_prev = iter;
-
-		// Get previous
-		if (!gtk_tree_model_iter_previous(model, &iter_prev))
-		{
-			continue;
-		}
-
-		// Get songs
-		song = interface_tree_get_song_for_iter(model, &iter);
-		song_prev = interface_tree_get_song_for_iter(model, &iter_prev);
+	// Only walks down the path (see note [24] at module description)
+	count = interface_relocate_count(old_uri);
 
-		// Move in library
-		wf_library_move_before(song, song_prev);
+	if (count == 0)
+	{
+		interface_update_status("No songs are in the old location");
+		g_free(old_uri);
+		g_free(new_uri);
+		return;
+	}
 
-		// Move in tree
-		gtk_tree_store_move_before(GTK_TREE_STORE(model), &iter, &iter_prev);
+	message = g_strdup_printf("Relocating %u %s keeps their ratings,\n"
+	                          "but their play and skip counts start over.\n"
+	                          "\nAre you sure you want to relocate them?",
+	                          count, wf_utils_string_to_single_multiple(count, "song", "songs"));
 
-		g_object_unref(song);
-		g_object_unref(song_prev);
+	if (interface_question_dialog_run(message) && interface_relocate_start(old_uri, new_uri))
+	{
+		// Continues at interface_relocate_done_cb()
+		interface_update_status("Looking for the songs in the new location...");
 	}
+
+	g_free(message);
+	g_free(old_uri);
+	g_free(new_uri);
 }
 
 static void
-interface_move_items_down_cb(GtkWidget *widget, gpointer user_data)
+interface_remove_items_cb(GtkWidget *widget, gpointer user_data)
 {
+	const gchar *amount_str;
 	WfSong *song;
-	WfSong *song_next;
-	GtkTreeView *view;
+	gint amount, count;
+	gchar *string;
+	GList *rows, *l;
+	GPtrArray *songs;
 	GtkTreeModel *model;
-	GtkTreePath *path;
 	GtkTreeSelection *selection;
-	GtkTreeIter iter;
-	GtkTreeIter iter_next;
-	GList *rows, *list;
-
-	view = InterfaceData.tree_view;
 
-	selection = gtk_tree_view_get_selection(view);
+	g_debug("Event remove from list");
 
-	rows = gtk_tree_selection_get_selected_rows(selection, &model);
+	selection = gtk_tree_view_get_selection(InterfaceData.tree_view);
+	amount = gtk_tree_selection_count_selected_rows(selection);
 
-	if (rows == NULL)
+	if (amount <= 0)
 	{
+		g_info("Nothing selected");
 		interface_update_status("Nothing is selected");
+		return;
+	}
+
+	// Confirm dialog
+	if (!interface_remove_confirm_dialog(amount))
+	{
+		g_info("Action canceled by user");
+		return;
 	}
 
-	for (list = rows; list != NULL; list = list->next)
+	rows = gtk_tree_selection_get_selected_rows(selection, &model);
+	songs = g_ptr_array_new_full(amount, g_object_unref);
+
+	// Collect the songs first, as the paths become invalid once rows get removed
+	for (l = rows; l != NULL; l = l->next)
 	{
-		// Get node
-		path = list->data;
-		gtk_tree_model_get_iter(model, &iter, path);
-		iter_next = iter;
+		song = interface_tree_get_song_for_path(model, l->data);
 
-		// Get next
-		if (!gtk_tree_model_iter_next(model, &iter_next))
+		if (song != NULL)
 		{
-			continue;
+			g_ptr_array_add(songs, song);
 		}
+	}
 
-		// Get songs
-		song = interface_tree_get_song_for_iter(model, &iter);
-		song_next = interface_tree_get_song_for_iter(model, &iter_next);
+	g_list_free_full(rows, (GDestroyNotify) gtk_tree_path_free);
 
-		// Move in library
-		wf_library_move_after(song, song_next);
+	count = interface_tree_remove_songs(songs);
+	g_ptr_array_free(songs, TRUE);
 
-		// Move in tree
-		gtk_tree_store_move_after(GTK_TREE_STORE(model), &iter, &iter_next);
+	amount_str = wf_utils_string_to_single_multiple(count, "item", "items");
+	string = g_strdup_printf("Removed %d %s from the library", count, amount_str);
+	interface_update_status(string);
+	g_free(string);
+}
 
-		g_object_unref(song);
-		g_object_unref(song_next);
-	}
+static void
+interface_move_items_up_cb(GtkWidget *widget, gpointer user_data)
+{
+	interface_tree_move_selection(FALSE);
+}
+
+static void
+interface_move_items_down_cb(GtkWidget *widget, gpointer user_data)
+{
+	interface_tree_move_selection(TRUE);
 }
 
 static void
@@ -1724,58 +2076,161 @@ interface_library_write_cb(GtkWidget *widget, gpointer user_data)
 {
 	g_debug("Event library write.");
 
-	if (wf_library_write(TRUE))
-	{
-		interface_update_status("Successfully written library to disk");
-	}
-	else
-	{
-		interface_update_status("Failed to write library");
-	}
+	// Write right away, including any write that was still pending; The result is reported by interface_library_written_cb()
+	interface_writer_request(TRUE);
+	interface_writer_flush();
 }
 
 static void
 interface_metadata_refresh_cb(GtkWidget *widget, gpointer user_data)
 {
-	gint amount;
+	GPtrArray *uris;
+	WfSong *song;
 
 	g_debug("Event refresh metadata.");
 
-	interface_update_status("Refreshing metadata...");
-
-	amount = wf_library_update_metadata();
+	uris = g_ptr_array_new_with_free_func(g_free);
 
-	if (amount > 0)
+	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
 	{
-		g_debug("%d items have been updated, refreshing interface...", amount);
-
-		interface_tree_update_song_data(interface_tree_update_song_metadata_cb);
-
-		interface_show_hide_columns();
+		g_ptr_array_add(uris, g_strdup(wf_song_get_uri(song)));
 	}
 
-	interface_update_status("Metadata refreshed");
+	interface_metadata_refresh_start(uris);
 }
 
 static void
-interface_fullscreen_toggle_cb(GtkCheckMenuItem *checkmenuitem, gpointer user_data)
+interface_integrity_sweep_cb(GtkWidget *widget, gpointer user_data)
 {
-	g_debug("Event fullscreen");
+	g_debug("Event check files.");
 
-	interface_toggle_fullscreen();
+	if (interface_integrity_is_running())
+	{
+		interface_update_status("Already checking files");
+		return;
+	}
+
+	interface_integrity_sweep();
 }
 
 static void
-interface_toggle_toolbar_cb(GtkCheckMenuItem *checkmenuitem, gpointer user_data)
+interface_metadata_refresh_selection_cb(GtkWidget *widget, gpointer user_data)
 {
-	gboolean active;
-
-	g_debug("Toggle toolbar");
+	GtkTreeSelection *selection;
+	GtkTreeModel *model;
+	GPtrArray *uris;
+	GList *rows, *l;
+	WfSong *song;
 
-	active = gtk_check_menu_item_get_active(checkmenuitem);
+	g_debug("Event refresh metadata of selection.");
 
-	interface_show_toolbar(active);
-}
+	selection = gtk_tree_view_get_selection(InterfaceData.tree_view);
+	rows = gtk_tree_selection_get_selected_rows(selection, &model);
+
+	if (rows == NULL)
+	{
+		interface_update_status("Nothing is selected");
+		return;
+	}
+
+	uris = g_ptr_array_new_with_free_func(g_free);
+
+	for (l = rows; l != NULL; l = l->next)
+	{
+		song = interface_tree_get_song_for_path(model, l->data);
+
+		if (song != NULL)
+		{
+			g_ptr_array_add(uris, g_strdup(wf_song_get_uri(song)));
+			g_object_unref(song);
+		}
+	}
+
+	g_list_free_full(rows, (GDestroyNotify) gtk_tree_path_free);
+
+	interface_metadata_refresh_start(uris);
+}
+
+// Check the files of @uris (transfer full) and refresh the metadata if any changed (see notes [19] and [20] at module description)
+static void
+interface_metadata_refresh_start(GPtrArray *uris)
+{
+	if (interface_importer_is_running() || interface_prefetch_is_running())
+	{
+		interface_update_status("Still adding or reading items, try again when done");
+		g_ptr_array_unref(uris);
+		return;
+	}
+
+	// Continues at interface_prefetch_done_cb()
+	if (interface_prefetch_start(uris))
+	{
+		interface_progress_window_create("Checking files. Stand by...");
+	}
+	else
+	{
+		// Nothing has been staged
+		interface_metadata_refresh(0);
+	}
+}
+
+// Read the metadata of the library again and commit the files staged in @stage
+static void
+interface_metadata_refresh(guint stage)
+{
+	gint amount;
+
+	interface_update_status("Refreshing metadata...");
+
+	amount = wf_library_update_metadata();
+
+	// Changed files in watched folders have been read as well (see note [22] at module description)
+	interface_watch_forget_changed();
+
+	if (amount > 0)
+	{
+		g_debug("%d items have been updated, refreshing interface...", amount);
+
+		interface_tree_update_song_data(interface_tree_update_song_metadata_cb);
+
+		interface_show_hide_columns();
+
+		// Songs may (not) match the search query anymore
+		interface_tree_refilter();
+
+		// Make comparing the changed songs cheap again
+		interface_sort_update();
+	}
+
+	// Files may have become (un)available, which no other event reports
+	interface_tree_update_all_song_icons();
+
+	// The metadata of the changed files has been read now (see note [20] at module description)
+	interface_cache_commit_all(stage);
+	interface_cache_write();
+
+	interface_update_status("Metadata refreshed");
+}
+
+static void
+interface_fullscreen_toggle_cb(GtkCheckMenuItem *checkmenuitem, gpointer user_data)
+{
+	g_debug("Event fullscreen");
+
+	interface_toggle_fullscreen();
+}
+
+static void
+interface_toggle_toolbar_cb(GtkCheckMenuItem *checkmenuitem, gpointer user_data)
+{
+	gboolean active;
+
+	g_debug("Toggle toolbar");
+
+	active = gtk_check_menu_item_get_active(checkmenuitem);
+
+	interface_show_toolbar(active);
+}
 
 static void
 interface_hide_window_cb(GtkWidget *widget, gpointer user_data)
@@ -1814,6 +2269,9 @@ interface_stop_after_song_cb(GtkWidget *widget, gpointer user_data)
 		return;
 	}
 
+	// Update the icons once all flags are toggled (see note [15] at module description)
+	interface_tree_edit_begin();
+
 	for (l = rows; l != NULL; l = l->next)
 	{
 		path = l->data;
@@ -1821,10 +2279,13 @@ interface_stop_after_song_cb(GtkWidget *widget, gpointer user_data)
 		song = interface_tree_get_song_for_path(model, path);
 
 		wf_app_toggle_stop(song);
+		interface_tree_edit_song(song);
 
 		g_object_unref(song);
 	}
 
+	interface_tree_edit_end(FALSE);
+
 	interface_update_status("Toggled stop flag for current selection");
 
 	g_list_free_full(rows, (GDestroyNotify) gtk_tree_path_free);
@@ -1889,6 +2350,9 @@ interface_toggle_queue_cb(GtkWidget *widget, gpointer user_data)
 		return;
 	}
 
+	// Update the icons once all songs are toggled (see note [15] at module description)
+	interface_tree_edit_begin();
+
 	for (l = rows; l != NULL; l = l->next)
 	{
 		path = l->data;
@@ -1896,10 +2360,13 @@ interface_toggle_queue_cb(GtkWidget *widget, gpointer user_data)
 		song = interface_tree_get_song_for_path(model, path);
 
 		wf_app_toggle_queue(song);
+		interface_tree_edit_song(song);
 
 		g_object_unref(song);
 	}
 
+	interface_tree_edit_end(FALSE);
+
 	interface_update_status("Toggled current selected songs in queue");
 
 	g_list_free_full(rows, (GDestroyNotify) gtk_tree_path_free);
@@ -1949,6 +2416,9 @@ interface_edit_rating_cb(GtkWidget *widget, gpointer user_data)
 
 	if (rating >= 0)
 	{
+		// Refresh and write once all ratings are set (see note [15] at module description)
+		interface_tree_edit_begin();
+
 		// Go over each selected item
 		for (l = rows; l != NULL; l = l->next)
 		{
@@ -1973,19 +2443,18 @@ interface_edit_rating_cb(GtkWidget *widget, gpointer user_data)
 
 			// Update song
 			wf_song_set_rating(song, rating);
-
-			// Update interface
-			interface_tree_update_song_stat_cb(InterfaceData.tree_store, &iter, song);
+			interface_journal_add_rating(song, rating);
+			interface_tree_edit_song(song);
 
 			g_object_unref(song);
 			altered++;
 		}
+
+		interface_tree_edit_end(altered > 0);
 	}
 
 	if (altered > 0)
 	{
-		wf_library_write(TRUE);
-
 		str = g_strdup_printf("Update rating of %d %s", altered, wf_utils_string_to_single_multiple(altered, "item", "items"));
 		interface_update_status(str);
 		g_free(str);
@@ -2016,15 +2485,17 @@ interface_scroll_to_playing_cb(GtkWidget *widget, gpointer user_data)
 	// Get the matching row
 	if (!interface_tree_get_iter_for_song(song, &iter))
 	{
-		g_warning("Could not get row to select");
+		interface_update_status("The song that is playing does not match the search query");
 		return;
 	}
 
 	// Get a matching path
-	path = gtk_tree_model_get_path(GTK_TREE_MODEL(InterfaceData.tree_store), &iter);
+	path = gtk_tree_model_get_path(InterfaceData.view_model, &iter);
 
 	// Scroll to it
 	interface_tree_scroll_to_row(path);
+
+	gtk_tree_path_free(path);
 }
 
 static void
@@ -2059,25 +2530,221 @@ interface_dialog_value_changed_cb(GtkWidget *widget, gpointer user_data)
 	}
 }
 
+// A batch of files has been added to the library (see note [18] at module description)
 static void
-interface_items_are_added_cb(WfSong *song, gint item, gint total)
+interface_import_progress_cb(gint handled, gint found, gboolean scanning)
 {
-	gdouble complete = 0.0;
+	// Show the songs of this batch (see note [8] at module description)
+	interface_tree_bulk_end();
+	interface_tree_bulk_begin();
 
-	if (song == NULL)
+	// The total is only known once all files have been found
+	if (!InterfaceData.import_silent)
+	{
+		interface_progress_window_update(handled, scanning ? -1 : found);
+	}
+}
+
+static void
+interface_prefetch_progress_cb(gint done, gint total)
+{
+	interface_progress_window_update(done, total);
+}
+
+static void
+interface_prefetch_done_cb(guint stage, gint changed, gboolean cancelled)
+{
+	interface_progress_window_destroy();
+
+	if (cancelled)
+	{
+		// None of the staged files have been read (see note [20] at module description)
+		interface_cache_discard(stage);
+		interface_update_status("Cancelled refreshing metadata");
+	}
+	else if (changed == 0)
+	{
+		// No need to have the back-end read every file again; Nothing has been staged either
+		interface_cache_discard(stage);
+		interface_update_status("Metadata is up-to-date");
+	}
+	else
+	{
+		// The files are cached now, so the back-end can read them quickly
+		interface_metadata_refresh(stage);
+	}
+}
+
+static void
+interface_import_done_cb(gint added, gboolean cancelled)
+{
+	gchar *string;
+
+	interface_tree_bulk_end();
+
+	if (InterfaceData.import_silent)
 	{
-		interface_progress_window_update(0.0);
+		InterfaceData.import_silent = FALSE;
 	}
 	else
 	{
-		if (item > 0 && total > 0)
+		interface_progress_window_destroy();
+	}
+
+	interface_report_items_added(added);
+
+	// Only now the old songs of the relocated files can go; The others stay (see note [24] at module description)
+	interface_tree_remove_relocated();
+
+	if (cancelled)
+	{
+		string = g_strdup_printf("Cancelled adding items; Added %d %s", added, wf_utils_string_to_single_multiple(added, "item", "items"));
+		interface_update_status(string);
+		g_free(string);
+	}
+}
+
+// Add files that appeared in a watched folder (see note [22] at module description)
+static gboolean
+interface_watch_add_cb(GSList *uris)
+{
+	return interface_add_items_silently(uris);
+}
+
+// Remove songs whose files were deleted from a watched folder (see note [22] at module description)
+static void
+interface_watch_remove_cb(GPtrArray *songs)
+{
+	gchar *string;
+	gint count;
+
+	count = interface_tree_remove_songs(songs);
+
+	string = g_strdup_printf("Removed %d %s that were deleted from disk", count, wf_utils_string_to_single_multiple(count, "item", "items"));
+	interface_update_status(string);
+	g_free(string);
+}
+
+// Files of songs changed in a watched folder; Only report them (see note [22] at module description)
+static void
+interface_watch_changed_cb(guint amount)
+{
+	gchar *string;
+
+	string = g_strdup_printf("%u %s changed on disk, refresh metadata to read them", amount, wf_utils_string_to_single_multiple((gint) amount, "file", "files"));
+	interface_update_status(string);
+	g_free(string);
+}
+
+// Move the songs that were found in the new location (see note [24] at module description)
+static void
+interface_relocate_done_cb(GPtrArray *songs, GPtrArray *uris, gint missing, gboolean cancelled)
+{
+	GSList *files = NULL;
+	gchar *string;
+	guint i;
+
+	if (cancelled)
+	{
+		interface_update_status("Cancelled relocating");
+		return;
+	}
+	else if (songs->len == 0)
+	{
+		string = g_strdup_printf("None of the %d %s were found in the new location", missing, wf_utils_string_to_single_multiple(missing, "song", "songs"));
+		interface_update_status(string);
+		g_free(string);
+		return;
+	}
+	else if (interface_importer_is_running() || interface_prefetch_is_running())
+	{
+		interface_update_status("Still adding or reading items, try again when done");
+		return;
+	}
+
+	for (i = 0; i < songs->len; i++)
+	{
+		// Continues at interface_tree_relocate_song() once the new file is added
+		g_hash_table_insert(InterfaceData.relocating, g_strdup(g_ptr_array_index(uris, i)), g_object_ref(g_ptr_array_index(songs, i)));
+
+		files = g_slist_prepend(files, g_ptr_array_index(uris, i));
+	}
+
+	files = g_slist_reverse(files);
+
+	// Songs that were not found stay where they are, so they can still be found later
+	g_debug("Relocating %u songs, %d not found in the new location", songs->len, missing);
+
+	interface_add_items(files, WF_LIBRARY_CHECK_NONE, FALSE /* skip_metadata */);
+
+	g_slist_free(files);
+}
+
+// Mark the row of a song of which the file can't be played (see note [23] at module description)
+static void
+interface_integrity_result_cb(WfSong *song, InterfaceIntegrityState state)
+{
+	GtkTreeIter iter;
+
+	// Removed from the library in the meantime
+	if (!widget_song_model_get_iter_for_song(InterfaceData.tree_model, song, &iter))
+	{
+		return;
+	}
+
+	g_hash_table_remove(InterfaceData.invalid_stale, song);
+
+	if (!g_hash_table_contains(InterfaceData.invalid_songs, song))
+	{
+		g_hash_table_add(InterfaceData.invalid_songs, g_object_ref(song));
+		interface_tree_update_song_status(InterfaceData.tree_model, song);
+	}
+}
+
+static void
+interface_integrity_done_cb(gint checked, gint missing, gint unreadable, gboolean cancelled)
+{
+	GHashTableIter iter;
+	GHashTable *stale;
+	gpointer song;
+	gchar *string;
+
+	stale = InterfaceData.invalid_stale;
+	InterfaceData.invalid_stale = NULL;
+
+	g_hash_table_iter_init(&iter, stale);
+
+	while (g_hash_table_iter_next(&iter, &song, NULL /* value */))
+	{
+		if (cancelled)
+		{
+			// Not checked again, so still assume the worst
+			g_hash_table_add(InterfaceData.invalid_songs, g_object_ref(song));
+		}
+		else
 		{
-			complete = (gfloat) item / (gfloat) total * 100.0;
+			// The file is back, so only update the rows that were marked
+			interface_tree_update_song_status(InterfaceData.tree_model, song);
 		}
+	}
 
-		interface_tree_add_item(song);
-		interface_progress_window_update(complete);
+	g_hash_table_destroy(stale);
+
+	if (cancelled)
+	{
+		string = g_strdup("Cancelled checking files");
+	}
+	else if (missing == 0 && unreadable == 0)
+	{
+		string = g_strdup_printf("Checked %d %s; All can be played", checked, wf_utils_string_to_single_multiple(checked, "file", "files"));
 	}
+	else
+	{
+		string = g_strdup_printf("Checked %d %s; %d missing, %d unreadable", checked, wf_utils_string_to_single_multiple(checked, "file", "files"), missing, unreadable);
+	}
+
+	interface_update_status(string);
+	g_free(string);
 }
 
 static void
@@ -2085,9 +2752,13 @@ interface_update_song_info_cb(WfApp *app, WfSong *song_previous, WfSong *song_cu
 {
 	InterfaceData.current_song = song_current;
 
+	// Remember the songs of which the statistics may change (see note [6] at module description)
+	interface_tree_mark_stats_dirty(song_previous);
+	interface_tree_mark_stats_dirty(song_current);
+
 	interface_set_song_labels(song_previous, song_current, song_next);
 
-	interface_tree_update_all_song_icons();
+	interface_tree_update_changed_song_icons(song_previous, song_current, song_next);
 }
 
 static void
@@ -2169,131 +2840,256 @@ interface_position_slider_updated_cb(GtkRange *range, gpointer user_data)
 }
 
 static void
-interface_tree_update_song_stat_cb(GtkTreeStore *store, GtkTreeIter *iter, WfSong *song)
+interface_tree_update_song_stat_cb(WidgetSongModel *model, WfSong *song)
 {
-	gint rating;
-	gchar *last_played;
-	gchar *str;
-
-	g_return_if_fail(store != NULL);
-	g_return_if_fail(iter != NULL);
+	g_return_if_fail(model != NULL);
 	g_return_if_fail(song != NULL);
 
-	if (interface_settings_get_last_played_timestamp()) // If bool is %TRUE
-	{
-		last_played = wf_song_get_played_on_as_string(song);
-	}
-	else
-	{
-		last_played = wf_song_get_last_played_as_string(song);
-	}
-
-	// Get rating
-	rating = wf_song_get_rating(song);
-
-	// Scale and round ratings to range 0-10 (see note [3] at module description)
-	rating = (rating + 5) / 10;
-
-	// Represent the rating as a string (and hide it when zero)
-	str = (rating == 0) ? NULL : g_strdup_printf("%d", rating);
-
-	// Set the values
-	gtk_tree_store_set(store, iter,
-	                   RATING_COLUMN, str,
-	                   SCORE_COLUMN, wf_utils_round(wf_song_get_score(song)), // Round the float so it shows the right score in the interface
-	                   PLAYCOUNT_COLUMN, wf_song_get_play_count(song),
-	                   SKIPCOUNT_COLUMN, wf_song_get_skip_count(song),
-	                   LASTPLAYED_COLUMN, last_played,
-	                   -1);
-
-	g_free(str);
-	g_free(last_played);
+	// Only redraws the row if any statistic actually changed
+	widget_song_model_refresh_stats(model, song);
 }
 
 static void
-interface_tree_update_song_metadata_cb(GtkTreeStore *store, GtkTreeIter *iter, WfSong *song)
+interface_tree_update_song_metadata_cb(WidgetSongModel *model, WfSong *song)
 {
-	gint track;
-	gchar *duration;
-	gchar *str = NULL;
-
-	g_return_if_fail(store != NULL);
-	g_return_if_fail(iter != NULL);
+	g_return_if_fail(model != NULL);
 	g_return_if_fail(song != NULL);
 
-	track = wf_song_get_track_number(song);
-	str = (track > 0) ? g_strdup_printf("%d", track) : NULL;
-	duration = wf_song_get_duration_string(song);
+	// Keep the search index up-to-date (see note [11] at module description)
+	interface_search_update_song(song);
 
-	/*
-	 * Do not fill the column with useless zeros if track numbers
-	 * aren't set for at least some of the songs.
-	 * The rest of the data are strings and therefore
-	 * are not set (and appear empty) if the pointer is NULL.
-	 */
-	gtk_tree_store_set(InterfaceData.tree_store, iter,
-	                   NUMBER_COLUMN, str,
-	                   TITLE_COLUMN, wf_song_get_title(song),
-	                   ARTIST_COLUMN, wf_song_get_artist(song),
-	                   ALBUM_COLUMN, wf_song_get_album(song),
-	                   DURATION_COLUMN, duration,
-	                   -1);
+	// Only the collation keys of this song need to be created again
+	interface_sort_invalidate_song(song);
 
-	g_free(str);
-	g_free(duration);
+	// The values are read from the song on redraw (see note [5] at module description)
+	widget_song_model_columns_changed(model, song, METADATA_COLUMNS);
 }
 
 static void
 interface_tree_update_all_stats_cb(void)
 {
-	// Update stats of all items
-	g_info("Updating song statistics in interface");
-
-	interface_tree_update_song_data(interface_tree_update_song_stat_cb);
-}
-
-static void
-interface_tree_update_all_song_icons(void)
-{
-	WfSong *song;
-	GtkTreeIter iter;
-	GtkTreeStore *store = InterfaceData.tree_store;
-	GtkTreeModel *model = GTK_TREE_MODEL(store);
+	GHashTableIter iter;
+	gpointer song;
+	gint changed;
 
-	if (wf_song_get_count() <= 0)
+	if (!InterfaceData.constructed)
 	{
-		// No items present; nothing to update
 		return;
 	}
-	else if (!gtk_tree_model_get_iter_first(model, &iter))
+
+	if (InterfaceData.edit_depth > 0)
 	{
-		g_warning("Could not get first row from tree");
+		// Handled once the edit is done (see note [15] at module description)
+		InterfaceData.edit_stats_pending = TRUE;
 		return;
 	}
 
-	// Update for each iter
-	do
+	// The song that is playing right now is always a candidate
+	interface_tree_mark_stats_dirty(InterfaceData.current_song);
+
+	if (g_hash_table_size(InterfaceData.stats_dirty) > 0)
 	{
-		// Get the song from the iter
-		song = interface_tree_get_song_for_iter(model, &iter);
+		// Only update the songs that may have changed (see note [6] at module description)
+		g_debug("Updating song statistics of %u songs in interface", g_hash_table_size(InterfaceData.stats_dirty));
 
-		// Now update the icon
-		interface_tree_update_song_status(store, &iter, song);
+		g_hash_table_iter_init(&iter, InterfaceData.stats_dirty);
 
-		g_object_unref(song);
-	} while (gtk_tree_model_iter_next(model, &iter));
+		while (g_hash_table_iter_next(&iter, &song, NULL /* value */))
+		{
+			interface_tree_update_song_stat_cb(InterfaceData.tree_model, song);
+		}
+
+		g_hash_table_remove_all(InterfaceData.stats_dirty);
+	}
+	else
+	{
+		// Don't know what changed; compare all rows
+		g_info("Updating song statistics in interface");
+
+		changed = widget_song_model_refresh_all_stats(InterfaceData.tree_model);
+
+		g_debug("Statistics of %d songs changed", changed);
+	}
 }
 
+// Start editing many songs at once (see note [15] at module description)
 static void
-interface_tree_update_song_status(GtkTreeStore *store, GtkTreeIter *iter, WfSong *song)
+interface_tree_edit_begin(void)
 {
-	SongStatusIcon status = STATUS_ICON_NONE;
-	GdkPixbuf *icon;
+	if (InterfaceData.edit_depth++ > 0)
+	{
+		// Nested in another edit
+		return;
+	}
 
-	g_return_if_fail(store != NULL);
-	g_return_if_fail(iter != NULL);
+	InterfaceData.edited_songs = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, NULL /* value_destroy_func */);
+	InterfaceData.edit_stats_pending = FALSE;
+	InterfaceData.edit_write = FALSE;
+}
+
+// Remember that @song has been edited within the current edit
+static void
+interface_tree_edit_song(WfSong *song)
+{
+	g_return_if_fail(InterfaceData.edited_songs != NULL);
+
+	if (song != NULL && !g_hash_table_contains(InterfaceData.edited_songs, song))
+	{
+		g_hash_table_add(InterfaceData.edited_songs, g_object_ref(song));
+	}
+}
+
+// Finish editing: Refresh every edited row once and save the changes if any edit asked to
+static void
+interface_tree_edit_end(gboolean write)
+{
+	GHashTableIter iter;
+	GHashTable *songs;
+	GTimer *timer;
+	gpointer song;
+
+	g_return_if_fail(InterfaceData.edit_depth > 0);
+
+	InterfaceData.edit_write |= write;
+
+	if (--InterfaceData.edit_depth > 0)
+	{
+		// The outer edit takes care of it
+		return;
+	}
+
+	timer = g_timer_new();
+	songs = InterfaceData.edited_songs;
+	InterfaceData.edited_songs = NULL;
+
+	g_hash_table_iter_init(&iter, songs);
+
+	while (g_hash_table_iter_next(&iter, &song, NULL /* value */))
+	{
+		// Both only emit "row-changed" if something actually changed
+		widget_song_model_refresh_stats(InterfaceData.tree_model, song);
+		interface_tree_update_song_status(InterfaceData.tree_model, song);
+
+		// Already up-to-date
+		g_hash_table_remove(InterfaceData.stats_dirty, song);
+	}
+
+	if (InterfaceData.edit_stats_pending)
+	{
+		// The back-end reported statistics changes while editing; Handle them only once
+		InterfaceData.edit_stats_pending = FALSE;
+		interface_tree_update_all_stats_cb();
+	}
+
+	if (InterfaceData.edit_write)
+	{
+		// The journal makes the edits safe; Only write the library once in a while (see note [17] at module description)
+		interface_journal_sync();
+
+		if (interface_journal_needs_compaction())
+		{
+			interface_writer_request(TRUE);
+		}
+	}
+
+	g_debug("Edited %u songs in %.3f ms", g_hash_table_size(songs), g_timer_elapsed(timer, NULL /* microseconds */) * 1000.0);
+
+	g_timer_destroy(timer);
+	g_hash_table_destroy(songs);
+}
+
+static void
+interface_tree_mark_stats_dirty(WfSong *song)
+{
+	if (song == NULL || InterfaceData.stats_dirty == NULL)
+	{
+		return;
+	}
+
+	if (!g_hash_table_contains(InterfaceData.stats_dirty, song))
+	{
+		g_hash_table_add(InterfaceData.stats_dirty, g_object_ref(song));
+	}
+}
+
+static void
+interface_tree_update_all_song_icons(void)
+{
+	WfSong *song;
+
+	if (wf_song_get_count() <= 0)
+	{
+		// No items present; nothing to update
+		return;
+	}
+
+	// Update for each song
+	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
+	{
+		interface_tree_update_song_status(InterfaceData.tree_model, song);
+	}
+}
+
+static void
+interface_tree_update_changed_song_icons(WfSong *song_previous, WfSong *song_current, WfSong *song_next)
+{
+	GHashTableIter iter;
+	GPtrArray *songs;
+	gpointer song;
+	guint i;
+
+	// Hold a reference as updating a song may drop it from the set (see note [7] at module description)
+	songs = g_ptr_array_new_with_free_func(g_object_unref);
+
+	g_hash_table_iter_init(&iter, InterfaceData.status_songs);
+
+	while (g_hash_table_iter_next(&iter, &song, NULL /* value */))
+	{
+		g_ptr_array_add(songs, g_object_ref(song));
+	}
+
+	if (song_previous != NULL)
+	{
+		g_ptr_array_add(songs, g_object_ref(song_previous));
+	}
+	if (song_current != NULL)
+	{
+		g_ptr_array_add(songs, g_object_ref(song_current));
+	}
+	if (song_next != NULL)
+	{
+		g_ptr_array_add(songs, g_object_ref(song_next));
+	}
+
+	for (i = 0; i < songs->len; i++)
+	{
+		interface_tree_update_song_status(InterfaceData.tree_model, g_ptr_array_index(songs, i));
+	}
+
+	g_ptr_array_free(songs, TRUE);
+}
+
+static void
+interface_tree_update_song_status(WidgetSongModel *model, WfSong *song)
+{
+	SongStatusIcon status;
+
+	g_return_if_fail(model != NULL);
 	g_return_if_fail(song != NULL);
 
+	status = interface_tree_get_song_status(song);
+
+	// Only redraws the row if the status is actually different
+	widget_song_model_set_status(model, song, status);
+
+	interface_tree_track_song_status(song, status);
+}
+
+static SongStatusIcon
+interface_tree_get_song_status(WfSong *song)
+{
+	SongStatusIcon status = STATUS_ICON_NONE;
+
 	if (wf_song_get_queued(song))
 	{
 		status = STATUS_ICON_QUEUED;
@@ -2307,6 +3103,12 @@ interface_tree_update_song_status(GtkTreeStore *store, GtkTreeIter *iter, WfSong
 		switch (wf_song_get_status(song))
 		{
 			case WF_SONG_AVAILABLE:
+				// The back-end doesn't know yet (see note [23] at module description)
+				if ((InterfaceData.invalid_songs != NULL && g_hash_table_contains(InterfaceData.invalid_songs, song)) ||
+				    (InterfaceData.invalid_stale != NULL && g_hash_table_contains(InterfaceData.invalid_stale, song)))
+				{
+					status = STATUS_ICON_INVALID;
+				}
 				break;
 			case WF_SONG_PLAYING:
 				status = STATUS_ICON_PLAYING;
@@ -2316,17 +3118,111 @@ interface_tree_update_song_status(GtkTreeStore *store, GtkTreeIter *iter, WfSong
 		}
 	}
 
-	icon = interface_get_pixbuf_icon(status);
+	return status;
+}
+
+// Keep track of the songs that show an icon (see note [7] at module description)
+static void
+interface_tree_track_song_status(WfSong *song, SongStatusIcon status)
+{
+	if (InterfaceData.status_songs == NULL)
+	{
+		return;
+	}
+	else if (status == STATUS_ICON_NONE)
+	{
+		g_hash_table_remove(InterfaceData.status_songs, song);
+	}
+	else if (!g_hash_table_contains(InterfaceData.status_songs, song))
+	{
+		g_hash_table_add(InterfaceData.status_songs, g_object_ref(song));
+	}
+}
+
+static void
+interface_tree_status_cell_data_cb(GtkTreeViewColumn *column, GtkCellRenderer *cell, GtkTreeModel *model, GtkTreeIter *iter, gpointer data)
+{
+	cairo_surface_t *icon;
+	GtkWidget *view;
+	gint status;
+
+	gtk_tree_model_get(model, iter, WIDGET_SONG_MODEL_COLUMN_STATUS, &status, -1);
+
+	view = gtk_tree_view_column_get_tree_view(column);
+
+	// The icon is shared by all rows, so no reference is taken here
+	icon = interface_get_status_icon((SongStatusIcon) status, gtk_widget_get_scale_factor(view));
+
+	g_object_set(cell, "surface", icon, NULL /* terminator */);
+}
+
+// Show the integer in the model column passed as @data
+static void
+interface_tree_int_cell_data_cb(GtkTreeViewColumn *column, GtkCellRenderer *cell, GtkTreeModel *model, GtkTreeIter *iter, gpointer data)
+{
+	gchar str[16];
+	gint value;
+
+	gtk_tree_model_get(model, iter, GPOINTER_TO_INT(data), &value, -1);
+
+	g_snprintf(str, sizeof(str), "%d", value);
+
+	g_object_set(cell, "text", str, NULL /* terminator */);
+}
+
+// Like interface_tree_int_cell_data_cb(), but shows nothing for zero
+static void
+interface_tree_number_cell_data_cb(GtkTreeViewColumn *column, GtkCellRenderer *cell, GtkTreeModel *model, GtkTreeIter *iter, gpointer data)
+{
+	gchar str[16];
+	gint value;
+
+	gtk_tree_model_get(model, iter, GPOINTER_TO_INT(data), &value, -1);
+
+	// Do not fill the column with useless zeros if numbers aren't set for at least some of the songs
+	if (value > 0)
+	{
+		g_snprintf(str, sizeof(str), "%d", value);
+		g_object_set(cell, "text", str, NULL /* terminator */);
+	}
+	else
+	{
+		g_object_set(cell, "text", NULL, NULL /* terminator */);
+	}
+}
+
+static void
+interface_tree_rating_cell_data_cb(GtkTreeViewColumn *column, GtkCellRenderer *cell, GtkTreeModel *model, GtkTreeIter *iter, gpointer data)
+{
+	gchar str[16];
+	gint rating;
+
+	gtk_tree_model_get(model, iter, WIDGET_SONG_MODEL_COLUMN_RATING, &rating, -1);
+
+	// Scale and round ratings to range 0-10 (see note [3] at module description)
+	rating = (rating + 5) / 10;
+
+	// Hide the rating when zero
+	if (rating > 0)
+	{
+		g_snprintf(str, sizeof(str), "%d", rating);
+		g_object_set(cell, "text", str, NULL /* terminator */);
+	}
+	else
+	{
+		g_object_set(cell, "text", NULL, NULL /* terminator */);
+	}
+}
+
+static void
+interface_tree_scale_factor_changed_cb(GObject *object, GParamSpec *pspec, gpointer user_data)
+{
+	g_debug("Scale factor changed, reloading icons");
 
-	// Set the values
-	gtk_tree_store_set(store, iter,
-	                   URI_COLUMN, wf_song_get_uri(song),
-	                   NAME_COLUMN, wf_song_get_name(song),
-	                   STATUS_COLUMN, icon,
-	                   SONGOBJ_COLUMN, song,
-	                   -1);
+	// Icons of the old scale factor are not needed anymore
+	icons_clear_cache();
 
-	g_clear_object(&icon);
+	gtk_widget_queue_draw(GTK_WIDGET(object));
 }
 
 static void
@@ -2368,6 +3264,27 @@ interface_tree_activated_cb(GtkTreeView *view, GtkTreePath *path, GtkTreeViewCol
 	g_object_unref(song);
 }
 
+static gboolean
+interface_drag_drop_cb(GtkWidget *widget, GdkDragContext *context, gint x, gint y, guint time, gpointer user_data)
+{
+	GdkAtom target;
+
+	// The tree view can only handle drops on models that are drag destinations (see note [5] at module description)
+	g_signal_stop_emission_by_name(widget, "drag-drop");
+
+	target = gtk_drag_dest_find_target(widget, context, NULL /* target_list */);
+
+	if (target == GDK_NONE)
+	{
+		return FALSE;
+	}
+
+	// Continues at interface_drag_data_received_cb()
+	gtk_drag_get_data(widget, context, target, time);
+
+	return TRUE;
+}
+
 static void interface_drag_data_received_cb(GtkWidget *widget,
                                             GdkDragContext *context,
                                             gint x,
@@ -2377,11 +3294,21 @@ static void interface_drag_data_received_cb(GtkWidget *widget,
                                             guint time,
                                             gpointer user_data)
 {
+	GSList *list = NULL;
 	gchar **files;
-	gint amount;
+	gint i;
 
 	g_info("Drag & drop data received");
 
+	// Don't let the tree view handle it (see note [5] at module description)
+	g_signal_stop_emission_by_name(widget, "drag-data-received");
+
+	if (info == DRAG_TARGET_ROWS)
+	{
+		gtk_drag_finish(context, interface_tree_drop_rows(x, y), FALSE /* del */, time);
+		return;
+	}
+
 	files = gtk_selection_data_get_uris(data);
 
 	if (files == NULL)
@@ -2392,18 +3319,45 @@ static void interface_drag_data_received_cb(GtkWidget *widget,
 	{
 		gtk_drag_finish(context, TRUE, FALSE, time);
 
-		// Create progress window
-		interface_progress_window_create("Adding new items. Standy by...");
-
-		// Add items
-		amount = wf_library_add_strv(files, interface_items_are_added_cb, 0, FALSE);
+		for (i = g_strv_length(files); i-- > 0;)
+		{
+			list = g_slist_prepend(list, files[i]);
+		}
 
-		// Progress done
-		interface_progress_window_destroy();
+		// The importer copies the list
+		interface_add_items(list, 0, FALSE);
 
+		g_slist_free(list);
 		g_strfreev(files);
+	}
+}
+
+// Fold the journal into the library once it has been around for a while (see note [17] at module description)
+static void
+interface_journal_compact_cb(void)
+{
+	interface_writer_request(TRUE);
+}
+
+static void
+interface_library_written_cb(gboolean success, gboolean forced)
+{
+	if (success && forced)
+	{
+		// Everything in the journal is part of the library now (see note [17] at module description)
+		interface_journal_clear();
+	}
+
+	if (success)
+	{
+		interface_update_status("Changes written to disk");
+	}
+	else
+	{
+		// The journal still holds the changes, so try again later (see note [17] at module description)
+		interface_journal_schedule_compaction();
 
-		interface_report_items_added(amount);
+		interface_update_status("Failed to write library");
 	}
 }
 
@@ -2616,208 +3570,1127 @@ interface_update_playback_position(gdouble position, gdouble duration)
 		// Calculate the progress percentage
 		percentage = (position / duration) * 100.0;
 
-		// Set the label text
-		gtk_label_set_text(InterfaceData.position_start, str_start);
-		gtk_label_set_text(InterfaceData.position_end, str_end);
+		// Set the label text
+		gtk_label_set_text(InterfaceData.position_start, str_start);
+		gtk_label_set_text(InterfaceData.position_end, str_end);
+
+		// Set slider position (seconds)
+		gtk_range_set_value(InterfaceData.position_slider, percentage);
+
+		// Set sensitivity so the user can interact
+		gtk_widget_set_sensitive(GTK_WIDGET(InterfaceData.position_slider), TRUE);
+	}
+
+	// Re-enable slider update signal
+	g_signal_handler_unblock(InterfaceData.position_slider, InterfaceData.position_updated_handler);
+}
+
+static void
+interface_update_position_slider_marks(void)
+{
+	GtkStyleContext *style;
+	gint min;
+	gint max;
+
+	// First clear the old marks
+	gtk_scale_clear_marks(GTK_SCALE(InterfaceData.position_slider));
+
+	// Get the positions of the marks
+	min = wf_settings_static_get_double(WF_SETTING_MIN_PLAYED_FRACTION);
+	max = wf_settings_static_get_double(WF_SETTING_FULL_PLAYED_FRACTION);
+
+	// Add marks
+	gtk_scale_add_mark(GTK_SCALE(InterfaceData.position_slider), min, GTK_POS_TOP, NULL);
+	gtk_scale_add_mark(GTK_SCALE(InterfaceData.position_slider), max, GTK_POS_TOP, NULL);
+
+	// Remove the pointed style of the button on the slider
+	style = gtk_widget_get_style_context(GTK_WIDGET(InterfaceData.position_slider));
+	gtk_style_context_remove_class(style, "marks-before");
+}
+
+void interface_tree_add_item(WfSong *song)
+{
+	SongStatusIcon status;
+
+	g_return_if_fail(WF_IS_SONG(song));
+
+	// Take over from the old song of a relocated file (see note [24] at module description)
+	interface_tree_relocate_song(song);
+
+	if (InterfaceData.bulk_songs != NULL)
+	{
+		// Add it later (see note [8] at module description)
+		g_ptr_array_add(InterfaceData.bulk_songs, g_object_ref(song));
+		return;
+	}
+
+	// The status is the only information the row keeps itself
+	status = interface_tree_get_song_status(song);
+
+	// Make it searchable before adding it, so the filter knows if it matches (see note [11] at module description)
+	interface_search_add_song(song);
+	interface_relocate_add_song(song);
+
+	// Add item (see note [5] at module description)
+	widget_song_model_append(InterfaceData.tree_model, song, status);
+
+	interface_tree_track_song_status(song, status);
+}
+
+// Switch all columns and rows to a fixed size (see note [9] at module description)
+static void
+interface_tree_set_fixed_sizing(GtkCellRenderer *status_renderer)
+{
+	GtkTreeViewColumn *column;
+	GHashTable *widths;
+	GList *columns, *l;
+	const gchar *stored;
+	gchar **pairs, **pair;
+	gpointer value;
+	gint xpad, width;
+
+	g_info("Large library, using fixed column widths and row heights");
+
+	InterfaceData.large_library = TRUE;
+
+	// Parse the stored widths
+	widths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL /* value_destroy_func */);
+	stored = interface_settings_get_column_widths();
+	pairs = (stored == NULL) ? NULL : g_strsplit(stored, ";", -1);
+
+	for (pair = pairs; pair != NULL && *pair != NULL; pair++)
+	{
+		gchar **parts = g_strsplit(*pair, "=", 2);
+
+		if (parts[0] != NULL && parts[1] != NULL)
+		{
+			width = (gint) g_ascii_strtoll(parts[1], NULL, 10);
+
+			if (width >= COLUMN_MIN_WIDTH)
+			{
+				g_hash_table_replace(widths, g_strdup(parts[0]), GINT_TO_POINTER(width));
+			}
+		}
+
+		g_strfreev(parts);
+	}
+
+	g_strfreev(pairs);
+
+	columns = gtk_tree_view_get_columns(InterfaceData.tree_view);
+
+	for (l = columns; l != NULL; l = l->next)
+	{
+		column = l->data;
+
+		gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+
+		if (interface_tree_column_get_model_column(column) == WIDGET_SONG_MODEL_COLUMN_STATUS)
+		{
+			// The status column only ever shows an icon
+			gtk_cell_renderer_get_padding(status_renderer, &xpad, NULL /* ypad */);
+			width = ICONS_THEMED_SIZE + 2 * xpad;
+		}
+		else if (g_hash_table_lookup_extended(widths, gtk_tree_view_column_get_title(column), NULL /* orig_key */, &value))
+		{
+			width = GPOINTER_TO_INT(value);
+		}
+		else if (gtk_tree_view_column_get_visible(column))
+		{
+			width = interface_tree_estimate_column_width(column);
+		}
+		else
+		{
+			// Postpone measuring until it gets shown (see note [10] at module description)
+			g_object_set_data(G_OBJECT(column), "estimate-width", GINT_TO_POINTER(TRUE));
+			width = COLUMN_PLACEHOLDER_WIDTH;
+		}
+
+		gtk_tree_view_column_set_fixed_width(column, width);
+	}
+
+	g_list_free(columns);
+	g_hash_table_destroy(widths);
+
+	// Only possible now that all columns have a fixed width
+	gtk_tree_view_set_fixed_height_mode(InterfaceData.tree_view, TRUE);
+}
+
+// Get the model column that a tree view column shows
+static gint
+interface_tree_column_get_model_column(GtkTreeViewColumn *column)
+{
+	if (column == InterfaceData.uri_column)
+	{
+		return WIDGET_SONG_MODEL_COLUMN_URI;
+	}
+	else if (column == InterfaceData.filename_column)
+	{
+		return WIDGET_SONG_MODEL_COLUMN_NAME;
+	}
+	else if (column == InterfaceData.track_number_column)
+	{
+		return WIDGET_SONG_MODEL_COLUMN_NUMBER;
+	}
+	else if (column == InterfaceData.title_column)
+	{
+		return WIDGET_SONG_MODEL_COLUMN_TITLE;
+	}
+	else if (column == InterfaceData.artist_column)
+	{
+		return WIDGET_SONG_MODEL_COLUMN_ARTIST;
+	}
+	else if (column == InterfaceData.album_column)
+	{
+		return WIDGET_SONG_MODEL_COLUMN_ALBUM;
+	}
+	else if (column == InterfaceData.duration_column)
+	{
+		return WIDGET_SONG_MODEL_COLUMN_DURATION;
+	}
+	else if (column == InterfaceData.rating_column)
+	{
+		return WIDGET_SONG_MODEL_COLUMN_RATING;
+	}
+	else if (column == InterfaceData.score_column)
+	{
+		return WIDGET_SONG_MODEL_COLUMN_SCORE;
+	}
+	else if (column == InterfaceData.playcount_column)
+	{
+		return WIDGET_SONG_MODEL_COLUMN_PLAYCOUNT;
+	}
+	else if (column == InterfaceData.skipcount_column)
+	{
+		return WIDGET_SONG_MODEL_COLUMN_SKIPCOUNT;
+	}
+	else if (column == InterfaceData.lastplayed_column)
+	{
+		return WIDGET_SONG_MODEL_COLUMN_LASTPLAYED;
+	}
+
+	return WIDGET_SONG_MODEL_COLUMN_STATUS;
+}
+
+static void
+interface_tree_column_visibility_cb(GObject *object, GParamSpec *pspec, gpointer user_data)
+{
+	GtkTreeViewColumn *column = GTK_TREE_VIEW_COLUMN(object);
+	gboolean visible;
+
+	if (InterfaceData.tree_model == NULL)
+	{
+		return;
+	}
+
+	visible = gtk_tree_view_column_get_visible(column);
+
+	// Changes in hidden columns are ignored (see note [10] at module description)
+	widget_song_model_set_column_visible(InterfaceData.tree_model, interface_tree_column_get_model_column(column), visible);
+
+	// Changes would not move the rows anymore, so stop sorting by a column that is hidden
+	if (!visible && gtk_tree_view_column_get_sort_indicator(column))
+	{
+		interface_sort_unset();
+		interface_tree_update_sort_indicators();
+	}
+
+	if (visible && g_object_get_data(object, "estimate-width") != NULL)
+	{
+		g_object_set_data(object, "estimate-width", NULL);
+		g_idle_add_full(G_PRIORITY_LOW, interface_tree_estimate_column_width_cb, g_object_ref(column), g_object_unref);
+	}
+}
+
+// Sort by the column, or reverse the order if already sorted by it (see note [12] at module description)
+static void
+interface_tree_column_clicked_cb(GtkTreeViewColumn *column, gpointer user_data)
+{
+	GtkSortType order = GTK_SORT_ASCENDING;
+	gint model_column, sort_column;
+
+	model_column = interface_tree_column_get_model_column(column);
+
+	if (model_column == WIDGET_SONG_MODEL_COLUMN_STATUS)
+	{
+		interface_sort_unset();
+		interface_update_status("Showing items in library order");
+	}
+	else
+	{
+		if (interface_sort_get_column(&sort_column, &order) && sort_column == model_column)
+		{
+			order = (order == GTK_SORT_ASCENDING) ? GTK_SORT_DESCENDING : GTK_SORT_ASCENDING;
+		}
+		else
+		{
+			order = GTK_SORT_ASCENDING;
+		}
+
+		interface_sort_set_column(model_column, order);
+	}
+
+	interface_tree_update_sort_indicators();
+}
+
+// Only show the arrow in the header of the column that is sorted by
+static void
+interface_tree_update_sort_indicators(void)
+{
+	GtkTreeViewColumn *column;
+	GtkSortType order = GTK_SORT_ASCENDING;
+	GList *columns, *l;
+	gint sort_column = WIDGET_SONG_MODEL_COLUMN_STATUS;
+	gboolean sorted;
+
+	sorted = interface_sort_get_column(&sort_column, &order);
+
+	columns = gtk_tree_view_get_columns(InterfaceData.tree_view);
+
+	for (l = columns; l != NULL; l = l->next)
+	{
+		column = l->data;
+
+		if (sorted && interface_tree_column_get_model_column(column) == sort_column)
+		{
+			gtk_tree_view_column_set_sort_order(column, order);
+			gtk_tree_view_column_set_sort_indicator(column, TRUE);
+		}
+		else
+		{
+			gtk_tree_view_column_set_sort_indicator(column, FALSE);
+		}
+	}
+
+	g_list_free(columns);
+}
+
+static gboolean
+interface_tree_estimate_column_width_cb(gpointer user_data)
+{
+	GtkTreeViewColumn *column = user_data;
+
+	// The column may have been destroyed together with the tree view in the meantime
+	if (gtk_tree_view_column_get_tree_view(column) != NULL)
+	{
+		gtk_tree_view_column_set_fixed_width(column, interface_tree_estimate_column_width(column));
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+// Estimate a column width by measuring the text of an evenly spread sample of rows
+static gint
+interface_tree_estimate_column_width(GtkTreeViewColumn *column)
+{
+	GtkTreeModel *model = GTK_TREE_MODEL(InterfaceData.tree_model);
+	GtkWidget *view = GTK_WIDGET(InterfaceData.tree_view);
+	PangoLayout *layout;
+	GtkTreeIter iter;
+	GList *cells;
+	gint total, step, row;
+	gint text_width, width;
+	gint model_column;
+	gint xpad = 0;
+
+	model_column = interface_tree_column_get_model_column(column);
+
+	// Start with the width of the header
+	layout = gtk_widget_create_pango_layout(view, gtk_tree_view_column_get_title(column));
+	pango_layout_get_pixel_size(layout, &width, NULL /* height */);
+
+	total = gtk_tree_model_iter_n_children(model, NULL /* iter */);
+	step = MAX(1, total / COLUMN_WIDTH_SAMPLES);
+
+	for (row = 0; row < total; row += step)
+	{
+		GValue value = G_VALUE_INIT;
+		GValue text = G_VALUE_INIT;
+
+		if (!gtk_tree_model_iter_nth_child(model, &iter, NULL /* parent */, row))
+		{
+			break;
+		}
+
+		gtk_tree_model_get_value(model, &iter, model_column, &value);
+		g_value_init(&text, G_TYPE_STRING);
+
+		if (g_value_transform(&value, &text) && g_value_get_string(&text) != NULL)
+		{
+			pango_layout_set_text(layout, g_value_get_string(&text), -1);
+			pango_layout_get_pixel_size(layout, &text_width, NULL /* height */);
+
+			width = MAX(width, text_width);
+		}
+
+		g_value_unset(&text);
+		g_value_unset(&value);
+	}
+
+	g_object_unref(layout);
+
+	// Add the padding of the cell
+	cells = gtk_cell_layout_get_cells(GTK_CELL_LAYOUT(column));
+
+	if (cells != NULL)
+	{
+		gtk_cell_renderer_get_padding(cells->data, &xpad, NULL /* ypad */);
+		g_list_free(cells);
+	}
+
+	width += 2 * xpad;
+
+	return CLAMP(width, COLUMN_MIN_WIDTH, COLUMN_MAX_ESTIMATED_WIDTH);
+}
+
+// Store the widths of all columns in the settings (see note [9] at module description)
+static void
+interface_tree_store_column_widths(void)
+{
+	GtkTreeViewColumn *column;
+	const gchar *title;
+	GList *columns, *l;
+	GString *widths;
+
+	if (!InterfaceData.large_library)
+	{
+		return;
+	}
+
+	widths = g_string_new(NULL);
+	columns = gtk_tree_view_get_columns(InterfaceData.tree_view);
+
+	for (l = columns; l != NULL; l = l->next)
+	{
+		column = l->data;
+		title = gtk_tree_view_column_get_title(column);
+
+		// Skip the status column
+		if (title == NULL || *title == '\0')
+		{
+			continue;
+		}
+
+		if (widths->len > 0)
+		{
+			g_string_append_c(widths, ';');
+		}
+
+		g_string_append_printf(widths, "%s=%d", title, gtk_tree_view_column_get_fixed_width(column));
+	}
+
+	g_list_free(columns);
+
+	// Only write the settings file if anything changed
+	if (g_strcmp0(widths->str, interface_settings_get_column_widths()) != 0)
+	{
+		interface_settings_set_column_widths(widths->str);
+		wf_settings_write();
+	}
+
+	g_string_free(widths, TRUE);
+}
+
+// Start collecting new songs instead of adding them one by one (see note [8] at module description)
+static void
+interface_tree_bulk_begin(void)
+{
+	if (InterfaceData.bulk_songs == NULL)
+	{
+		InterfaceData.bulk_songs = g_ptr_array_new_with_free_func(g_object_unref);
+	}
+}
+
+// Add all collected songs to the tree at once
+static void
+interface_tree_bulk_end(void)
+{
+	GtkTreeSelection *selection;
+	GPtrArray *songs;
+	GTimer *timer;
+	gboolean detach;
+	guint i;
+
+	songs = InterfaceData.bulk_songs;
+	InterfaceData.bulk_songs = NULL;
+
+	if (songs == NULL)
+	{
+		return;
+	}
+
+	timer = g_timer_new();
+	detach = (songs->len >= BULK_DETACH_THRESHOLD);
+	selection = gtk_tree_view_get_selection(InterfaceData.tree_view);
+
+	if (detach)
+	{
+		// Detaching the model clears the selection; don't handle every deselected row
+		g_signal_handler_block(selection, InterfaceData.tree_select_handler);
+		gtk_tree_view_set_model(InterfaceData.tree_view, NULL);
+	}
+
+	for (i = 0; i < songs->len; i++)
+	{
+		interface_tree_add_item(g_ptr_array_index(songs, i));
+	}
+
+	if (detach)
+	{
+		gtk_tree_view_set_model(InterfaceData.tree_view, InterfaceData.view_model);
+		g_signal_handler_unblock(selection, InterfaceData.tree_select_handler);
+
+		// Handle the lost selection only once
+		interface_selection_changed_cb(selection, NULL /* user_data */);
+	}
+
+	g_debug("Added %u rows to the library view in %.3f seconds", songs->len, g_timer_elapsed(timer, NULL /* microseconds */));
+
+	g_timer_destroy(timer);
+	g_ptr_array_free(songs, TRUE);
+}
+
+// Start adding files in the background; Continues at interface_import_done_cb() (see note [18] at module description)
+static void
+interface_add_items(GSList *files, WfLibraryFileChecks checks, gboolean skip_metadata)
+{
+	if (files == NULL)
+	{
+		interface_report_items_added(0);
+		return;
+	}
+
+	if (interface_prefetch_is_running() || !interface_importer_start(files, checks, skip_metadata))
+	{
+		interface_update_status("Still adding or reading items, try again when done");
+		return;
+	}
+
+	// Create progress window
+	interface_progress_window_create("Adding new items. Standy by...");
+
+	// Collect the new songs and add them per batch (see note [8] at module description)
+	interface_tree_bulk_begin();
+}
+
+// Like interface_add_items(), but only reported in the status bar; Returns %FALSE if busy (see note [22] at module description)
+static gboolean
+interface_add_items_silently(GSList *files)
+{
+	if (interface_prefetch_is_running() || !interface_importer_start(files, WF_LIBRARY_CHECK_AUDIO, FALSE /* skip_metadata */))
+	{
+		return FALSE;
+	}
+
+	InterfaceData.import_silent = TRUE;
+
+	interface_update_status("Adding new files from watched folders...");
+
+	// Collect the new songs and add them per batch (see note [8] at module description)
+	interface_tree_bulk_begin();
+
+	return TRUE;
+}
+
+// Check the files of all songs in the background; Continues at interface_integrity_done_cb() (see note [23] at module description)
+static void
+interface_integrity_sweep(void)
+{
+	GPtrArray *songs;
+	WfSong *song;
+
+	if (interface_integrity_is_running())
+	{
+		return;
+	}
+
+	songs = g_ptr_array_new_with_free_func(g_object_unref);
+
+	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
+	{
+		g_ptr_array_add(songs, g_object_ref(song));
+	}
+
+	// Marks stay until the check is done, then the ones not found again are cleared
+	InterfaceData.invalid_stale = InterfaceData.invalid_songs;
+	InterfaceData.invalid_songs = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, NULL /* value_destroy_func */);
+
+	if (interface_integrity_start(songs))
+	{
+		interface_update_status("Checking files in the background...");
+	}
+	else
+	{
+		// Nothing is checked, so the old marks stay as they are
+		g_hash_table_destroy(InterfaceData.invalid_songs);
+		InterfaceData.invalid_songs = InterfaceData.invalid_stale;
+		InterfaceData.invalid_stale = NULL;
+
+		interface_update_status("Failed to start checking files");
+	}
+}
+
+static void
+interface_update_toolbar(gint items_selected, gint items_total)
+{
+	GtkWidget *widget;
+	GSList *l;
+	gboolean clickable;
+
+	g_info("Updated toolbar button sensitivity");
+
+	// Change labels
+	if (items_selected == 1)
+	{
+		gtk_tool_item_set_tooltip_text(GTK_TOOL_ITEM(InterfaceData.remove), "Remove selected track from the library");
+		gtk_tool_item_set_tooltip_text(GTK_TOOL_ITEM(InterfaceData.queue), "Toggle selected track in the queue");
+		gtk_tool_item_set_tooltip_text(GTK_TOOL_ITEM(InterfaceData.stop), "Toggle stop flag for selected track");
+		gtk_tool_item_set_tooltip_text(GTK_TOOL_ITEM(InterfaceData.edit_rating), "Set rating for all selected track");
+	}
+	else
+	{
+		gtk_tool_item_set_tooltip_text(GTK_TOOL_ITEM(InterfaceData.remove), "Remove selected tracks from the library");
+		gtk_tool_item_set_tooltip_text(GTK_TOOL_ITEM(InterfaceData.queue), "Toggle selected tracks in the queue");
+		gtk_tool_item_set_tooltip_text(GTK_TOOL_ITEM(InterfaceData.stop), "Toggle stop flag for selected tracks");
+		gtk_tool_item_set_tooltip_text(GTK_TOOL_ITEM(InterfaceData.edit_rating), "Set rating for all selected tracks");
+	}
+
+	clickable = (items_selected > 0);
+
+	// Change toolbar sensitivity (see note [1] at module description)
+	for (l = InterfaceData.selection_tools; l != NULL; l = l->next)
+	{
+		widget = GTK_WIDGET(l->data);
+
+		gtk_widget_set_sensitive(widget, clickable);
+	}
+}
+
+static void
+interface_update_library_info(gint selected, gint total)
+{
+	gchar *txt = g_strdup_printf("%d/%d", selected, total);
+
+	gtk_label_set_text(GTK_LABEL(InterfaceData.library_label), txt);
+
+	g_free(txt);
+}
+
+static void
+interface_report_items_added(gint amount)
+{
+	const gchar *amount_str;
+	gchar *string;
+
+	if (amount > 0)
+	{
+		// Update columns
+		interface_show_hide_columns();
+
+		// New songs are only shown when they match the search query
+		interface_tree_refilter();
+
+		// Make comparing the new songs cheap again
+		interface_sort_update();
+
+		// Report how many song were added
+		amount_str = wf_utils_string_to_single_multiple(amount, "item", "items");
+		string = g_strdup_printf("Added %d %s to the library", amount, amount_str);
+		interface_update_status(string);
+		g_free(string);
+	}
+	else
+	{
+		interface_update_status("Did not add any items");
+	}
+}
+
+static void
+interface_tree_update_song_data(func_tree_update_item cb_func)
+{
+	WfSong *song;
+
+	if (!InterfaceData.constructed)
+	{
+		return;
+	}
+
+	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
+	{
+		// Give the callback function the information it needs to update the row
+		cb_func(InterfaceData.tree_model, song);
+	}
+
+	g_debug("Tree model metadata is now updated");
+}
+
+// Set a GtkTreeIter of the tree view for a given song. Returns %TRUE on success, %FALSE otherwise
+static gboolean
+interface_tree_get_iter_for_song(WfSong *song, GtkTreeIter *iter)
+{
+	GtkTreeIter song_iter;
+	GtkTreeIter sort_iter;
+
+	g_return_val_if_fail(InterfaceData.tree_model != NULL, FALSE);
+	g_return_val_if_fail(iter != NULL, FALSE);
+
+	if (!widget_song_model_get_iter_for_song(InterfaceData.tree_model, song, &song_iter))
+	{
+		return FALSE;
+	}
+
+	// Every row of the song model is in the sort model (see note [12] at module description)
+	if (!gtk_tree_model_sort_convert_child_iter_to_iter(GTK_TREE_MODEL_SORT(interface_sort_get_model()), &sort_iter, &song_iter))
+	{
+		return FALSE;
+	}
+
+	// Fails if the song is filtered out (see note [11] at module description)
+	return gtk_tree_model_filter_convert_child_iter_to_iter(GTK_TREE_MODEL_FILTER(InterfaceData.view_model), iter, &sort_iter);
+}
+
+// Move every block of selected rows one row up or down (see note [14] at module description)
+static void
+interface_tree_move_selection(gboolean down)
+{
+	GtkTreeSelection *selection;
+	GtkTreeModel *model;
+	GtkTreePath *path;
+	GPtrArray *block;
+	GList *rows, *list, *first, *l;
+	WfSong *sibling, *song;
+	gint start, end, neighbour, n_rows;
+	gint step = down ? -1 : 1;
+
+	// Rows can only be moved in the order of the library (see note [12] at module description)
+	if (interface_sort_is_sorted())
+	{
+		interface_update_status("Items can not be moved while the library is sorted");
+		return;
+	}
+
+	selection = gtk_tree_view_get_selection(InterfaceData.tree_view);
+	rows = gtk_tree_selection_get_selected_rows(selection, &model);
+
+	if (rows == NULL)
+	{
+		interface_update_status("Nothing is selected");
+		return;
+	}
+
+	n_rows = gtk_tree_model_iter_n_children(model, NULL /* iter */);
+
+	// When moving down, start at the bottom so the blocks that are still to be moved keep their positions
+	if (down)
+	{
+		rows = g_list_reverse(rows);
+	}
+
+	for (list = rows; list != NULL;)
+	{
+		// Find the end of this block of adjacent rows
+		first = list;
+		start = gtk_tree_path_get_indices(first->data)[0];
+		end = start;
+
+		for (list = list->next; list != NULL && gtk_tree_path_get_indices(list->data)[0] == end + step; list = list->next)
+		{
+			end += step;
+		}
+
+		// The row the block swaps places with
+		neighbour = down ? start + 1 : start - 1;
+
+		if (neighbour < 0 || neighbour >= n_rows)
+		{
+			continue;
+		}
+
+		path = gtk_tree_path_new_from_indices(neighbour, -1);
+		sibling = interface_tree_get_song_for_path(model, path);
+		gtk_tree_path_free(path);
+
+		block = g_ptr_array_new_with_free_func(g_object_unref);
+
+		for (l = first; l != list; l = l->next)
+		{
+			song = interface_tree_get_song_for_path(model, l->data);
+
+			if (song != NULL)
+			{
+				g_ptr_array_add(block, song);
+			}
+		}
 
-		// Set slider position (seconds)
-		gtk_range_set_value(InterfaceData.position_slider, percentage);
+		if (sibling != NULL)
+		{
+			interface_tree_move_songs(block, sibling, down);
+			g_object_unref(sibling);
+		}
 
-		// Set sensitivity so the user can interact
-		gtk_widget_set_sensitive(GTK_WIDGET(InterfaceData.position_slider), TRUE);
+		g_ptr_array_free(block, TRUE);
 	}
 
-	// Re-enable slider update signal
-	g_signal_handler_unblock(InterfaceData.position_slider, InterfaceData.position_updated_handler);
+	g_list_free_full(rows, (GDestroyNotify) gtk_tree_path_free);
 }
 
-static void
-interface_update_position_slider_marks(void)
+// Remove @songs from the view and the library; Returns the amount of rows removed
+static gint
+interface_tree_remove_songs(GPtrArray *songs)
 {
-	GtkStyleContext *style;
-	gint min;
-	gint max;
+	WfSong *song;
+	GTimer *timer;
+	GtkTreeView *view;
+	GtkTreeSelection *selection;
+	gboolean detach;
+	gint count;
+	guint i;
 
-	// First clear the old marks
-	gtk_scale_clear_marks(GTK_SCALE(InterfaceData.position_slider));
+	view = InterfaceData.tree_view;
+	selection = gtk_tree_view_get_selection(view);
 
-	// Get the positions of the marks
-	min = wf_settings_static_get_double(WF_SETTING_MIN_PLAYED_FRACTION);
-	max = wf_settings_static_get_double(WF_SETTING_FULL_PLAYED_FRACTION);
+	timer = g_timer_new();
+	detach = (songs->len >= BULK_DETACH_THRESHOLD);
 
-	// Add marks
-	gtk_scale_add_mark(GTK_SCALE(InterfaceData.position_slider), min, GTK_POS_TOP, NULL);
-	gtk_scale_add_mark(GTK_SCALE(InterfaceData.position_slider), max, GTK_POS_TOP, NULL);
+	if (detach)
+	{
+		// Don't let the view and the models on top of the song model handle every single row (see note [13] at module description)
+		g_signal_handler_block(selection, InterfaceData.tree_select_handler);
+		gtk_tree_view_set_model(view, NULL);
+		g_clear_object(&InterfaceData.view_model);
+		interface_sort_detach();
+	}
 
-	// Remove the pointed style of the button on the slider
-	style = gtk_widget_get_style_context(GTK_WIDGET(InterfaceData.position_slider));
-	gtk_style_context_remove_class(style, "marks-before");
-}
+	// Remove from the tree in one pass
+	count = widget_song_model_remove_songs(InterfaceData.tree_model, songs);
 
-void interface_tree_add_item(WfSong *song)
-{
-	GtkTreeIter iter = { 0 };
+	for (i = 0; i < songs->len; i++)
+	{
+		song = g_ptr_array_index(songs, i);
 
-	g_return_if_fail(WF_IS_SONG(song));
+		// Forget about it
+		interface_search_remove_song(song);
+		interface_relocate_remove_song(song);
+		interface_sort_remove_song(song);
+		g_hash_table_remove(InterfaceData.stats_dirty, song);
+		g_hash_table_remove(InterfaceData.status_songs, song);
+		g_hash_table_remove(InterfaceData.invalid_songs, song);
+
+		if (InterfaceData.invalid_stale != NULL)
+		{
+			g_hash_table_remove(InterfaceData.invalid_stale, song);
+		}
+
+		// Remove the item from the library (see note [20] at module description)
+		interface_cache_remove(wf_song_get_uri(song));
+		wf_library_remove_song(song);
+	}
+
+	if (detach)
+	{
+		interface_sort_attach();
+		interface_tree_create_view_model();
+		gtk_tree_view_set_model(view, InterfaceData.view_model);
+		g_signal_handler_unblock(selection, InterfaceData.tree_select_handler);
+
+		// Handle the lost selection only once
+		interface_selection_changed_cb(selection, NULL /* user_data */);
+	}
 
-	// Add item
-	gtk_tree_store_append(InterfaceData.tree_store, &iter, NULL /* parent */);
+	g_debug("Removed %d rows from the library view in %.3f seconds", count, g_timer_elapsed(timer, NULL /* microseconds */));
 
-	// Fill the row with all other information (possibly using callbacks)
-	interface_tree_update_song_status(InterfaceData.tree_store, &iter, song);
-	interface_tree_update_song_stat_cb(InterfaceData.tree_store, &iter, song);
-	interface_tree_update_song_metadata_cb(InterfaceData.tree_store, &iter, song);
+	g_timer_destroy(timer);
+
+	// Write the library file once for all songs (see note [16] at module description)
+	interface_writer_request(FALSE);
+
+	interface_show_hide_columns();
+
+	return count;
 }
 
+// Give a relocated song the rating of its old song and mark the old song for removal (see note [24] at module description)
 static void
-interface_add_items(GSList *files, WfLibraryFileChecks checks, gboolean skip_metadata)
+interface_tree_relocate_song(WfSong *song)
 {
-	gint amount = 0;
+	gpointer old;
+	gint rating;
 
-	if (files != NULL)
+	if (InterfaceData.relocating == NULL || wf_song_get_uri(song) == NULL ||
+	    !g_hash_table_lookup_extended(InterfaceData.relocating, wf_song_get_uri(song), NULL /* orig_key */, &old))
 	{
-		// Create progress window
-		interface_progress_window_create("Adding new items. Standy by...");
+		return;
+	}
 
-		amount = wf_library_add_uris(files, interface_items_are_added_cb, checks, skip_metadata); // transfer full
+	rating = wf_song_get_rating(old);
 
-		// Progress done
-		interface_progress_window_destroy();
+	if (rating > 0)
+	{
+		wf_song_set_rating(song, rating);
+		interface_journal_add_rating(song, rating);
 	}
 
-	interface_report_items_added(amount);
+	g_ptr_array_add(InterfaceData.relocated, g_object_ref(old));
+	g_hash_table_remove(InterfaceData.relocating, wf_song_get_uri(song));
 }
 
+// Remove the old songs of the relocated files that were added (see note [24] at module description)
 static void
-interface_update_toolbar(gint items_selected, gint items_total)
+interface_tree_remove_relocated(void)
 {
-	GtkWidget *widget;
-	GSList *l;
-	gboolean clickable;
+	GPtrArray *songs;
+	GtkTreeIter iter;
+	WfSong *song;
+	gchar *string;
+	guint i;
 
-	g_info("Updated toolbar button sensitivity");
+	// Old songs of files that were not added stay where they are
+	g_hash_table_remove_all(InterfaceData.relocating);
 
-	// Change labels
-	if (items_selected == 1)
-	{
-		gtk_tool_item_set_tooltip_text(GTK_TOOL_ITEM(InterfaceData.remove), "Remove selected track from the library");
-		gtk_tool_item_set_tooltip_text(GTK_TOOL_ITEM(InterfaceData.queue), "Toggle selected track in the queue");
-		gtk_tool_item_set_tooltip_text(GTK_TOOL_ITEM(InterfaceData.stop), "Toggle stop flag for selected track");
-		gtk_tool_item_set_tooltip_text(GTK_TOOL_ITEM(InterfaceData.edit_rating), "Set rating for all selected track");
-	}
-	else
+	if (InterfaceData.relocated->len == 0)
 	{
-		gtk_tool_item_set_tooltip_text(GTK_TOOL_ITEM(InterfaceData.remove), "Remove selected tracks from the library");
-		gtk_tool_item_set_tooltip_text(GTK_TOOL_ITEM(InterfaceData.queue), "Toggle selected tracks in the queue");
-		gtk_tool_item_set_tooltip_text(GTK_TOOL_ITEM(InterfaceData.stop), "Toggle stop flag for selected tracks");
-		gtk_tool_item_set_tooltip_text(GTK_TOOL_ITEM(InterfaceData.edit_rating), "Set rating for all selected tracks");
+		return;
 	}
 
-	clickable = (items_selected > 0);
+	songs = g_ptr_array_new_with_free_func(g_object_unref);
 
-	// Change toolbar sensitivity (see note [1] at module description)
-	for (l = InterfaceData.selection_tools; l != NULL; l = l->next)
+	for (i = 0; i < InterfaceData.relocated->len; i++)
 	{
-		widget = GTK_WIDGET(l->data);
+		song = g_ptr_array_index(InterfaceData.relocated, i);
 
-		gtk_widget_set_sensitive(widget, clickable);
+		// Removed from the library in the meantime
+		if (widget_song_model_get_iter_for_song(InterfaceData.tree_model, song, &iter))
+		{
+			g_ptr_array_add(songs, g_object_ref(song));
+		}
 	}
-}
 
-static void
-interface_update_library_info(gint selected, gint total)
-{
-	gchar *txt = g_strdup_printf("%d/%d", selected, total);
+	g_ptr_array_set_size(InterfaceData.relocated, 0);
 
-	gtk_label_set_text(GTK_LABEL(InterfaceData.library_label), txt);
+	g_debug("Removing %u songs that were relocated", songs->len);
 
-	g_free(txt);
+	if (songs->len > 0)
+	{
+		interface_tree_remove_songs(songs);
+
+		string = g_strdup_printf("Relocated %u %s", songs->len, wf_utils_string_to_single_multiple((gint) songs->len, "song", "songs"));
+		interface_update_status(string);
+		g_free(string);
+	}
+
+	g_ptr_array_unref(songs);
 }
 
-static void
-interface_report_items_added(gint amount)
+// URI of the location typed in @entry, which may be a path or a URI; NULL if empty
+static gchar *
+interface_relocate_dialog_get_uri(GtkWidget *entry)
 {
-	const gchar *amount_str;
-	gchar *string;
+	const gchar *text;
+	gchar *scheme;
 
-	if (amount > 0)
-	{
-		// Update columns
-		interface_show_hide_columns();
+	text = gtk_entry_get_text(GTK_ENTRY(entry));
 
-		// Report how many song were added
-		amount_str = wf_utils_string_to_single_multiple(amount, "item", "items");
-		string = g_strdup_printf("Added %d %s to the library", amount, amount_str);
-		interface_update_status(string);
-		g_free(string);
+	if (*text == '\0')
+	{
+		return NULL;
 	}
-	else
+
+	scheme = g_uri_parse_scheme(text);
+
+	if (scheme != NULL)
 	{
-		interface_update_status("Did not add any items");
+		g_free(scheme);
+		return g_strdup(text);
 	}
+
+	return g_filename_to_uri(text, NULL /* hostname */, NULL /* error */);
 }
 
+// Move @songs as one block right before or after @sibling, in both the tree and the library
 static void
-interface_tree_update_song_data(func_tree_update_item cb_func)
+interface_tree_move_songs(GPtrArray *songs, WfSong *sibling, gboolean after)
 {
-	WfSong *song;
-	GtkTreeStore *store;
+	GtkTreeModel *model = GTK_TREE_MODEL(InterfaceData.tree_model);
+	GtkTreeIter iter;
+	WfSong *anchor;
+	guint i;
 
-	if (!InterfaceData.constructed)
+	// Move in tree, in one go
+	if (!widget_song_model_move_songs(InterfaceData.tree_model, songs, sibling, after))
 	{
 		return;
 	}
 
-	store = InterfaceData.tree_store;
+	// The songs now form a block in the tree; Take over their order
+	g_ptr_array_sort_with_data(songs, interface_tree_compare_song_positions, NULL /* user_data */);
 
-	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
+	// Move in library, next to the same row as in the tree
+	widget_song_model_get_iter_for_song(InterfaceData.tree_model, g_ptr_array_index(songs, songs->len - 1), &iter);
+
+	if (gtk_tree_model_iter_next(model, &iter))
+	{
+		anchor = widget_song_model_get_song(InterfaceData.tree_model, &iter);
+
+		for (i = 0; i < songs->len; i++)
+		{
+			wf_library_move_before(g_ptr_array_index(songs, i), anchor);
+		}
+	}
+	else if (widget_song_model_get_iter_for_song(InterfaceData.tree_model, g_ptr_array_index(songs, 0), &iter) &&
+	         gtk_tree_model_iter_previous(model, &iter))
 	{
-		GtkTreeIter iter;
+		anchor = widget_song_model_get_song(InterfaceData.tree_model, &iter);
 
-		if (interface_tree_get_iter_for_song(song, &iter))
+		// Every song goes right after the anchor, so start with the last one
+		for (i = songs->len; i-- > 0;)
 		{
-			// Give the callback function the information it needs to update the tree iter
-			cb_func(store, &iter, song);
+			wf_library_move_after(g_ptr_array_index(songs, i), anchor);
 		}
 	}
 
-	g_debug("Tree store metadata is now updated");
+	// See note [16] at module description
+	interface_writer_request(FALSE);
 }
 
-// Set a GtkTreeIter for a given song. Returns %TRUE on success, %FALSE otherwise
+// Move the selected rows to where they were dropped (see note [14] at module description)
 static gboolean
-interface_tree_get_iter_for_song(WfSong *song, GtkTreeIter *iter)
+interface_tree_drop_rows(gint x, gint y)
 {
-	WfSong *song_item;
-	GtkTreeModel *model = GTK_TREE_MODEL(InterfaceData.tree_store);
+	GtkTreeViewDropPosition position;
+	GtkTreeSelection *selection;
+	GtkTreeModel *model;
+	GtkTreePath *path = NULL;
+	GPtrArray *songs;
+	GList *rows, *l;
+	WfSong *sibling, *song;
+	gboolean after = TRUE;
+	gint n_rows;
 
-	g_return_val_if_fail(GTK_IS_TREE_MODEL(model), FALSE);
-	g_return_val_if_fail(iter != NULL, FALSE);
+	if (interface_sort_is_sorted())
+	{
+		interface_update_status("Items can not be moved while the library is sorted");
+		return FALSE;
+	}
 
-	if (song == NULL)
+	selection = gtk_tree_view_get_selection(InterfaceData.tree_view);
+	rows = gtk_tree_selection_get_selected_rows(selection, &model);
+
+	if (rows == NULL)
 	{
 		return FALSE;
 	}
 
-	// Get first row (first iter)
-	gtk_tree_model_get_iter_first(model, iter);
+	if (gtk_tree_view_get_dest_row_at_pos(InterfaceData.tree_view, x, y, &path, &position))
+	{
+		after = (position == GTK_TREE_VIEW_DROP_AFTER || position == GTK_TREE_VIEW_DROP_INTO_OR_AFTER);
+	}
+	else
+	{
+		// Dropped below the last row
+		n_rows = gtk_tree_model_iter_n_children(model, NULL /* iter */);
+		path = gtk_tree_path_new_from_indices(n_rows - 1, -1);
+	}
+
+	sibling = interface_tree_get_song_for_path(model, path);
+	gtk_tree_path_free(path);
+
+	songs = g_ptr_array_new_with_free_func(g_object_unref);
 
-	// Iterate over all items
-	do
+	for (l = rows; l != NULL; l = l->next)
 	{
-		// Get the song from the iter
-		song_item = interface_tree_get_song_for_iter(model, iter);
+		song = interface_tree_get_song_for_path(model, l->data);
 
-		if (song == song_item)
+		if (song != NULL)
 		{
-			// Found matching item, @iter is already set
-			return TRUE;
+			g_ptr_array_add(songs, song);
 		}
+	}
 
-		g_object_unref(song_item);
-	} while (gtk_tree_model_iter_next(model, iter));
+	g_list_free_full(rows, (GDestroyNotify) gtk_tree_path_free);
 
-	return FALSE;
+	if (sibling != NULL)
+	{
+		interface_tree_move_songs(songs, sibling, after);
+		g_object_unref(sibling);
+	}
+
+	g_ptr_array_free(songs, TRUE);
+
+	return (sibling != NULL);
+}
+
+static gint
+interface_tree_compare_song_positions(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	GtkTreeIter iter_a, iter_b;
+
+	widget_song_model_get_iter_for_song(InterfaceData.tree_model, *((WfSong * const *) a), &iter_a);
+	widget_song_model_get_iter_for_song(InterfaceData.tree_model, *((WfSong * const *) b), &iter_b);
+
+	return widget_song_model_get_position(InterfaceData.tree_model, &iter_a) - widget_song_model_get_position(InterfaceData.tree_model, &iter_b);
+}
+
+// Create the filter model that the tree view shows (see note [11] at module description)
+static void
+interface_tree_create_view_model(void)
+{
+	g_return_if_fail(InterfaceData.view_model == NULL);
+
+	InterfaceData.view_model = gtk_tree_model_filter_new(interface_sort_get_model(), NULL /* root */);
+	gtk_tree_model_filter_set_visible_func(GTK_TREE_MODEL_FILTER(InterfaceData.view_model), interface_tree_visible_func, NULL /* data */, NULL /* destroy */);
+}
+
+static gboolean
+interface_tree_visible_func(GtkTreeModel *model, GtkTreeIter *iter, gpointer data)
+{
+	GtkTreeIter song_iter;
+
+	// The child model is passed here, which is the sort model
+	gtk_tree_model_sort_convert_iter_to_child_iter(GTK_TREE_MODEL_SORT(model), &song_iter, iter);
+
+	return interface_search_song_matches(widget_song_model_get_song(InterfaceData.tree_model, &song_iter));
+}
+
+// Show the rows matching the current query again
+static void
+interface_tree_refilter(void)
+{
+	if (!interface_search_refresh())
+	{
+		// No query, nothing to filter
+		return;
+	}
+
+	gtk_tree_model_filter_refilter(GTK_TREE_MODEL_FILTER(InterfaceData.view_model));
+}
+
+static void
+interface_search_changed_cb(GtkSearchEntry *entry, gpointer user_data)
+{
+	const gchar *query;
+	gboolean active;
+	gchar *str;
+	guint count;
+
+	query = gtk_entry_get_text(GTK_ENTRY(entry));
+
+	g_debug("Search query changed");
+
+	active = interface_search_set_query(query);
+
+	gtk_tree_model_filter_refilter(GTK_TREE_MODEL_FILTER(InterfaceData.view_model));
+
+	if (active)
+	{
+		count = interface_search_get_match_count();
+		str = g_strdup_printf("Found %u %s", count, wf_utils_string_to_single_multiple(count, "match", "matches"));
+		interface_update_status(str);
+		g_free(str);
+	}
+	else
+	{
+		interface_update_status("Showing all items");
+	}
 }
 
 static WfSong *
@@ -2826,7 +4699,7 @@ interface_tree_get_song_for_iter(GtkTreeModel *model, GtkTreeIter *iter)
 	gpointer item = NULL;
 
 	// Get the pointer from the tree (this will increase the reference count)
-	gtk_tree_model_get(model, iter, SONGOBJ_COLUMN, &item, -1);
+	gtk_tree_model_get(model, iter, WIDGET_SONG_MODEL_COLUMN_SONGOBJ, &item, -1);
 
 	return (WfSong *) item;
 }
@@ -3184,22 +5057,27 @@ interface_progress_window_create(const gchar *description)
 	GtkWidget *content;
 	GtkWidget *vbox;
 	GtkWidget *prog;
+	GtkWidget *label;
 
 	g_return_if_fail(GTK_IS_WINDOW(InterfaceData.main_window));
 
 	progress_win = gtk_dialog_new();
 	gtk_window_set_title(GTK_WINDOW(progress_win), "Processing...");
 	gtk_window_set_transient_for(GTK_WINDOW(progress_win), InterfaceData.main_window);
-	gtk_window_set_modal(GTK_WINDOW(progress_win), TRUE);
+	// Not modal; The rest of the interface stays usable while adding (see note [18] at module description)
+	gtk_window_set_modal(GTK_WINDOW(progress_win), FALSE);
 	gtk_window_set_destroy_with_parent(GTK_WINDOW(progress_win), TRUE);
 	gtk_window_set_resizable(GTK_WINDOW(progress_win), TRUE);
 	g_signal_connect(progress_win, "delete-event", G_CALLBACK(gtk_widget_hide_on_delete), NULL /* user_data */);
 
+	gtk_dialog_add_button(GTK_DIALOG(progress_win), "Cancel", GTK_RESPONSE_CANCEL);
+	g_signal_connect(progress_win, "response", G_CALLBACK(interface_progress_window_response_cb), NULL /* user_data */);
+
 	content = gtk_dialog_get_content_area(GTK_DIALOG(progress_win));
 	gtk_container_set_border_width(GTK_CONTAINER(content), 12);
 	gtk_box_set_spacing(GTK_BOX(content), 18);
 
-	vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+	vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
 	gtk_box_pack_start(GTK_BOX(content), vbox, FALSE, TRUE, 0);
 
 	prog = gtk_progress_bar_new();
@@ -3209,30 +5087,111 @@ interface_progress_window_create(const gchar *description)
 
 	gtk_box_pack_start(GTK_BOX(vbox), prog, FALSE, TRUE, 0);
 
-	gtk_widget_show_all(progress_win);
+	label = gtk_label_new(NULL);
+	gtk_label_set_xalign(GTK_LABEL(label), 0.0);
+	gtk_box_pack_start(GTK_BOX(vbox), label, FALSE, TRUE, 0);
 
-	interface_update_gtk_events();
+	// Draw the progress once per frame at most (see note [21] at module description)
+	gtk_widget_add_tick_callback(prog, interface_progress_window_tick_cb, NULL /* user_data */, NULL /* notify */);
+
+	gtk_widget_show_all(progress_win);
 
 	InterfaceData.progress = progress_win;
 	InterfaceData.prog_bar = prog;
+	InterfaceData.prog_label = label;
+	InterfaceData.prog_done = 0;
+	InterfaceData.prog_total = -1;
+	InterfaceData.prog_shown = -1;
+	InterfaceData.prog_rate_done = 0;
+	InterfaceData.prog_rate_time = g_get_monotonic_time();
+	InterfaceData.prog_rate = 0.0;
 }
 
-// Update progress bar in the progress window
+// Remember the progress; A negative @total means it is not known yet (see note [21] at module description)
 static void
-interface_progress_window_update(gdouble complete)
+interface_progress_window_update(gint done, gint total)
 {
 	g_return_if_fail(InterfaceData.prog_bar != NULL);
 
-	if (complete > 0.0 && complete <= 1.0) // Within range
+	InterfaceData.prog_done = done;
+	InterfaceData.prog_total = total;
+}
+
+// Show the progress in the progress window, once per frame; The text only changes twice a second
+static gboolean
+interface_progress_window_tick_cb(GtkWidget *widget, GdkFrameClock *frame_clock, gpointer user_data)
+{
+	gint64 now, elapsed;
+	gdouble rate;
+	gchar *text, *remaining = NULL;
+	gint done, total, left;
+
+	done = InterfaceData.prog_done;
+	total = InterfaceData.prog_total;
+	now = gdk_frame_clock_get_frame_time(frame_clock);
+	elapsed = now - InterfaceData.prog_rate_time;
+
+	if (total > 0)
 	{
-		gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(InterfaceData.prog_bar), complete);
+		gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(widget), CLAMP((gdouble) done / total, 0.0, 1.0));
 	}
 	else
 	{
-		gtk_progress_bar_pulse(GTK_PROGRESS_BAR(InterfaceData.prog_bar));
+		// Still finding out how much there is to do
+		gtk_progress_bar_pulse(GTK_PROGRESS_BAR(widget));
 	}
 
-	interface_update_gtk_events();
+	if (elapsed < PROGRESS_RATE_INTERVAL && InterfaceData.prog_shown >= 0)
+	{
+		return G_SOURCE_CONTINUE;
+	}
+
+	// Smooth out the speed, as batches take different amounts of time
+	if (elapsed > 0)
+	{
+		rate = (gdouble) (done - InterfaceData.prog_rate_done) * G_USEC_PER_SEC / elapsed;
+		InterfaceData.prog_rate = (InterfaceData.prog_shown < 0) ? rate : 0.7 * InterfaceData.prog_rate + 0.3 * rate;
+	}
+
+	InterfaceData.prog_rate_done = done;
+	InterfaceData.prog_rate_time = now;
+	InterfaceData.prog_shown = done;
+
+	if (total > 0)
+	{
+		left = MAX(total - done, 0);
+
+		if (InterfaceData.prog_rate >= 0.5)
+		{
+			left = (gint) (left / InterfaceData.prog_rate);
+			remaining = g_strdup_printf(", about %d:%02d left", left / 60, left % 60);
+		}
+
+		text = g_strdup_printf("%d of %d files, %.0f per second%s", done, total, InterfaceData.prog_rate, (remaining != NULL) ? remaining : "");
+	}
+	else
+	{
+		text = g_strdup_printf("%d files, %.0f per second", done, InterfaceData.prog_rate);
+	}
+
+	gtk_label_set_text(GTK_LABEL(InterfaceData.prog_label), text);
+
+	g_free(remaining);
+	g_free(text);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+interface_progress_window_response_cb(GtkDialog *dialog, gint response_id, gpointer user_data)
+{
+	if (response_id == GTK_RESPONSE_CANCEL)
+	{
+		// The window is destroyed once the import has stopped
+		gtk_widget_set_sensitive(GTK_WIDGET(dialog), FALSE);
+		interface_importer_cancel();
+		interface_prefetch_cancel();
+	}
 }
 
 static void
@@ -3244,6 +5203,7 @@ interface_progress_window_destroy(void)
 
 	InterfaceData.progress = NULL;
 	InterfaceData.prog_bar = NULL;
+	InterfaceData.prog_label = NULL;
 }
 
 static void
@@ -3340,10 +5300,11 @@ interface_tree_pop_menu(GtkWidget *widget, GdkEventButton *event, gpointer subwi
 	}
 }
 
-static GdkPixbuf *
-interface_get_pixbuf_icon(SongStatusIcon state)
+// Do not destroy the returned value; it is owned by the icon cache
+static cairo_surface_t *
+interface_get_status_icon(SongStatusIcon state, gint scale)
 {
-	GdkPixbuf *icon = NULL;
+	const gchar *name = NULL;
 
 	switch (state)
 	{
@@ -3352,20 +5313,20 @@ interface_get_pixbuf_icon(SongStatusIcon state)
 			break;
 		case STATUS_ICON_PLAYING:
 		case STATUS_ICON_PAUSED:
-			icon = icons_get_themed_image("media-playback-start");
+			name = "media-playback-start";
 			break;
 		case STATUS_ICON_QUEUED:
-			icon = icons_get_themed_image("playlist-queue");
+			name = "playlist-queue";
 			break;
 		case STATUS_ICON_STOP:
-			icon = icons_get_themed_image("media-playback-stop");
+			name = "media-playback-stop";
 			break;
 		default:
-			icon = icons_get_themed_image("action-unavailable");
+			name = "action-unavailable";
 			break;
 	}
 
-	return icon;
+	return (name == NULL) ? NULL : icons_get_cached_surface(name, ICONS_THEMED_SIZE, scale);
 }
 
 static void
@@ -3394,6 +5355,40 @@ interface_destruct(void)
 {
 	if (InterfaceData.constructed)
 	{
+		// Stop adding files; The songs that were added already are part of the library
+		interface_watch_finalize();
+		interface_integrity_finalize();
+		interface_relocate_finalize();
+		interface_importer_finalize();
+		interface_prefetch_finalize();
+		interface_cache_finalize();
+		g_clear_pointer(&InterfaceData.bulk_songs, g_ptr_array_unref);
+
+		// Remember the column widths for the next run (see note [9] at module description)
+		interface_tree_store_column_widths();
+
+		// Write any pending changes now, including those in the journal (see note [17] at module description)
+		if (!interface_journal_is_empty())
+		{
+			interface_writer_request(TRUE);
+		}
+
+		interface_writer_finalize();
+		interface_journal_finalize();
+
+		// Release our own reference; the tree view drops the last one when destroyed
+		g_clear_object(&InterfaceData.view_model);
+		g_clear_object(&InterfaceData.tree_model);
+		g_clear_pointer(&InterfaceData.stats_dirty, g_hash_table_destroy);
+		g_clear_pointer(&InterfaceData.status_songs, g_hash_table_destroy);
+		g_clear_pointer(&InterfaceData.invalid_songs, g_hash_table_destroy);
+		g_clear_pointer(&InterfaceData.invalid_stale, g_hash_table_destroy);
+		g_clear_pointer(&InterfaceData.relocating, g_hash_table_destroy);
+		g_clear_pointer(&InterfaceData.relocated, g_ptr_array_unref);
+		icons_clear_cache();
+		interface_search_finalize();
+		interface_sort_finalize();
+
 		// Make sure the toplevel window is indeed (going to be) destructed
 		gtk_widget_destroy(InterfaceData.window_widget);
 	}
@@ -0,0 +1,506 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * journal.c  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+/* INCLUDES BEGIN */
+
+// Library includes
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// Woofer core includes
+#include <woofer/song.h>
+
+// Module includes
+#include "journal.h"
+
+// Dependency includes
+/*< none >*/
+
+// Resource includes
+/*< none >*/
+
+/* INCLUDES END */
+
+/* DESCRIPTION BEGIN */
+
+/*
+ * This module keeps a journal of the changes the user makes to songs.  The
+ * library file is only written once in a while (see writer.c), so without
+ * it a crash loses all changes since the last write.  Instead of writing the
+ * whole library, every change is appended to the journal as a single line,
+ * which only costs a few bytes no matter how big the library is.  Once the
+ * library has been written, everything in the journal is part of it and the
+ * journal is removed.  At startup, whatever is left in the journal (because
+ * the library could not be written) is applied to the library again.
+ *
+ * Every line holds the time of the change, the kind of change, the new value
+ * and the URI of the song, separated by tabs:
+ *   1665914400	rating	80	file:///music/song.mp3
+ *
+ * Location specific notes:
+ * [1] Only the new value is stored, never the difference, so applying the
+ *     same line twice does no harm.  This means it doesn't matter whether
+ *     the library was written after the line was added or not.
+ * [2] The journal is flushed to disk with fsync() once per edit instead of
+ *     once per line, so rating a thousand songs at once costs one sync.
+ * [3] If the application stopped while appending a line, the last line is
+ *     incomplete.  It is dropped, and removed from the file, so new lines
+ *     don't end up glued to it.
+ * [4] URIs are escaped, so they never contain tabs or newlines.  The URI is
+ *     the last field, so no other fields have to be escaped either.
+ * [5] As long as the journal has lines, a timeout runs for the compact
+ *     interval, so a single change is folded into the library in time even
+ *     if nothing else happens.  It is started for lines that are added or
+ *     replayed, and again if writing the library failed, so the journal is
+ *     tried again later.  Clearing the journal stops it.
+ */
+
+/* DESCRIPTION END */
+
+/* DEFINES BEGIN */
+
+// Location of the journal within the user data directory
+#define JOURNAL_DIR_NAME "woofer-gtk"
+#define JOURNAL_FILE_NAME "journal"
+
+// Kinds of changes in the journal
+#define JOURNAL_TYPE_RATING "rating"
+
+// Amount of lines after which the journal should be folded into the library
+#define JOURNAL_COMPACT_ENTRIES 1000
+
+// Time after which a journal line should be folded into the library
+#define JOURNAL_COMPACT_INTERVAL (10 * G_TIME_SPAN_MINUTE)
+
+/* DEFINES END */
+
+/* CUSTOM TYPES BEGIN */
+
+typedef struct _JournalDetails JournalDetails;
+typedef enum _JournalField JournalField;
+
+enum _JournalField
+{
+	JOURNAL_FIELD_TIME,
+	JOURNAL_FIELD_TYPE,
+	JOURNAL_FIELD_VALUE,
+	JOURNAL_FIELD_URI,
+	JOURNAL_N_FIELDS
+};
+
+struct _JournalDetails
+{
+	InterfaceJournalCompactFunc compact_func;
+
+	gchar *path;
+
+	// Opened when the first line is added; NULL if not opened
+	FILE *file;
+
+	// Amount of lines in the journal
+	guint entries;
+	// Monotonic time the oldest line was added
+	gint64 first_entry;
+	// Whether lines have been added since the last sync
+	gboolean unsynced;
+
+	// Source that asks for compaction (see note [5] at module description); 0 if none
+	guint compact_id;
+};
+
+/* CUSTOM TYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+static void interface_journal_append(const gchar *type, gint64 value, const gchar *uri);
+static gboolean interface_journal_apply(GHashTable *songs, gchar **fields);
+static GHashTable * interface_journal_index_songs(void);
+static gboolean interface_journal_compact_cb(gpointer user_data);
+
+/* FUNCTION PROTOTYPES END */
+
+/* GLOBAL VARIABLES BEGIN */
+
+static JournalDetails JournalData = { 0 };
+
+/* GLOBAL VARIABLES END */
+
+/* CONSTRUCTORS BEGIN */
+
+void
+interface_journal_init(InterfaceJournalCompactFunc compact_func)
+{
+	gchar *dir;
+
+	JournalData.compact_func = compact_func;
+
+	dir = g_build_filename(g_get_user_data_dir(), JOURNAL_DIR_NAME, NULL /* terminator */);
+
+	if (g_mkdir_with_parents(dir, 0700) != 0)
+	{
+		g_warning("Failed to create directory %s: %s", dir, g_strerror(errno));
+	}
+
+	JournalData.path = g_build_filename(dir, JOURNAL_FILE_NAME, NULL /* terminator */);
+
+	g_free(dir);
+}
+
+/* CONSTRUCTORS END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+// Apply the changes in the journal to the library; Returns the amount of songs that changed
+gint
+interface_journal_replay(void)
+{
+	GHashTable *songs = NULL;
+	GError *error = NULL;
+	gchar *contents = NULL;
+	gchar **lines, **fields;
+	gchar *end;
+	gsize length = 0;
+	gint applied = 0;
+	guint i;
+
+	g_return_val_if_fail(JournalData.path != NULL, 0);
+
+	if (!g_file_get_contents(JournalData.path, &contents, &length, &error))
+	{
+		if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+		{
+			g_warning("Failed to read journal: %s", error->message);
+		}
+
+		g_error_free(error);
+
+		return 0;
+	}
+
+	// Drop an incomplete last line (see note [3] at module description)
+	end = strrchr(contents, '\n');
+	end = (end == NULL) ? contents : end + 1;
+
+	if (*end != '\0')
+	{
+		g_info("Dropping incomplete journal line");
+
+		*end = '\0';
+
+		if (!g_file_set_contents(JournalData.path, contents, end - contents, &error))
+		{
+			g_warning("Failed to repair journal: %s", error->message);
+			g_clear_error(&error);
+		}
+	}
+
+	lines = g_strsplit(contents, "\n", -1);
+
+	for (i = 0; lines[i] != NULL; i++)
+	{
+		if (*lines[i] == '\0')
+		{
+			continue;
+		}
+
+		fields = g_strsplit(lines[i], "\t", JOURNAL_N_FIELDS);
+
+		if (g_strv_length(fields) == JOURNAL_N_FIELDS)
+		{
+			if (songs == NULL)
+			{
+				songs = interface_journal_index_songs();
+			}
+
+			if (interface_journal_apply(songs, fields))
+			{
+				applied++;
+			}
+		}
+		else
+		{
+			g_warning("Ignoring invalid journal line: %s", lines[i]);
+		}
+
+		// Still part of the journal until the library is written
+		if (JournalData.entries++ == 0)
+		{
+			JournalData.first_entry = g_get_monotonic_time();
+		}
+
+		g_strfreev(fields);
+	}
+
+	// See note [5] at module description
+	interface_journal_schedule_compaction();
+
+	g_info("Replayed %u journal lines, changing %d songs", JournalData.entries, applied);
+
+	if (songs != NULL)
+	{
+		g_hash_table_destroy(songs);
+	}
+
+	g_strfreev(lines);
+	g_free(contents);
+
+	return applied;
+}
+
+void
+interface_journal_add_rating(WfSong *song, gint rating)
+{
+	g_return_if_fail(song != NULL);
+
+	interface_journal_append(JOURNAL_TYPE_RATING, rating, wf_song_get_uri(song));
+}
+
+// Make sure every added line is on disk (see note [2] at module description)
+void
+interface_journal_sync(void)
+{
+	if (JournalData.file == NULL || !JournalData.unsynced)
+	{
+		return;
+	}
+
+	JournalData.unsynced = FALSE;
+
+	if (fflush(JournalData.file) != 0 || fsync(fileno(JournalData.file)) != 0)
+	{
+		g_warning("Failed to sync journal: %s", g_strerror(errno));
+	}
+}
+
+// Forget the journal; Only call this right after the library has been written
+void
+interface_journal_clear(void)
+{
+	if (JournalData.file != NULL)
+	{
+		fclose(JournalData.file);
+		JournalData.file = NULL;
+	}
+
+	if (JournalData.entries > 0 && JournalData.path != NULL)
+	{
+		if (g_remove(JournalData.path) != 0 && errno != ENOENT)
+		{
+			g_warning("Failed to remove journal: %s", g_strerror(errno));
+		}
+	}
+
+	if (JournalData.compact_id != 0)
+	{
+		g_source_remove(JournalData.compact_id);
+		JournalData.compact_id = 0;
+	}
+
+	JournalData.entries = 0;
+	JournalData.first_entry = 0;
+	JournalData.unsynced = FALSE;
+}
+
+gboolean
+interface_journal_is_empty(void)
+{
+	return (JournalData.entries == 0);
+}
+
+// Whether the journal is big or old enough that the library should be written
+gboolean
+interface_journal_needs_compaction(void)
+{
+	if (JournalData.entries == 0)
+	{
+		return FALSE;
+	}
+
+	return (JournalData.entries >= JOURNAL_COMPACT_ENTRIES ||
+	        g_get_monotonic_time() - JournalData.first_entry >= JOURNAL_COMPACT_INTERVAL);
+}
+
+// Ask for compaction after the compact interval if the journal has lines (see note [5] at module description)
+void
+interface_journal_schedule_compaction(void)
+{
+	if (JournalData.entries == 0 || JournalData.compact_id != 0 || JournalData.compact_func == NULL)
+	{
+		return;
+	}
+
+	JournalData.compact_id = g_timeout_add_seconds(JOURNAL_COMPACT_INTERVAL / G_TIME_SPAN_SECOND, interface_journal_compact_cb, NULL /* data */);
+}
+
+/* MODULE FUNCTIONS END */
+
+/* MODULE UTILITIES BEGIN */
+
+static void
+interface_journal_append(const gchar *type, gint64 value, const gchar *uri)
+{
+	gint64 now;
+
+	if (JournalData.path == NULL || uri == NULL)
+	{
+		return;
+	}
+
+	if (JournalData.file == NULL)
+	{
+		JournalData.file = g_fopen(JournalData.path, "a");
+
+		if (JournalData.file == NULL)
+		{
+			g_warning("Failed to open journal %s: %s", JournalData.path, g_strerror(errno));
+			return;
+		}
+	}
+
+	now = g_get_real_time() / G_USEC_PER_SEC;
+
+	// See note [4] at module description
+	if (fprintf(JournalData.file, "%" G_GINT64_FORMAT "\t%s\t%" G_GINT64_FORMAT "\t%s\n", now, type, value, uri) < 0)
+	{
+		g_warning("Failed to add line to journal: %s", g_strerror(errno));
+		return;
+	}
+
+	if (JournalData.entries++ == 0)
+	{
+		JournalData.first_entry = g_get_monotonic_time();
+	}
+
+	// See note [5] at module description
+	interface_journal_schedule_compaction();
+
+	JournalData.unsynced = TRUE;
+}
+
+static gboolean
+interface_journal_compact_cb(gpointer user_data)
+{
+	JournalData.compact_id = 0;
+
+	if (JournalData.entries > 0)
+	{
+		JournalData.compact_func();
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+// Apply a single line to the library; Returns whether the song changed
+static gboolean
+interface_journal_apply(GHashTable *songs, gchar **fields)
+{
+	WfSong *song;
+	gchar *end;
+	gint64 value;
+
+	song = g_hash_table_lookup(songs, fields[JOURNAL_FIELD_URI]);
+
+	if (song == NULL)
+	{
+		// Removed from the library since
+		return FALSE;
+	}
+
+	value = g_ascii_strtoll(fields[JOURNAL_FIELD_VALUE], &end, 10);
+
+	if (end == fields[JOURNAL_FIELD_VALUE] || *end != '\0')
+	{
+		g_warning("Invalid value in journal: %s", fields[JOURNAL_FIELD_VALUE]);
+		return FALSE;
+	}
+
+	// Only the new value is stored (see note [1] at module description)
+	if (g_strcmp0(fields[JOURNAL_FIELD_TYPE], JOURNAL_TYPE_RATING) == 0)
+	{
+		if (wf_song_get_rating(song) == value)
+		{
+			return FALSE;
+		}
+
+		wf_song_set_rating(song, (gint) value);
+
+		return TRUE;
+	}
+
+	g_debug("Ignoring unknown journal line type %s", fields[JOURNAL_FIELD_TYPE]);
+
+	return FALSE;
+}
+
+// Map URIs of all songs in the library to their song
+static GHashTable *
+interface_journal_index_songs(void)
+{
+	GHashTable *songs;
+	WfSong *song;
+	const gchar *uri;
+
+	songs = g_hash_table_new(g_str_hash, g_str_equal);
+
+	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
+	{
+		uri = wf_song_get_uri(song);
+
+		if (uri != NULL)
+		{
+			g_hash_table_insert(songs, (gpointer) uri, song);
+		}
+	}
+
+	return songs;
+}
+
+/* MODULE UTILITIES END */
+
+/* DESTRUCTORS BEGIN */
+
+void
+interface_journal_finalize(void)
+{
+	interface_journal_sync();
+
+	if (JournalData.compact_id != 0)
+	{
+		g_source_remove(JournalData.compact_id);
+	}
+
+	if (JournalData.file != NULL)
+	{
+		fclose(JournalData.file);
+	}
+
+	g_free(JournalData.path);
+
+	JournalData = (JournalDetails) { 0 };
+}
+
+/* DESTRUCTORS END */
+
+/* END OF FILE */
@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * journal.h  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+#ifndef __JOURNAL__
+#define __JOURNAL__
+
+/* INCLUDES BEGIN */
+
+#include <glib.h>
+
+#include <woofer/song.h>
+
+/* INCLUDES END */
+
+/* DEFINES BEGIN */
+/* DEFINES END */
+
+/* MODULE TYPES BEGIN */
+
+// Asks for the library to be written, which clears the journal
+typedef void (*InterfaceJournalCompactFunc)(void);
+
+/* MODULE TYPES END */
+
+/* CONSTRUCTOR PROTOTYPES BEGIN */
+
+void interface_journal_init(InterfaceJournalCompactFunc compact_func);
+
+/* CONSTRUCTOR PROTOTYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+gint interface_journal_replay(void);
+void interface_journal_add_rating(WfSong *song, gint rating);
+void interface_journal_sync(void);
+void interface_journal_clear(void);
+
+gboolean interface_journal_is_empty(void);
+gboolean interface_journal_needs_compaction(void);
+void interface_journal_schedule_compaction(void);
+
+/* FUNCTION PROTOTYPES END */
+
+/* DESTRUCTOR PROTOTYPES BEGIN */
+
+void interface_journal_finalize(void);
+
+/* DESTRUCTOR PROTOTYPES END */
+
+#endif /* __JOURNAL__ */
+
+/* END OF FILE */
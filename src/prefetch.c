@@ -0,0 +1,550 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * prefetch.c  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+/* INCLUDES BEGIN */
+
+// Library includes
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Woofer core includes
+/*< none >*/
+
+// Module includes
+#include "prefetch.h"
+
+// Dependency includes
+#include "cache.h"
+
+// Resource includes
+/*< none >*/
+
+/* INCLUDES END */
+
+/* DESCRIPTION BEGIN */
+
+/*
+ * This module reads the parts of files that hold their metadata, so the
+ * operating system has them cached by the time the back-end reads them.  The
+ * back-end reads the metadata of one file after the other, so every file
+ * costs a full round-trip to the disk (or network share).  Reading the files
+ * ahead of it using a pool of threads lets those round-trips overlap.
+ *
+ * Tags are stored at the start of a file (ID3v2, Vorbis comments, FLAC) or
+ * at its end (ID3v1, APE and the index of some MP4 files), so only the first
+ * and last part of every file are read.
+ *
+ * Location specific notes:
+ * [1] The right amount of threads depends on the storage: an SSD or network
+ *     share handles many reads at once without them getting slower, while a
+ *     spinning disk or SD card gets slower with every read that is added.
+ *     Only actual reads are measured; Files that are skipped after a stat
+ *     (see note [3]) would make the storage look much faster than it is.
+ *     The measurements are taken in windows of a minimum amount of reads.
+ *     The baseline is the fastest of the first few windows, read using the
+ *     minimum amount of threads, and stays the same for the whole job.  A
+ *     thread is added for every window as long as that makes more files be
+ *     read per second; Once the last thread added less than half of what
+ *     the others do on average, or reads take much longer than the
+ *     baseline, a thread is taken away and no more are added.
+ * [2] Canceling skips the files that were not read yet.  Every file that is
+ *     pushed to the pool holds a reference to the job, like the job of the
+ *     importer (see note [3] of importer.c), so the pool is freed without
+ *     waiting for the reads in progress and quitting never hangs on a share
+ *     that stopped responding.  A read that finishes late stages its file
+ *     under a stage that is gone already, which the cache ignores.
+ * [3] Files that have not changed according to the file cache (see cache.c)
+ *     are not read.  The others are staged in the cache under the stage of
+ *     the job and counted, so the back-end does not need to be asked to read
+ *     anything if none changed.  The stage is handed to the done function,
+ *     which commits or discards it.
+ *     A file that can't be found counts as changed, so the back-end notices.
+ */
+
+/* DESCRIPTION END */
+
+/* DEFINES BEGIN */
+
+// Amount of bytes to read at the start and at the end of a file
+#define PREFETCH_HEAD_BYTES (256 * 1024)
+#define PREFETCH_TAIL_BYTES (64 * 1024)
+#define PREFETCH_CHUNK_BYTES (64 * 1024)
+
+// Bounds of the amount of threads reading files at once
+#define PREFETCH_MIN_THREADS 2
+#define PREFETCH_MAX_THREADS 16
+
+// Time between adjusting the amount of threads and reporting progress
+#define PREFETCH_ADJUST_MS 250
+
+// Reads taking longer than this factor of the baseline take away a thread
+#define PREFETCH_SHRINK_FACTOR 4
+
+// Minimum amount of reads to measure before adjusting the amount of threads
+#define PREFETCH_WINDOW_READS 8
+
+// Amount of windows the baseline is taken from
+#define PREFETCH_BASELINE_WINDOWS 3
+
+/* DEFINES END */
+
+/* CUSTOM TYPES BEGIN */
+
+typedef struct _PrefetchJob PrefetchJob;
+typedef struct _PrefetchDetails PrefetchDetails;
+
+struct _PrefetchJob
+{
+	// Atomic; One for the main thread and one per file that is not handled yet (see note [2] at module description)
+	gint ref_count;
+
+	GPtrArray *uris;
+	GThreadPool *pool;
+
+	// Stage of the file cache (see note [3] at module description)
+	guint stage;
+
+	// Atomic; Amount of files that have been handled
+	gint done;
+	// Atomic; Amount of files that changed (see note [3] at module description)
+	gint changed;
+	// Atomic
+	gint cancelled;
+
+	// Time spent reading and amount of reads since the last adjustment (see note [1] at module description)
+	GMutex lock;
+	gint64 latency_sum;
+	guint latency_count;
+};
+
+struct _PrefetchDetails
+{
+	InterfacePrefetchProgressFunc progress_func;
+	InterfacePrefetchDoneFunc done_func;
+
+	// The running job; NULL if none
+	PrefetchJob *job;
+	guint source_id;
+
+	// See note [1] at module description
+	gint threads;
+	// Most threads to use; Lowered once another thread does not help
+	gint max_threads;
+	// Fastest average time of reading a file in the first windows, in microseconds
+	gint64 base_latency;
+	guint base_windows;
+	// Monotonic time the current window started
+	gint64 window_start;
+	// Files read per second in the last window
+	gdouble last_throughput;
+	// Whether a thread was added for the current window
+	gboolean grown;
+};
+
+/* CUSTOM TYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+static void interface_prefetch_worker(gpointer data, gpointer user_data);
+static gboolean interface_prefetch_check(guint stage, const gchar *uri);
+static void interface_prefetch_read(const gchar *uri);
+static gboolean interface_prefetch_adjust_cb(gpointer user_data);
+static void interface_prefetch_stop(void);
+static PrefetchJob * interface_prefetch_job_ref(PrefetchJob *job);
+static void interface_prefetch_job_unref(PrefetchJob *job);
+static void interface_prefetch_job_release(PrefetchJob *job);
+
+/* FUNCTION PROTOTYPES END */
+
+/* GLOBAL VARIABLES BEGIN */
+
+static PrefetchDetails PrefetchData = { 0 };
+
+/* GLOBAL VARIABLES END */
+
+/* CONSTRUCTORS BEGIN */
+
+void
+interface_prefetch_init(InterfacePrefetchProgressFunc progress_func, InterfacePrefetchDoneFunc done_func)
+{
+	PrefetchData.progress_func = progress_func;
+	PrefetchData.done_func = done_func;
+}
+
+/* CONSTRUCTORS END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+// Start reading the files of @uris (transfer full); Returns %FALSE if already reading
+gboolean
+interface_prefetch_start(GPtrArray *uris)
+{
+	PrefetchJob *job;
+	GError *error = NULL;
+	guint i;
+
+	g_return_val_if_fail(uris != NULL, FALSE);
+
+	if (PrefetchData.job != NULL)
+	{
+		g_ptr_array_unref(uris);
+		return FALSE;
+	}
+
+	job = g_new0(PrefetchJob, 1);
+	job->ref_count = 1;
+	job->uris = uris;
+	job->stage = interface_cache_stage_begin();
+	g_mutex_init(&job->lock);
+
+	PrefetchData.threads = PREFETCH_MIN_THREADS;
+	PrefetchData.max_threads = PREFETCH_MAX_THREADS;
+	PrefetchData.base_latency = 0;
+	PrefetchData.base_windows = 0;
+	PrefetchData.window_start = g_get_monotonic_time();
+	PrefetchData.last_throughput = 0.0;
+	PrefetchData.grown = FALSE;
+
+	job->pool = g_thread_pool_new(interface_prefetch_worker, job, PrefetchData.threads, FALSE /* exclusive */, &error);
+
+	if (job->pool == NULL)
+	{
+		g_warning("Failed to create thread pool: %s", error->message);
+		g_error_free(error);
+
+		interface_cache_discard(job->stage);
+		interface_prefetch_job_release(job);
+
+		return FALSE;
+	}
+
+	for (i = 0; i < uris->len; i++)
+	{
+		// Zero can't be pushed, so push the index plus one; The reference is dropped by the worker (see note [2] at module description)
+		interface_prefetch_job_ref(job);
+		g_thread_pool_push(job->pool, GUINT_TO_POINTER(i + 1), NULL /* error */);
+	}
+
+	PrefetchData.job = job;
+	PrefetchData.source_id = g_timeout_add(PREFETCH_ADJUST_MS, interface_prefetch_adjust_cb, NULL /* data */);
+
+	return TRUE;
+}
+
+void
+interface_prefetch_cancel(void)
+{
+	if (PrefetchData.job != NULL)
+	{
+		// Finished by interface_prefetch_adjust_cb() (see note [2] at module description)
+		g_atomic_int_set(&PrefetchData.job->cancelled, TRUE);
+	}
+}
+
+gboolean
+interface_prefetch_is_running(void)
+{
+	return (PrefetchData.job != NULL);
+}
+
+/* MODULE FUNCTIONS END */
+
+/* MODULE UTILITIES BEGIN */
+
+static void
+interface_prefetch_worker(gpointer data, gpointer user_data)
+{
+	PrefetchJob *job = user_data;
+	const gchar *uri;
+	gint64 start;
+
+	if (!g_atomic_int_get(&job->cancelled))
+	{
+		uri = g_ptr_array_index(job->uris, GPOINTER_TO_UINT(data) - 1);
+
+		if (interface_prefetch_check(job->stage, uri))
+		{
+			g_atomic_int_inc(&job->changed);
+
+			// Only reads tell how fast the storage is (see note [1] at module description)
+			start = g_get_monotonic_time();
+			interface_prefetch_read(uri);
+
+			g_mutex_lock(&job->lock);
+			job->latency_sum += g_get_monotonic_time() - start;
+			job->latency_count++;
+			g_mutex_unlock(&job->lock);
+		}
+	}
+
+	g_atomic_int_inc(&job->done);
+
+	interface_prefetch_job_unref(job);
+}
+
+// Whether the file of @uri changed since its metadata was read (see note [3] at module description)
+static gboolean
+interface_prefetch_check(guint stage, const gchar *uri)
+{
+	GFileInfo *info;
+	GFile *file;
+	gboolean changed;
+
+	file = g_file_new_for_uri(uri);
+	info = g_file_query_info(file, INTERFACE_CACHE_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, NULL /* cancellable */, NULL /* error */);
+	g_object_unref(file);
+
+	if (info == NULL)
+	{
+		return TRUE;
+	}
+
+	changed = !interface_cache_is_unchanged(uri, info);
+
+	if (changed)
+	{
+		interface_cache_stage(stage, uri, info);
+	}
+
+	g_object_unref(info);
+
+	return changed;
+}
+
+// Read the start and the end of a local file
+static void
+interface_prefetch_read(const gchar *uri)
+{
+	gchar buffer[PREFETCH_CHUNK_BYTES];
+	gchar *filename;
+	goffset size, offset;
+	gssize length;
+	gint fd;
+
+	filename = g_filename_from_uri(uri, NULL /* hostname */, NULL /* error */);
+
+	if (filename == NULL)
+	{
+		// Not a local file
+		return;
+	}
+
+	fd = g_open(filename, O_RDONLY, 0);
+	g_free(filename);
+
+	if (fd < 0)
+	{
+		return;
+	}
+
+	for (offset = 0; offset < PREFETCH_HEAD_BYTES; offset += length)
+	{
+		length = read(fd, buffer, sizeof(buffer));
+
+		if (length <= 0)
+		{
+			break;
+		}
+	}
+
+	size = lseek(fd, 0, SEEK_END);
+
+	for (offset = MAX(size - PREFETCH_TAIL_BYTES, PREFETCH_HEAD_BYTES); offset < size; offset += length)
+	{
+		length = pread(fd, buffer, sizeof(buffer), offset);
+
+		if (length <= 0)
+		{
+			break;
+		}
+	}
+
+	close(fd);
+}
+
+// Adjust the amount of threads and report progress (see note [1] at module description)
+static gboolean
+interface_prefetch_adjust_cb(gpointer user_data)
+{
+	PrefetchJob *job = PrefetchData.job;
+	gint64 latency = 0;
+	gint64 now;
+	gdouble throughput;
+	guint count = 0;
+	gint threads, done;
+
+	g_return_val_if_fail(job != NULL, G_SOURCE_REMOVE);
+
+	g_mutex_lock(&job->lock);
+
+	// Wait for enough reads to say anything about them
+	if (job->latency_count >= PREFETCH_WINDOW_READS)
+	{
+		count = job->latency_count;
+		latency = job->latency_sum / job->latency_count;
+
+		job->latency_sum = 0;
+		job->latency_count = 0;
+	}
+
+	g_mutex_unlock(&job->lock);
+
+	if (count > 0)
+	{
+		now = g_get_monotonic_time();
+		throughput = (gdouble) count * G_USEC_PER_SEC / MAX(now - PrefetchData.window_start, 1);
+		PrefetchData.window_start = now;
+
+		threads = PrefetchData.threads;
+
+		if (PrefetchData.base_windows < PREFETCH_BASELINE_WINDOWS)
+		{
+			// Still using the minimum amount of threads
+			if (PrefetchData.base_latency == 0 || latency < PrefetchData.base_latency)
+			{
+				PrefetchData.base_latency = latency;
+			}
+
+			PrefetchData.base_windows++;
+		}
+		else if (latency >= PrefetchData.base_latency * PREFETCH_SHRINK_FACTOR ||
+		         (PrefetchData.grown && throughput - PrefetchData.last_throughput < PrefetchData.last_throughput / (threads - 1) / 2))
+		{
+			// The storage is overloaded, or the last thread did not help enough
+			threads = MAX(threads - 1, PREFETCH_MIN_THREADS);
+			PrefetchData.max_threads = threads;
+		}
+		else if (threads < PrefetchData.max_threads)
+		{
+			threads++;
+		}
+
+		PrefetchData.grown = (threads > PrefetchData.threads);
+		PrefetchData.last_throughput = throughput;
+
+		if (threads != PrefetchData.threads)
+		{
+			g_debug("Reading files using %d threads (%" G_GINT64_FORMAT " us per file, %.1f files per second)", threads, latency, throughput);
+
+			PrefetchData.threads = threads;
+			g_thread_pool_set_max_threads(job->pool, threads, NULL /* error */);
+		}
+	}
+
+	done = g_atomic_int_get(&job->done);
+
+	if (done >= (gint) job->uris->len)
+	{
+		interface_prefetch_stop();
+
+		return G_SOURCE_REMOVE;
+	}
+
+	if (PrefetchData.progress_func != NULL)
+	{
+		PrefetchData.progress_func(done, job->uris->len);
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+interface_prefetch_stop(void)
+{
+	PrefetchJob *job = PrefetchData.job;
+	gboolean cancelled;
+	guint stage;
+	gint changed;
+
+	cancelled = g_atomic_int_get(&job->cancelled);
+	changed = g_atomic_int_get(&job->changed);
+	stage = job->stage;
+
+	PrefetchData.job = NULL;
+	PrefetchData.source_id = 0;
+
+	interface_prefetch_job_release(job);
+
+	if (PrefetchData.done_func != NULL)
+	{
+		PrefetchData.done_func(stage, changed, cancelled);
+	}
+}
+
+static PrefetchJob *
+interface_prefetch_job_ref(PrefetchJob *job)
+{
+	g_atomic_int_inc(&job->ref_count);
+
+	return job;
+}
+
+static void
+interface_prefetch_job_unref(PrefetchJob *job)
+{
+	if (!g_atomic_int_dec_and_test(&job->ref_count))
+	{
+		return;
+	}
+
+	g_mutex_clear(&job->lock);
+	g_ptr_array_unref(job->uris);
+	g_free(job);
+}
+
+// Drop the reference of the main thread without waiting for the reads in progress (see note [2] at module description)
+static void
+interface_prefetch_job_release(PrefetchJob *job)
+{
+	if (job->pool != NULL)
+	{
+		// Files that were not handled yet still run, to drop their reference, but are skipped when canceled
+		g_thread_pool_free(job->pool, FALSE /* immediate */, FALSE /* wait */);
+		job->pool = NULL;
+	}
+
+	interface_prefetch_job_unref(job);
+}
+
+/* MODULE UTILITIES END */
+
+/* DESTRUCTORS BEGIN */
+
+void
+interface_prefetch_finalize(void)
+{
+	if (PrefetchData.job != NULL)
+	{
+		g_source_remove(PrefetchData.source_id);
+
+		g_atomic_int_set(&PrefetchData.job->cancelled, TRUE);
+		interface_prefetch_job_release(PrefetchData.job);
+	}
+
+	PrefetchData = (PrefetchDetails) { 0 };
+}
+
+/* DESTRUCTORS END */
+
+/* END OF FILE */
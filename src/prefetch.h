@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * prefetch.h  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+#ifndef __PREFETCH__
+#define __PREFETCH__
+
+/* INCLUDES BEGIN */
+
+#include <glib.h>
+
+/* INCLUDES END */
+
+/* DEFINES BEGIN */
+/* DEFINES END */
+
+/* MODULE TYPES BEGIN */
+
+typedef void (*InterfacePrefetchProgressFunc)(gint done, gint total);
+typedef void (*InterfacePrefetchDoneFunc)(guint stage, gint changed, gboolean cancelled);
+
+/* MODULE TYPES END */
+
+/* CONSTRUCTOR PROTOTYPES BEGIN */
+
+void interface_prefetch_init(InterfacePrefetchProgressFunc progress_func, InterfacePrefetchDoneFunc done_func);
+
+/* CONSTRUCTOR PROTOTYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+gboolean interface_prefetch_start(GPtrArray *uris);
+void interface_prefetch_cancel(void);
+gboolean interface_prefetch_is_running(void);
+
+/* FUNCTION PROTOTYPES END */
+
+/* DESTRUCTOR PROTOTYPES BEGIN */
+
+void interface_prefetch_finalize(void);
+
+/* DESTRUCTOR PROTOTYPES END */
+
+#endif /* __PREFETCH__ */
+
+/* END OF FILE */
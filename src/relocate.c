@@ -0,0 +1,608 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * relocate.c  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+
+/* INCLUDES BEGIN */
+
+// Library includes
+#include <glib.h>
+#include <gio/gio.h>
+#include <string.h>
+
+// Woofer core includes
+#include <woofer/song.h>
+
+// Module includes
+#include "relocate.h"
+
+// Dependency includes
+/*< none >*/
+
+// Resource includes
+/*< none >*/
+
+/* INCLUDES END */
+
+/* DESCRIPTION BEGIN */
+
+/*
+ * This module moves songs from one directory to another, for when a drive
+ * or share is mounted somewhere else.  It keeps an index of the URIs of all
+ * songs as a tree of their path components, so the songs in a directory are
+ * found without going through the whole library, and every directory name is
+ * stored once no matter how many songs are in it.
+ *
+ * Location specific notes:
+ * [1] Every node counts the songs below it, so asking how many songs are in
+ *     a directory only needs to walk down the path.  Nodes without songs
+ *     below them are removed right away, so the tree never holds more than
+ *     the directories songs are in.
+ * [2] Before anything is moved, a pool of threads checks whether the new
+ *     file of every song exists, in batches like the integrity check (see
+ *     integrity.c).  Only the songs that would be found at the new location
+ *     are handed to the interface, all at once.  Every batch holds a
+ *     reference to the job, so the pool is freed without waiting for the
+ *     batches in progress, which may be stuck on a drive that went away.
+ * [3] The index is also used to find the songs of a directory that was
+ *     deleted from a watched folder (see watch.c).
+ */
+
+/* DESCRIPTION END */
+
+/* DEFINES BEGIN */
+
+// Amount of threads checking files at once (see note [2] at module description)
+#define RELOCATE_THREADS 8
+
+// Amount of files checked per task (see note [2] at module description)
+#define RELOCATE_BATCH 64
+
+// Time between checking whether all files are checked
+#define RELOCATE_POLL_MS 100
+
+/* DEFINES END */
+
+/* CUSTOM TYPES BEGIN */
+
+typedef struct _RelocateNode RelocateNode;
+typedef struct _RelocateJob RelocateJob;
+typedef struct _RelocateDetails RelocateDetails;
+
+struct _RelocateNode
+{
+	RelocateNode *parent;
+	// Path component of this node; Also the key in the children of the parent
+	gchar *name;
+
+	// Map of path components to their RelocateNode; NULL if none
+	GHashTable *children;
+	// Songs of which the URI ends at this node (not referenced)
+	GSList *songs;
+
+	// Amount of songs at and below this node (see note [1] at module description)
+	guint count;
+};
+
+struct _RelocateJob
+{
+	// Atomic; One for the main thread and one per batch that is not handled yet (see note [2] at module description)
+	gint ref_count;
+
+	// The songs to move with their new URIs; The songs are NULL once released, as they are not thread-safe
+	GPtrArray *songs;
+	GPtrArray *uris;
+	gboolean *exists;
+	GThreadPool *pool;
+
+	// Atomic; Amount of batches that have been handled
+	gint batches_done;
+	gint batches;
+	// Atomic
+	gint cancelled;
+};
+
+struct _RelocateDetails
+{
+	InterfaceRelocateDoneFunc done_func;
+
+	RelocateNode *root;
+	// Map of songs to the node their URI ends at
+	GHashTable *nodes;
+
+	// The running job; NULL if none
+	RelocateJob *job;
+	guint source_id;
+};
+
+/* CUSTOM TYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+static RelocateNode * interface_relocate_node_new(RelocateNode *parent, gchar *name);
+static void interface_relocate_node_free(RelocateNode *node);
+static RelocateNode * interface_relocate_lookup(const gchar *prefix);
+static void interface_relocate_collect(RelocateNode *node, GPtrArray *songs);
+static gchar * interface_relocate_strip(const gchar *prefix);
+static void interface_relocate_worker(gpointer data, gpointer user_data);
+static gboolean interface_relocate_poll_cb(gpointer user_data);
+static RelocateJob * interface_relocate_job_ref(RelocateJob *job);
+static void interface_relocate_job_unref(RelocateJob *job);
+static void interface_relocate_job_release(RelocateJob *job);
+
+/* FUNCTION PROTOTYPES END */
+
+/* GLOBAL VARIABLES BEGIN */
+
+static RelocateDetails RelocateData = { 0 };
+
+/* GLOBAL VARIABLES END */
+
+/* CONSTRUCTORS BEGIN */
+
+void
+interface_relocate_init(InterfaceRelocateDoneFunc done_func)
+{
+	RelocateData.done_func = done_func;
+	RelocateData.root = interface_relocate_node_new(NULL /* parent */, NULL /* name */);
+	RelocateData.nodes = g_hash_table_new(g_direct_hash, g_direct_equal);
+}
+
+/* CONSTRUCTORS END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+void
+interface_relocate_add_song(WfSong *song)
+{
+	RelocateNode *node, *child;
+	const gchar *uri, *start, *end;
+	gchar *name;
+
+	g_return_if_fail(RelocateData.root != NULL);
+
+	uri = wf_song_get_uri(song);
+
+	if (uri == NULL || g_hash_table_contains(RelocateData.nodes, song))
+	{
+		return;
+	}
+
+	node = RelocateData.root;
+	node->count++;
+
+	for (start = uri; start != NULL; start = (end != NULL) ? end + 1 : NULL)
+	{
+		end = strchr(start, '/');
+		name = (end != NULL) ? g_strndup(start, end - start) : g_strdup(start);
+
+		child = (node->children != NULL) ? g_hash_table_lookup(node->children, name) : NULL;
+
+		if (child == NULL)
+		{
+			// Takes the name
+			child = interface_relocate_node_new(node, name);
+		}
+		else
+		{
+			g_free(name);
+		}
+
+		node = child;
+		node->count++;
+	}
+
+	node->songs = g_slist_prepend(node->songs, song);
+	g_hash_table_insert(RelocateData.nodes, song, node);
+}
+
+void
+interface_relocate_remove_song(WfSong *song)
+{
+	RelocateNode *node, *parent;
+
+	g_return_if_fail(RelocateData.root != NULL);
+
+	node = g_hash_table_lookup(RelocateData.nodes, song);
+
+	if (node == NULL)
+	{
+		return;
+	}
+
+	g_hash_table_remove(RelocateData.nodes, song);
+	node->songs = g_slist_remove(node->songs, song);
+
+	// Remove the nodes without songs below them (see note [1] at module description)
+	for (; node != NULL; node = parent)
+	{
+		parent = node->parent;
+		node->count--;
+
+		if (node->count == 0 && parent != NULL)
+		{
+			// Frees the node
+			g_hash_table_remove(parent->children, node->name);
+		}
+	}
+}
+
+// Amount of songs in the directory of @prefix (see note [1] at module description)
+guint
+interface_relocate_count(const gchar *prefix)
+{
+	RelocateNode *node;
+
+	node = interface_relocate_lookup(prefix);
+
+	return (node != NULL) ? node->count : 0;
+}
+
+// Add the songs in the directory of @prefix to @songs, with a reference each (see note [3] at module description)
+void
+interface_relocate_collect_songs(const gchar *prefix, GPtrArray *songs)
+{
+	RelocateNode *node;
+
+	g_return_if_fail(songs != NULL);
+
+	node = interface_relocate_lookup(prefix);
+
+	if (node != NULL)
+	{
+		interface_relocate_collect(node, songs);
+	}
+}
+
+// Find the songs in the directory of @old_prefix and check whether they exist in @new_prefix; Returns %FALSE if there are none or if already checking
+gboolean
+interface_relocate_start(const gchar *old_prefix, const gchar *new_prefix)
+{
+	RelocateNode *node;
+	RelocateJob *job;
+	GPtrArray *songs;
+	GError *error = NULL;
+	gchar *old_stripped, *new_stripped;
+	gsize length;
+	guint i;
+
+	g_return_val_if_fail(old_prefix != NULL && new_prefix != NULL, FALSE);
+
+	node = interface_relocate_lookup(old_prefix);
+
+	if (RelocateData.job != NULL || node == NULL)
+	{
+		return FALSE;
+	}
+
+	songs = g_ptr_array_new_with_free_func(g_object_unref);
+	interface_relocate_collect(node, songs);
+
+	old_stripped = interface_relocate_strip(old_prefix);
+	new_stripped = interface_relocate_strip(new_prefix);
+	length = strlen(old_stripped);
+
+	job = g_new0(RelocateJob, 1);
+	job->ref_count = 1;
+	job->songs = songs;
+	job->uris = g_ptr_array_new_full(songs->len, g_free);
+	job->exists = g_new0(gboolean, songs->len);
+	job->batches = (songs->len + RELOCATE_BATCH - 1) / RELOCATE_BATCH;
+
+	// Every URI below the node starts with the old prefix
+	for (i = 0; i < songs->len; i++)
+	{
+		g_ptr_array_add(job->uris, g_strconcat(new_stripped, wf_song_get_uri(g_ptr_array_index(songs, i)) + length, NULL /* terminator */));
+	}
+
+	g_free(old_stripped);
+	g_free(new_stripped);
+
+	job->pool = g_thread_pool_new(interface_relocate_worker, job, RELOCATE_THREADS, FALSE /* exclusive */, &error);
+
+	if (job->pool == NULL)
+	{
+		g_warning("Failed to create thread pool: %s", error->message);
+		g_error_free(error);
+
+		interface_relocate_job_release(job);
+
+		return FALSE;
+	}
+
+	for (i = 0; i < (guint) job->batches; i++)
+	{
+		// Zero can't be pushed, so push the batch plus one; The reference is dropped by the worker (see note [2] at module description)
+		interface_relocate_job_ref(job);
+		g_thread_pool_push(job->pool, GUINT_TO_POINTER(i + 1), NULL /* error */);
+	}
+
+	RelocateData.job = job;
+	RelocateData.source_id = g_timeout_add(RELOCATE_POLL_MS, interface_relocate_poll_cb, NULL /* data */);
+
+	return TRUE;
+}
+
+void
+interface_relocate_cancel(void)
+{
+	if (RelocateData.job != NULL)
+	{
+		// Finished by interface_relocate_poll_cb()
+		g_atomic_int_set(&RelocateData.job->cancelled, TRUE);
+	}
+}
+
+gboolean
+interface_relocate_is_running(void)
+{
+	return (RelocateData.job != NULL);
+}
+
+/* MODULE FUNCTIONS END */
+
+/* MODULE UTILITIES BEGIN */
+
+static RelocateNode *
+interface_relocate_node_new(RelocateNode *parent, gchar *name)
+{
+	RelocateNode *node;
+
+	node = g_new0(RelocateNode, 1);
+	node->parent = parent;
+	node->name = name;
+
+	if (parent != NULL)
+	{
+		if (parent->children == NULL)
+		{
+			parent->children = g_hash_table_new_full(g_str_hash, g_str_equal, NULL /* key_destroy_func */, (GDestroyNotify) interface_relocate_node_free);
+		}
+
+		g_hash_table_insert(parent->children, name, node);
+	}
+
+	return node;
+}
+
+static void
+interface_relocate_node_free(RelocateNode *node)
+{
+	if (node->children != NULL)
+	{
+		g_hash_table_destroy(node->children);
+	}
+
+	g_slist_free(node->songs);
+	g_free(node->name);
+	g_free(node);
+}
+
+// The node of the directory of @prefix; NULL if no song is in there
+static RelocateNode *
+interface_relocate_lookup(const gchar *prefix)
+{
+	RelocateNode *node;
+	gchar **names;
+	guint i;
+
+	g_return_val_if_fail(RelocateData.root != NULL, NULL);
+
+	if (prefix == NULL || *prefix == '\0')
+	{
+		return NULL;
+	}
+
+	names = g_strsplit(prefix, "/", -1);
+	node = RelocateData.root;
+
+	for (i = 0; names[i] != NULL && node != NULL; i++)
+	{
+		// Ignore a trailing slash
+		if (names[i + 1] == NULL && *names[i] == '\0')
+		{
+			break;
+		}
+
+		node = (node->children != NULL) ? g_hash_table_lookup(node->children, names[i]) : NULL;
+	}
+
+	g_strfreev(names);
+
+	return node;
+}
+
+static void
+interface_relocate_collect(RelocateNode *node, GPtrArray *songs)
+{
+	GHashTableIter iter;
+	gpointer child;
+	GSList *l;
+
+	for (l = node->songs; l != NULL; l = l->next)
+	{
+		g_ptr_array_add(songs, g_object_ref(l->data));
+	}
+
+	if (node->children != NULL)
+	{
+		g_hash_table_iter_init(&iter, node->children);
+
+		while (g_hash_table_iter_next(&iter, NULL /* key */, &child))
+		{
+			interface_relocate_collect(child, songs);
+		}
+	}
+}
+
+// Copy of @prefix without trailing slash
+static gchar *
+interface_relocate_strip(const gchar *prefix)
+{
+	gsize length;
+
+	length = strlen(prefix);
+
+	while (length > 0 && prefix[length - 1] == '/')
+	{
+		length--;
+	}
+
+	return g_strndup(prefix, length);
+}
+
+// Check whether the new files of a batch exist (see note [2] at module description)
+static void
+interface_relocate_worker(gpointer data, gpointer user_data)
+{
+	RelocateJob *job = user_data;
+	GFile *file;
+	guint first, last, i;
+
+	first = (GPOINTER_TO_UINT(data) - 1) * RELOCATE_BATCH;
+	last = MIN(first + RELOCATE_BATCH, job->uris->len);
+
+	for (i = first; i < last && !g_atomic_int_get(&job->cancelled); i++)
+	{
+		file = g_file_new_for_uri(g_ptr_array_index(job->uris, i));
+		job->exists[i] = g_file_query_exists(file, NULL /* cancellable */);
+		g_object_unref(file);
+	}
+
+	g_atomic_int_inc(&job->batches_done);
+
+	interface_relocate_job_unref(job);
+}
+
+static gboolean
+interface_relocate_poll_cb(gpointer user_data)
+{
+	RelocateJob *job = RelocateData.job;
+	GPtrArray *songs, *uris;
+	gboolean cancelled;
+	gint missing = 0;
+	guint i;
+
+	g_return_val_if_fail(job != NULL, G_SOURCE_REMOVE);
+
+	if (g_atomic_int_get(&job->batches_done) < job->batches)
+	{
+		return G_SOURCE_CONTINUE;
+	}
+
+	RelocateData.job = NULL;
+	RelocateData.source_id = 0;
+
+	cancelled = g_atomic_int_get(&job->cancelled);
+
+	songs = g_ptr_array_new();
+	uris = g_ptr_array_new();
+
+	for (i = 0; i < job->songs->len; i++)
+	{
+		if (job->exists[i])
+		{
+			g_ptr_array_add(songs, g_ptr_array_index(job->songs, i));
+			g_ptr_array_add(uris, g_ptr_array_index(job->uris, i));
+		}
+		else
+		{
+			missing++;
+		}
+	}
+
+	if (RelocateData.done_func != NULL)
+	{
+		RelocateData.done_func(songs, uris, missing, cancelled);
+	}
+
+	g_ptr_array_unref(songs);
+	g_ptr_array_unref(uris);
+
+	interface_relocate_job_release(job);
+
+	return G_SOURCE_REMOVE;
+}
+
+static RelocateJob *
+interface_relocate_job_ref(RelocateJob *job)
+{
+	g_atomic_int_inc(&job->ref_count);
+
+	return job;
+}
+
+static void
+interface_relocate_job_unref(RelocateJob *job)
+{
+	if (!g_atomic_int_dec_and_test(&job->ref_count))
+	{
+		return;
+	}
+
+	g_ptr_array_unref(job->uris);
+	g_free(job->exists);
+	g_free(job);
+}
+
+// Drop the reference of the main thread without waiting for the batches in progress (see note [2] at module description)
+static void
+interface_relocate_job_release(RelocateJob *job)
+{
+	if (job->pool != NULL)
+	{
+		// Batches that were not handled yet still run, to drop their reference, but are skipped when canceled
+		g_thread_pool_free(job->pool, FALSE /* immediate */, FALSE /* wait */);
+		job->pool = NULL;
+	}
+
+	g_ptr_array_unref(job->songs);
+	job->songs = NULL;
+
+	interface_relocate_job_unref(job);
+}
+
+/* MODULE UTILITIES END */
+
+/* DESTRUCTORS BEGIN */
+
+void
+interface_relocate_finalize(void)
+{
+	if (RelocateData.job != NULL)
+	{
+		g_source_remove(RelocateData.source_id);
+
+		g_atomic_int_set(&RelocateData.job->cancelled, TRUE);
+		interface_relocate_job_release(RelocateData.job);
+	}
+
+	if (RelocateData.root != NULL)
+	{
+		interface_relocate_node_free(RelocateData.root);
+		g_hash_table_destroy(RelocateData.nodes);
+	}
+
+	RelocateData = (RelocateDetails) { 0 };
+}
+
+/* DESTRUCTORS END */
+
+/* END OF FILE */
@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * relocate.h  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+
+#ifndef __RELOCATE__
+#define __RELOCATE__
+
+/* INCLUDES BEGIN */
+
+#include <glib.h>
+
+#include <woofer/song.h>
+
+/* INCLUDES END */
+
+/* DEFINES BEGIN */
+/* DEFINES END */
+
+/* MODULE TYPES BEGIN */
+
+// @songs and @uris (both transfer none) only hold the songs of which the new file exists
+typedef void (*InterfaceRelocateDoneFunc)(GPtrArray *songs, GPtrArray *uris, gint missing, gboolean cancelled);
+
+/* MODULE TYPES END */
+
+/* CONSTRUCTOR PROTOTYPES BEGIN */
+
+void interface_relocate_init(InterfaceRelocateDoneFunc done_func);
+
+/* CONSTRUCTOR PROTOTYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+void interface_relocate_add_song(WfSong *song);
+void interface_relocate_remove_song(WfSong *song);
+guint interface_relocate_count(const gchar *prefix);
+void interface_relocate_collect_songs(const gchar *prefix, GPtrArray *songs);
+
+gboolean interface_relocate_start(const gchar *old_prefix, const gchar *new_prefix);
+void interface_relocate_cancel(void);
+gboolean interface_relocate_is_running(void);
+
+/* FUNCTION PROTOTYPES END */
+
+/* DESTRUCTOR PROTOTYPES BEGIN */
+
+void interface_relocate_finalize(void);
+
+/* DESTRUCTOR PROTOTYPES END */
+
+#endif /* __RELOCATE__ */
+
+/* END OF FILE */
@@ -0,0 +1,592 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * search.c  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+/* INCLUDES BEGIN */
+
+// Library includes
+#include <glib.h>
+#include <string.h>
+
+// Woofer core includes
+#include <woofer/song.h>
+
+// Module includes
+#include "search.h"
+
+// Dependency includes
+/*< none >*/
+
+// Resource includes
+/*< none >*/
+
+/* INCLUDES END */
+
+/* DESCRIPTION BEGIN */
+
+/*
+ * This module keeps an in-memory index of the metadata of all songs in the
+ * library, used to filter the library view while the user types a search
+ * query.
+ *
+ * For every song, the title, artist, album and filename are case folded and
+ * stripped of accents once, when the song is added to the index.  Every
+ * sequence of three bytes (trigram) of that text points to the songs that
+ * contain it.  A query is split into words and the shortest list of songs of
+ * all trigrams of all words is used as candidates; only those candidates are
+ * compared to the query words.  Words shorter than three bytes have no
+ * trigrams, so if the query only consists of those, all songs are compared.
+ *
+ * Location specific notes:
+ * [1] Songs get an increasing id when they are added, so the song lists of
+ *     all trigrams stay sorted without any effort.  Removing a song does not
+ *     remove its id from these lists (which would be expensive); the id is
+ *     simply not used anymore.  Once there are more unused ids than songs,
+ *     the complete index is rebuilt to get rid of them.
+ */
+
+/* DESCRIPTION END */
+
+/* DEFINES BEGIN */
+
+// Don't bother rebuilding the index for less unused ids than this
+#define SEARCH_MIN_DEAD_IDS 1024
+
+/* DEFINES END */
+
+/* CUSTOM TYPES BEGIN */
+
+typedef struct _SearchEntry SearchEntry;
+typedef struct _SearchIndex SearchIndex;
+
+struct _SearchEntry
+{
+	WfSong *song;
+	gchar *text;
+	guint32 id;
+};
+
+struct _SearchIndex
+{
+	// Entries by their id; Removed entries are %NULL
+	GPtrArray *entries;
+	// WfSong * -> SearchEntry *
+	GHashTable *songs;
+	// Trigram -> GArray of ids
+	GHashTable *trigrams;
+	// Amount of ids that are not in use anymore
+	guint dead;
+
+	// The folded words of the current query; %NULL if there is no query
+	gchar **words;
+	// Set of the songs that match the query
+	GHashTable *matches;
+};
+
+/* CUSTOM TYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+static gchar * interface_search_fold(const gchar *str);
+static void interface_search_index_entry(SearchEntry *entry);
+static void interface_search_rebuild(void);
+static gboolean interface_search_entry_matches(SearchEntry *entry);
+static gint interface_search_compare_trigrams(gconstpointer a, gconstpointer b);
+static void interface_search_entry_free(gpointer data);
+
+/* FUNCTION PROTOTYPES END */
+
+/* GLOBAL VARIABLES BEGIN */
+
+static SearchIndex SearchData = { 0 };
+
+/* GLOBAL VARIABLES END */
+
+/* CONSTRUCTORS BEGIN */
+
+void
+interface_search_init(void)
+{
+	g_return_if_fail(SearchData.entries == NULL);
+
+	SearchData.entries = g_ptr_array_new();
+	SearchData.songs = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL /* key_destroy_func */, interface_search_entry_free);
+	SearchData.trigrams = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL /* key_destroy_func */, (GDestroyNotify) g_array_unref);
+}
+
+/* CONSTRUCTORS END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+void
+interface_search_add_song(WfSong *song)
+{
+	SearchEntry *entry;
+	GString *text;
+	const gchar *fields[4];
+	gchar *folded;
+	guint i;
+
+	g_return_if_fail(SearchData.entries != NULL);
+	g_return_if_fail(WF_IS_SONG(song));
+
+	if (g_hash_table_contains(SearchData.songs, song))
+	{
+		return;
+	}
+
+	fields[0] = wf_song_get_title(song);
+	fields[1] = wf_song_get_artist(song);
+	fields[2] = wf_song_get_album(song);
+	fields[3] = wf_song_get_name(song);
+
+	// Fold all text once, so queries don't need to
+	text = g_string_new(NULL);
+
+	for (i = 0; i < G_N_ELEMENTS(fields); i++)
+	{
+		if (fields[i] == NULL)
+		{
+			continue;
+		}
+
+		folded = interface_search_fold(fields[i]);
+
+		g_string_append(text, folded);
+		g_string_append_c(text, '\n');
+
+		g_free(folded);
+	}
+
+	entry = g_slice_new0(SearchEntry);
+	entry->song = g_object_ref(song);
+	entry->text = g_string_free(text, FALSE);
+	entry->id = SearchData.entries->len;
+
+	g_ptr_array_add(SearchData.entries, entry);
+	g_hash_table_insert(SearchData.songs, song, entry);
+
+	interface_search_index_entry(entry);
+
+	if (SearchData.matches != NULL && interface_search_entry_matches(entry))
+	{
+		g_hash_table_add(SearchData.matches, song);
+	}
+}
+
+void
+interface_search_remove_song(WfSong *song)
+{
+	SearchEntry *entry;
+
+	g_return_if_fail(SearchData.entries != NULL);
+
+	entry = g_hash_table_lookup(SearchData.songs, song);
+
+	if (entry == NULL)
+	{
+		return;
+	}
+
+	// Leave the id in the lists of trigrams (see note [1] at module description)
+	g_ptr_array_index(SearchData.entries, entry->id) = NULL;
+	SearchData.dead++;
+
+	if (SearchData.matches != NULL)
+	{
+		g_hash_table_remove(SearchData.matches, song);
+	}
+
+	// This frees the entry
+	g_hash_table_remove(SearchData.songs, song);
+
+	if (SearchData.dead >= SEARCH_MIN_DEAD_IDS && SearchData.dead > g_hash_table_size(SearchData.songs))
+	{
+		interface_search_rebuild();
+	}
+}
+
+// Re-index the song after its metadata changed
+void
+interface_search_update_song(WfSong *song)
+{
+	g_return_if_fail(WF_IS_SONG(song));
+
+	g_object_ref(song);
+
+	interface_search_remove_song(song);
+	interface_search_add_song(song);
+
+	g_object_unref(song);
+}
+
+// Set the current query; Returns %TRUE if there is a query, %FALSE if all songs match
+gboolean
+interface_search_set_query(const gchar *query)
+{
+	gchar **words, **word;
+	gchar *folded;
+	guint n = 0;
+
+	g_clear_pointer(&SearchData.words, g_strfreev);
+
+	folded = (query == NULL) ? NULL : interface_search_fold(query);
+	words = (folded == NULL) ? NULL : g_strsplit_set(folded, " \t\n", -1);
+	g_free(folded);
+
+	// Keep the non-empty words only
+	for (word = words; word != NULL && *word != NULL; word++)
+	{
+		if (**word != '\0')
+		{
+			words[n++] = *word;
+		}
+		else
+		{
+			g_free(*word);
+		}
+	}
+
+	if (words != NULL)
+	{
+		words[n] = NULL;
+	}
+
+	if (n == 0)
+	{
+		g_free(words);
+		g_clear_pointer(&SearchData.matches, g_hash_table_destroy);
+
+		return FALSE;
+	}
+
+	SearchData.words = words;
+
+	return interface_search_refresh();
+}
+
+// Look up the matches of the current query again; Returns %TRUE if there is a query
+gboolean
+interface_search_refresh(void)
+{
+	SearchEntry *entry;
+	GArray *candidates = NULL;
+	GArray *list;
+	GTimer *timer;
+	gchar **word;
+	guint32 trigram;
+	gboolean impossible = FALSE;
+	gsize i, length;
+
+	g_return_val_if_fail(SearchData.entries != NULL, FALSE);
+
+	if (SearchData.words == NULL)
+	{
+		return FALSE;
+	}
+
+	timer = g_timer_new();
+
+	if (SearchData.matches == NULL)
+	{
+		SearchData.matches = g_hash_table_new(g_direct_hash, g_direct_equal);
+	}
+	else
+	{
+		g_hash_table_remove_all(SearchData.matches);
+	}
+
+	// Find the trigram with the least songs
+	for (word = SearchData.words; *word != NULL && !impossible; word++)
+	{
+		length = strlen(*word);
+
+		for (i = 0; i + 3 <= length; i++)
+		{
+			trigram = ((guint8) (*word)[i] << 16) | ((guint8) (*word)[i + 1] << 8) | (guint8) (*word)[i + 2];
+			list = g_hash_table_lookup(SearchData.trigrams, GUINT_TO_POINTER(trigram));
+
+			if (list == NULL)
+			{
+				// No song contains this trigram, so nothing can match
+				impossible = TRUE;
+				break;
+			}
+
+			if (candidates == NULL || list->len < candidates->len)
+			{
+				candidates = list;
+			}
+		}
+	}
+
+	if (impossible)
+	{
+		// Nothing matches
+	}
+	else if (candidates != NULL)
+	{
+		for (i = 0; i < candidates->len; i++)
+		{
+			entry = g_ptr_array_index(SearchData.entries, g_array_index(candidates, guint32, i));
+
+			if (entry != NULL && interface_search_entry_matches(entry))
+			{
+				g_hash_table_add(SearchData.matches, entry->song);
+			}
+		}
+	}
+	else
+	{
+		// Only short words, so compare everything
+		for (i = 0; i < SearchData.entries->len; i++)
+		{
+			entry = g_ptr_array_index(SearchData.entries, i);
+
+			if (entry != NULL && interface_search_entry_matches(entry))
+			{
+				g_hash_table_add(SearchData.matches, entry->song);
+			}
+		}
+	}
+
+	g_debug("Search found %u matches in %.3f ms", g_hash_table_size(SearchData.matches), g_timer_elapsed(timer, NULL /* microseconds */) * 1000.0);
+	g_timer_destroy(timer);
+
+	return TRUE;
+}
+
+gboolean
+interface_search_is_active(void)
+{
+	return (SearchData.matches != NULL);
+}
+
+// Returns %TRUE if @song matches the current query or if there is no query
+gboolean
+interface_search_song_matches(WfSong *song)
+{
+	if (SearchData.matches == NULL)
+	{
+		return TRUE;
+	}
+
+	return g_hash_table_contains(SearchData.matches, song);
+}
+
+guint
+interface_search_get_match_count(void)
+{
+	if (SearchData.matches == NULL)
+	{
+		return g_hash_table_size(SearchData.songs);
+	}
+
+	return g_hash_table_size(SearchData.matches);
+}
+
+/* MODULE FUNCTIONS END */
+
+/* MODULE UTILITIES BEGIN */
+
+// Case fold and strip accents, so "Beyoncé" matches "beyonce"; Free returned value
+static gchar *
+interface_search_fold(const gchar *str)
+{
+	GString *result;
+	gchar *casefolded, *normalized;
+	const gchar *p;
+	gunichar c;
+
+	casefolded = g_utf8_casefold(str, -1);
+	normalized = g_utf8_normalize(casefolded, -1, G_NORMALIZE_ALL);
+	g_free(casefolded);
+
+	if (normalized == NULL)
+	{
+		// Not valid UTF-8
+		return g_strdup(str);
+	}
+
+	result = g_string_sized_new(strlen(normalized));
+
+	for (p = normalized; *p != '\0'; p = g_utf8_next_char(p))
+	{
+		c = g_utf8_get_char(p);
+
+		// Skip the accents that got separated from their character
+		if (!g_unichar_ismark(c))
+		{
+			g_string_append_unichar(result, c);
+		}
+	}
+
+	g_free(normalized);
+
+	return g_string_free(result, FALSE);
+}
+
+// Add the id of the entry to the list of every trigram in its text
+static void
+interface_search_index_entry(SearchEntry *entry)
+{
+	GArray *trigrams, *list;
+	guint32 trigram, previous = 0;
+	const gchar *text = entry->text;
+	gsize i, length;
+
+	length = strlen(text);
+
+	if (length < 3)
+	{
+		return;
+	}
+
+	trigrams = g_array_sized_new(FALSE, FALSE, sizeof(guint32), length - 2);
+
+	for (i = 0; i + 3 <= length; i++)
+	{
+		trigram = ((guint8) text[i] << 16) | ((guint8) text[i + 1] << 8) | (guint8) text[i + 2];
+		g_array_append_val(trigrams, trigram);
+	}
+
+	// Sort them, so a trigram that occurs more than once is only added once
+	g_array_sort(trigrams, interface_search_compare_trigrams);
+
+	for (i = 0; i < trigrams->len; i++)
+	{
+		trigram = g_array_index(trigrams, guint32, i);
+
+		if (i > 0 && trigram == previous)
+		{
+			continue;
+		}
+
+		previous = trigram;
+
+		list = g_hash_table_lookup(SearchData.trigrams, GUINT_TO_POINTER(trigram));
+
+		if (list == NULL)
+		{
+			list = g_array_new(FALSE, FALSE, sizeof(guint32));
+			g_hash_table_insert(SearchData.trigrams, GUINT_TO_POINTER(trigram), list);
+		}
+
+		// Ids only increase, so the list stays sorted (see note [1] at module description)
+		g_array_append_val(list, entry->id);
+	}
+
+	g_array_free(trigrams, TRUE);
+}
+
+// Build the index again to get rid of unused ids (see note [1] at module description)
+static void
+interface_search_rebuild(void)
+{
+	GPtrArray *entries;
+	SearchEntry *entry;
+	guint i;
+
+	g_debug("Rebuilding search index to remove %u unused ids", SearchData.dead);
+
+	entries = SearchData.entries;
+	SearchData.entries = g_ptr_array_sized_new(g_hash_table_size(SearchData.songs));
+	SearchData.dead = 0;
+
+	g_hash_table_remove_all(SearchData.trigrams);
+
+	for (i = 0; i < entries->len; i++)
+	{
+		entry = g_ptr_array_index(entries, i);
+
+		if (entry == NULL)
+		{
+			continue;
+		}
+
+		entry->id = SearchData.entries->len;
+		g_ptr_array_add(SearchData.entries, entry);
+
+		interface_search_index_entry(entry);
+	}
+
+	g_ptr_array_free(entries, TRUE);
+}
+
+// Check if all words of the query occur in the text of the entry
+static gboolean
+interface_search_entry_matches(SearchEntry *entry)
+{
+	gchar **word;
+
+	for (word = SearchData.words; word != NULL && *word != NULL; word++)
+	{
+		if (strstr(entry->text, *word) == NULL)
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static gint
+interface_search_compare_trigrams(gconstpointer a, gconstpointer b)
+{
+	guint32 trigram_a = *((const guint32 *) a);
+	guint32 trigram_b = *((const guint32 *) b);
+
+	return (trigram_a > trigram_b) - (trigram_a < trigram_b);
+}
+
+static void
+interface_search_entry_free(gpointer data)
+{
+	SearchEntry *entry = data;
+
+	g_object_unref(entry->song);
+	g_free(entry->text);
+
+	g_slice_free(SearchEntry, entry);
+}
+
+/* MODULE UTILITIES END */
+
+/* DESTRUCTORS BEGIN */
+
+void
+interface_search_finalize(void)
+{
+	g_clear_pointer(&SearchData.matches, g_hash_table_destroy);
+	g_clear_pointer(&SearchData.words, g_strfreev);
+	g_clear_pointer(&SearchData.trigrams, g_hash_table_destroy);
+	g_clear_pointer(&SearchData.songs, g_hash_table_destroy);
+
+	if (SearchData.entries != NULL)
+	{
+		g_ptr_array_free(SearchData.entries, TRUE);
+	}
+
+	SearchData = (SearchIndex) { 0 };
+}
+
+/* DESTRUCTORS END */
+
+/* END OF FILE */
@@ -69,6 +69,10 @@ struct _InterfaceSettings
 {
 	guint32 setting_notifications;
 	guint32 setting_last_played_timestamp;
+	guint32 setting_column_widths;
+	guint32 setting_watch_folders;
+	guint32 setting_rescan_interval;
+	guint32 setting_rescan_rate;
 };
 
 /* CUSTOM TYPES END */
@@ -101,6 +105,18 @@ interface_settings_init(void)
 
 	id = wf_settings_dynamic_register_bool("LastPlayedTimestamp", NULL /* group */, FALSE);
 	InterfaceSettingsData.setting_last_played_timestamp = id;
+
+	id = wf_settings_dynamic_register_str("ColumnWidths", NULL /* group */, "");
+	InterfaceSettingsData.setting_column_widths = id;
+
+	id = wf_settings_dynamic_register_str("WatchFolders", NULL /* group */, "");
+	InterfaceSettingsData.setting_watch_folders = id;
+
+	id = wf_settings_dynamic_register_int("RescanInterval", NULL /* group */, 30);
+	InterfaceSettingsData.setting_rescan_interval = id;
+
+	id = wf_settings_dynamic_register_int("RescanRate", NULL /* group */, 200);
+	InterfaceSettingsData.setting_rescan_rate = id;
 }
 
 /* CONSTRUCTORS END */
@@ -143,6 +159,58 @@ interface_settings_set_last_played_timestamp(gboolean last_played_timestamp)
 	wf_settings_dynamic_set_bool_by_id(InterfaceSettingsData.setting_last_played_timestamp, last_played_timestamp);
 }
 
+// Column widths as "Title=width" pairs, separated by semicolons
+const gchar *
+interface_settings_get_column_widths(void)
+{
+	return wf_settings_dynamic_get_str_by_id(InterfaceSettingsData.setting_column_widths);
+}
+
+void
+interface_settings_set_column_widths(const gchar *column_widths)
+{
+	wf_settings_dynamic_set_str_by_id(InterfaceSettingsData.setting_column_widths, column_widths);
+}
+
+// URIs of the folders to watch, separated by spaces (URIs never contain one)
+const gchar *
+interface_settings_get_watch_folders(void)
+{
+	return wf_settings_dynamic_get_str_by_id(InterfaceSettingsData.setting_watch_folders);
+}
+
+void
+interface_settings_set_watch_folders(const gchar *watch_folders)
+{
+	wf_settings_dynamic_set_str_by_id(InterfaceSettingsData.setting_watch_folders, watch_folders);
+}
+
+// Minutes between rescans of the watched folders; 0 to only rescan on request
+gint
+interface_settings_get_rescan_interval(void)
+{
+	return wf_settings_dynamic_get_int_by_id(InterfaceSettingsData.setting_rescan_interval);
+}
+
+void
+interface_settings_set_rescan_interval(gint rescan_interval)
+{
+	wf_settings_dynamic_set_int_by_id(InterfaceSettingsData.setting_rescan_interval, rescan_interval);
+}
+
+// Maximum amount of files to check per second while rescanning
+gint
+interface_settings_get_rescan_rate(void)
+{
+	return wf_settings_dynamic_get_int_by_id(InterfaceSettingsData.setting_rescan_rate);
+}
+
+void
+interface_settings_set_rescan_rate(gint rescan_rate)
+{
+	wf_settings_dynamic_set_int_by_id(InterfaceSettingsData.setting_rescan_rate, rescan_rate);
+}
+
 /* MODULE FUNCTIONS END */
 
 /* MODULE UTILITIES BEGIN */
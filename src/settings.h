@@ -64,6 +64,18 @@ void interface_settings_set_notification(NotificationSetting notifications);
 gboolean interface_settings_get_last_played_timestamp(void);
 void interface_settings_set_last_played_timestamp(gboolean last_played_timestamp);
 
+const gchar * interface_settings_get_column_widths(void);
+void interface_settings_set_column_widths(const gchar *column_widths);
+
+const gchar * interface_settings_get_watch_folders(void);
+void interface_settings_set_watch_folders(const gchar *watch_folders);
+
+gint interface_settings_get_rescan_interval(void);
+void interface_settings_set_rescan_interval(gint rescan_interval);
+
+gint interface_settings_get_rescan_rate(void);
+void interface_settings_set_rescan_rate(gint rescan_rate);
+
 /* FUNCTION PROTOTYPES END */
 
 /* UTILITY PROTOTYPES BEGIN */
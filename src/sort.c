@@ -0,0 +1,853 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * sort.c  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+/* INCLUDES BEGIN */
+
+// Library includes
+#include <glib.h>
+#include <gtk/gtk.h>
+#include <string.h>
+
+// Woofer core includes
+#include <woofer/song.h>
+
+// Module includes
+#include "sort.h"
+
+// Dependency includes
+#include "widgets/song_model.h"
+
+// Resource includes
+/*< none >*/
+
+/* INCLUDES END */
+
+/* DESCRIPTION BEGIN */
+
+/*
+ * This module sorts the library view.  It owns a GtkTreeModelSort on top of
+ * the song model, which in turn is the child of the filter model the view
+ * shows.  The sort model sits below the filter so it can compare the rows of
+ * the song model directly.
+ *
+ * Comparing text in the current locale is expensive, so every text field is
+ * turned into a collation key only once per song and kept until the metadata
+ * of that song changes.  Before sorting by a column, the keys of all songs are
+ * sorted once and every song gets its rank, after which the sort model only
+ * needs to compare two integers per comparison.  Equal values are ordered by
+ * artist, album, track number, title and filename, and finally by the order
+ * of the library.
+ *
+ * Location specific notes:
+ * [1] Ranks are only compared if both songs have one; otherwise their keys
+ *     are compared.  As ranks follow the order of the keys, this gives the
+ *     same result, so a song whose metadata changed (or a new song) only
+ *     needs to lose its own rank and not those of all other songs.
+ * [2] For large libraries, creating the keys and sorting them is split over
+ *     a thread per processor.  The main thread waits for them, so the songs
+ *     cannot change in the meantime; the threads only read text that has
+ *     been looked up in advance and don't touch any GObject.  The sorted
+ *     parts are merged on the main thread afterwards.
+ * [3] GtkTreeModelSort emits "sort-column-changed" before it sorts, so the
+ *     ranks are ready by the time the sort model starts comparing rows.
+ * [4] A GtkTreeModelSort walks all of its rows for every row that is deleted
+ *     from its child model.  Before removing many rows at once, the sort
+ *     model can be detached; a new one is created afterwards.
+ * [5] A GtkTreeModelSort without a default sort function of its own orders
+ *     its rows like its child model when sorted by the default column, even
+ *     after it has been sorted by another column.  Setting the default sort
+ *     function to %NULL would make it keep the last order instead, so it is
+ *     left alone; Going back to the default column shows the rows in the
+ *     order of the library again.
+ */
+
+/* DESCRIPTION END */
+
+/* DEFINES BEGIN */
+
+// Amount of songs from which keys are created and sorted using multiple threads
+#define SORT_PARALLEL_MIN_ROWS 20000
+
+// Maximum amount of threads to use
+#define SORT_MAX_THREADS 8
+
+/* DEFINES END */
+
+/* CUSTOM TYPES BEGIN */
+
+typedef enum _SortKey SortKey;
+
+typedef struct _SortEntry SortEntry;
+typedef struct _SortKeyItem SortKeyItem;
+typedef struct _SortKeyJob SortKeyJob;
+typedef struct _SortRankJob SortRankJob;
+typedef struct _SortDetails SortDetails;
+
+enum _SortKey
+{
+	SORT_KEY_NONE = -1,
+	SORT_KEY_URI,
+	SORT_KEY_NAME,
+	SORT_KEY_TITLE,
+	SORT_KEY_ARTIST,
+	SORT_KEY_ALBUM,
+	SORT_N_KEYS
+};
+
+struct _SortEntry
+{
+	// Collation keys; %NULL until needed
+	gchar *keys[SORT_N_KEYS];
+	// Position of the key among the keys of all songs
+	guint ranks[SORT_N_KEYS];
+	// Bit is set if the rank of that key is valid (see note [1] at module description)
+	guint ranked;
+};
+
+struct _SortKeyItem
+{
+	const gchar *text;
+	gchar **key;
+};
+
+struct _SortKeyJob
+{
+	SortKeyItem *items;
+	guint start;
+	guint end;
+	SortKey key;
+};
+
+struct _SortRankJob
+{
+	SortEntry **entries;
+	guint length;
+	SortKey key;
+};
+
+struct _SortDetails
+{
+	WidgetSongModel *model;
+	GtkTreeModel *sort_model;
+
+	// WfSong * -> SortEntry *
+	GHashTable *entries;
+
+	// How the view was sorted while the sort model is detached
+	gboolean detached_sorted;
+	gint detached_column;
+	GtkSortType detached_order;
+};
+
+/* CUSTOM TYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+static void interface_sort_column_changed_cb(GtkTreeSortable *sortable, gpointer user_data);
+static gint interface_sort_compare_func(GtkTreeModel *model, GtkTreeIter *a, GtkTreeIter *b, gpointer user_data);
+
+static gint interface_sort_compare_column(WfSong *song_a, WfSong *song_b, gint column);
+static SortKey interface_sort_get_key_for_column(gint column);
+static const gchar * interface_sort_get_text(WfSong *song, SortKey key);
+static gchar * interface_sort_create_key(const gchar *text, SortKey key);
+static SortEntry * interface_sort_get_entry(WfSong *song);
+static const gchar * interface_sort_get_entry_key(SortEntry *entry, WfSong *song, SortKey key);
+static void interface_sort_rank(SortKey key);
+static void interface_sort_run_jobs(GThreadFunc func, gpointer *jobs, guint n_jobs);
+static guint interface_sort_get_n_threads(guint n_items);
+static gpointer interface_sort_key_job(gpointer data);
+static gpointer interface_sort_rank_job(gpointer data);
+static gint interface_sort_compare_entries(gconstpointer a, gconstpointer b, gpointer user_data);
+static void interface_sort_merge(SortEntry **src, SortEntry **dest, guint start, guint middle, guint end, SortKey key);
+static void interface_sort_entry_free(gpointer data);
+
+/* FUNCTION PROTOTYPES END */
+
+/* GLOBAL VARIABLES BEGIN */
+
+static SortDetails SortData = { 0 };
+
+// Columns to order by if the values of the sort column are equal
+static const gint SortChain[] =
+{
+	WIDGET_SONG_MODEL_COLUMN_ARTIST,
+	WIDGET_SONG_MODEL_COLUMN_ALBUM,
+	WIDGET_SONG_MODEL_COLUMN_NUMBER,
+	WIDGET_SONG_MODEL_COLUMN_TITLE,
+	WIDGET_SONG_MODEL_COLUMN_NAME
+};
+
+/* GLOBAL VARIABLES END */
+
+/* CONSTRUCTORS BEGIN */
+
+void
+interface_sort_init(WidgetSongModel *model)
+{
+	g_return_if_fail(WIDGET_IS_SONG_MODEL(model));
+	g_return_if_fail(SortData.model == NULL);
+
+	SortData.model = g_object_ref(model);
+	SortData.entries = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, interface_sort_entry_free);
+
+	interface_sort_attach();
+}
+
+/* CONSTRUCTORS END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+// Create the sort model (again), sorted by the column that was sorted by before it was detached
+void
+interface_sort_attach(void)
+{
+	GtkTreeSortable *sortable;
+	gint column;
+
+	g_return_if_fail(SortData.model != NULL);
+	g_return_if_fail(SortData.sort_model == NULL);
+
+	SortData.sort_model = gtk_tree_model_sort_new_with_model(GTK_TREE_MODEL(SortData.model));
+
+	sortable = GTK_TREE_SORTABLE(SortData.sort_model);
+
+	for (column = 0; column < WIDGET_SONG_MODEL_N_COLUMNS; column++)
+	{
+		if (column == WIDGET_SONG_MODEL_COLUMN_STATUS || column == WIDGET_SONG_MODEL_COLUMN_SONGOBJ)
+		{
+			continue;
+		}
+
+		gtk_tree_sortable_set_sort_func(sortable, column, interface_sort_compare_func, GINT_TO_POINTER(column), NULL /* destroy */);
+	}
+
+	// No default sort function is set, so the default keeps the order of the library (see note [5] at module description)
+
+	g_signal_connect(sortable, "sort-column-changed", G_CALLBACK(interface_sort_column_changed_cb), NULL /* user_data */);
+
+	if (SortData.detached_sorted)
+	{
+		gtk_tree_sortable_set_sort_column_id(sortable, SortData.detached_column, SortData.detached_order);
+	}
+}
+
+// Drop the sort model, so it does not handle every single row that gets removed (see note [4] at module description)
+void
+interface_sort_detach(void)
+{
+	g_return_if_fail(SortData.sort_model != NULL);
+
+	SortData.detached_sorted = interface_sort_get_column(&SortData.detached_column, &SortData.detached_order);
+
+	// The filter model on top of it must already be gone, otherwise it keeps the sort model alive
+	g_clear_object(&SortData.sort_model);
+}
+
+// The model to use as child of the filter model; Owned by this module
+GtkTreeModel *
+interface_sort_get_model(void)
+{
+	return SortData.sort_model;
+}
+
+// Forget the keys of @song, because its metadata changed
+void
+interface_sort_invalidate_song(WfSong *song)
+{
+	SortEntry *entry;
+	gint i;
+
+	g_return_if_fail(SortData.entries != NULL);
+
+	entry = g_hash_table_lookup(SortData.entries, song);
+
+	if (entry == NULL)
+	{
+		return;
+	}
+
+	for (i = 0; i < SORT_N_KEYS; i++)
+	{
+		g_clear_pointer(&entry->keys[i], g_free);
+	}
+
+	// Only this song loses its ranks (see note [1] at module description)
+	entry->ranked = 0;
+}
+
+void
+interface_sort_remove_song(WfSong *song)
+{
+	g_return_if_fail(SortData.entries != NULL);
+
+	g_hash_table_remove(SortData.entries, song);
+}
+
+// Sort by a column of the song model
+void
+interface_sort_set_column(gint column, GtkSortType order)
+{
+	g_return_if_fail(SortData.sort_model != NULL);
+	g_return_if_fail(column > WIDGET_SONG_MODEL_COLUMN_STATUS && column < WIDGET_SONG_MODEL_COLUMN_SONGOBJ);
+
+	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(SortData.sort_model), column, order);
+}
+
+// Go back to the order of the library (see note [5] at module description)
+void
+interface_sort_unset(void)
+{
+	g_return_if_fail(SortData.sort_model != NULL);
+
+	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(SortData.sort_model), GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID, GTK_SORT_ASCENDING);
+}
+
+// Get the column that is sorted by; Returns %FALSE if the view follows the order of the library
+gboolean
+interface_sort_get_column(gint *column, GtkSortType *order)
+{
+	gint sort_column;
+	GtkSortType sort_order;
+
+	g_return_val_if_fail(SortData.sort_model != NULL, FALSE);
+
+	if (!gtk_tree_sortable_get_sort_column_id(GTK_TREE_SORTABLE(SortData.sort_model), &sort_column, &sort_order))
+	{
+		return FALSE;
+	}
+
+	if (column != NULL)
+	{
+		*column = sort_column;
+	}
+
+	if (order != NULL)
+	{
+		*order = sort_order;
+	}
+
+	return TRUE;
+}
+
+gboolean
+interface_sort_is_sorted(void)
+{
+	return (SortData.sort_model != NULL && interface_sort_get_column(NULL, NULL));
+}
+
+// Rank the songs that were added or changed since the last sort, so comparing them is cheap again
+void
+interface_sort_update(void)
+{
+	g_return_if_fail(SortData.sort_model != NULL);
+
+	interface_sort_column_changed_cb(GTK_TREE_SORTABLE(SortData.sort_model), NULL /* user_data */);
+}
+
+/* MODULE FUNCTIONS END */
+
+/* MODULE UTILITIES BEGIN */
+
+// Runs before the sort model sorts (see note [3] at module description)
+static void
+interface_sort_column_changed_cb(GtkTreeSortable *sortable, gpointer user_data)
+{
+	GTimer *timer;
+	gint column;
+	SortKey key;
+	guint i;
+
+	if (!interface_sort_get_column(&column, NULL /* order */))
+	{
+		return;
+	}
+
+	timer = g_timer_new();
+
+	key = interface_sort_get_key_for_column(column);
+
+	if (key != SORT_KEY_NONE)
+	{
+		interface_sort_rank(key);
+	}
+
+	for (i = 0; i < G_N_ELEMENTS(SortChain); i++)
+	{
+		key = interface_sort_get_key_for_column(SortChain[i]);
+
+		if (key != SORT_KEY_NONE)
+		{
+			interface_sort_rank(key);
+		}
+	}
+
+	g_debug("Prepared sorting by column %d in %.3f ms", column, g_timer_elapsed(timer, NULL /* microseconds */) * 1000.0);
+	g_timer_destroy(timer);
+}
+
+static gint
+interface_sort_compare_func(GtkTreeModel *model, GtkTreeIter *a, GtkTreeIter *b, gpointer user_data)
+{
+	WfSong *song_a, *song_b;
+	gint column = GPOINTER_TO_INT(user_data);
+	gint result;
+	guint i;
+
+	// The child model is passed here, which is the song model
+	song_a = widget_song_model_get_song(SortData.model, a);
+	song_b = widget_song_model_get_song(SortData.model, b);
+
+	result = interface_sort_compare_column(song_a, song_b, column);
+
+	for (i = 0; result == 0 && i < G_N_ELEMENTS(SortChain); i++)
+	{
+		if (SortChain[i] != column)
+		{
+			result = interface_sort_compare_column(song_a, song_b, SortChain[i]);
+		}
+	}
+
+	if (result == 0)
+	{
+		// Keep the order of the library
+		result = widget_song_model_get_position(SortData.model, a) - widget_song_model_get_position(SortData.model, b);
+	}
+
+	return result;
+}
+
+static gint
+interface_sort_compare_column(WfSong *song_a, WfSong *song_b, gint column)
+{
+	SortEntry *entry_a, *entry_b;
+	gint64 value_a, value_b;
+	gdouble score_a, score_b;
+	SortKey key;
+	guint bit;
+
+	switch (column)
+	{
+		case WIDGET_SONG_MODEL_COLUMN_NUMBER:
+			value_a = wf_song_get_track_number(song_a);
+			value_b = wf_song_get_track_number(song_b);
+			break;
+		case WIDGET_SONG_MODEL_COLUMN_DURATION:
+			value_a = wf_song_get_duration(song_a);
+			value_b = wf_song_get_duration(song_b);
+			break;
+		case WIDGET_SONG_MODEL_COLUMN_RATING:
+			value_a = wf_song_get_rating(song_a);
+			value_b = wf_song_get_rating(song_b);
+			break;
+		case WIDGET_SONG_MODEL_COLUMN_SCORE:
+			score_a = wf_song_get_score(song_a);
+			score_b = wf_song_get_score(song_b);
+			return (score_a > score_b) - (score_a < score_b);
+		case WIDGET_SONG_MODEL_COLUMN_PLAYCOUNT:
+			value_a = wf_song_get_play_count(song_a);
+			value_b = wf_song_get_play_count(song_b);
+			break;
+		case WIDGET_SONG_MODEL_COLUMN_SKIPCOUNT:
+			value_a = wf_song_get_skip_count(song_a);
+			value_b = wf_song_get_skip_count(song_b);
+			break;
+		case WIDGET_SONG_MODEL_COLUMN_LASTPLAYED:
+			// Sort by the time itself, not by how it is shown
+			value_a = wf_song_get_last_played(song_a);
+			value_b = wf_song_get_last_played(song_b);
+			break;
+		default:
+			key = interface_sort_get_key_for_column(column);
+
+			if (key == SORT_KEY_NONE)
+			{
+				return 0;
+			}
+
+			entry_a = interface_sort_get_entry(song_a);
+			entry_b = interface_sort_get_entry(song_b);
+			bit = 1u << key;
+
+			// See note [1] at module description
+			if ((entry_a->ranked & bit) && (entry_b->ranked & bit))
+			{
+				return (entry_a->ranks[key] > entry_b->ranks[key]) - (entry_a->ranks[key] < entry_b->ranks[key]);
+			}
+
+			return strcmp(interface_sort_get_entry_key(entry_a, song_a, key), interface_sort_get_entry_key(entry_b, song_b, key));
+	}
+
+	return (value_a > value_b) - (value_a < value_b);
+}
+
+static SortKey
+interface_sort_get_key_for_column(gint column)
+{
+	switch (column)
+	{
+		case WIDGET_SONG_MODEL_COLUMN_URI:
+			return SORT_KEY_URI;
+		case WIDGET_SONG_MODEL_COLUMN_NAME:
+			return SORT_KEY_NAME;
+		case WIDGET_SONG_MODEL_COLUMN_TITLE:
+			return SORT_KEY_TITLE;
+		case WIDGET_SONG_MODEL_COLUMN_ARTIST:
+			return SORT_KEY_ARTIST;
+		case WIDGET_SONG_MODEL_COLUMN_ALBUM:
+			return SORT_KEY_ALBUM;
+		default:
+			return SORT_KEY_NONE;
+	}
+}
+
+static const gchar *
+interface_sort_get_text(WfSong *song, SortKey key)
+{
+	const gchar *text = NULL;
+
+	switch (key)
+	{
+		case SORT_KEY_URI:
+			text = wf_song_get_uri(song);
+			break;
+		case SORT_KEY_NAME:
+			text = wf_song_get_name(song);
+			break;
+		case SORT_KEY_TITLE:
+			text = wf_song_get_title(song);
+			break;
+		case SORT_KEY_ARTIST:
+			text = wf_song_get_artist(song);
+			break;
+		case SORT_KEY_ALBUM:
+			text = wf_song_get_album(song);
+			break;
+		default:
+			break;
+	}
+
+	return (text == NULL) ? "" : text;
+}
+
+// May be called from any thread; Free returned value
+static gchar *
+interface_sort_create_key(const gchar *text, SortKey key)
+{
+	// Let "track 2" come before "track 10" in paths and filenames
+	if (key == SORT_KEY_URI || key == SORT_KEY_NAME)
+	{
+		return g_utf8_collate_key_for_filename(text, -1);
+	}
+
+	return g_utf8_collate_key(text, -1);
+}
+
+static SortEntry *
+interface_sort_get_entry(WfSong *song)
+{
+	SortEntry *entry;
+
+	entry = g_hash_table_lookup(SortData.entries, song);
+
+	if (entry == NULL)
+	{
+		entry = g_slice_new0(SortEntry);
+		g_hash_table_insert(SortData.entries, g_object_ref(song), entry);
+	}
+
+	return entry;
+}
+
+static const gchar *
+interface_sort_get_entry_key(SortEntry *entry, WfSong *song, SortKey key)
+{
+	if (entry->keys[key] == NULL)
+	{
+		entry->keys[key] = interface_sort_create_key(interface_sort_get_text(song, key), key);
+	}
+
+	return entry->keys[key];
+}
+
+// Give every song the rank of its key among all songs
+static void
+interface_sort_rank(SortKey key)
+{
+	SortEntry **entries, **src, **dest, **swap;
+	SortKeyItem *items;
+	SortKeyJob key_jobs[SORT_MAX_THREADS];
+	SortRankJob rank_jobs[SORT_MAX_THREADS];
+	gpointer jobs[SORT_MAX_THREADS];
+	guint bounds[SORT_MAX_THREADS + 1];
+	GtkTreeModel *model = GTK_TREE_MODEL(SortData.model);
+	GtkTreeIter iter;
+	SortEntry *entry;
+	WfSong *song;
+	guint n_entries = 0, n_items = 0, n_threads, n_parts;
+	guint i, rank = 0;
+	guint bit = 1u << key;
+	gboolean complete = TRUE;
+	gboolean valid;
+
+	entries = g_new(SortEntry *, widget_song_model_get_length(SortData.model) + 1);
+	items = g_new(SortKeyItem, widget_song_model_get_length(SortData.model) + 1);
+
+	// Look up all text in advance, so the threads don't need to (see note [2] at module description)
+	for (valid = gtk_tree_model_get_iter_first(model, &iter); valid; valid = gtk_tree_model_iter_next(model, &iter))
+	{
+		song = widget_song_model_get_song(SortData.model, &iter);
+		entry = interface_sort_get_entry(song);
+
+		entries[n_entries++] = entry;
+
+		if (!(entry->ranked & bit))
+		{
+			complete = FALSE;
+		}
+
+		if (entry->keys[key] == NULL)
+		{
+			items[n_items].text = interface_sort_get_text(song, key);
+			items[n_items].key = &entry->keys[key];
+			n_items++;
+		}
+	}
+
+	if (complete)
+	{
+		// Nothing changed since the last time
+		g_free(items);
+		g_free(entries);
+
+		return;
+	}
+
+	// Create the missing keys
+	n_threads = interface_sort_get_n_threads(n_items);
+
+	for (i = 0; i < n_threads; i++)
+	{
+		key_jobs[i].items = items;
+		key_jobs[i].start = n_items * i / n_threads;
+		key_jobs[i].end = n_items * (i + 1) / n_threads;
+		key_jobs[i].key = key;
+		jobs[i] = &key_jobs[i];
+	}
+
+	interface_sort_run_jobs(interface_sort_key_job, jobs, n_threads);
+
+	g_free(items);
+
+	// Sort a part of the keys per thread
+	n_threads = interface_sort_get_n_threads(n_entries);
+
+	for (i = 0; i <= n_threads; i++)
+	{
+		bounds[i] = n_entries * i / n_threads;
+	}
+
+	for (i = 0; i < n_threads; i++)
+	{
+		rank_jobs[i].entries = entries + bounds[i];
+		rank_jobs[i].length = bounds[i + 1] - bounds[i];
+		rank_jobs[i].key = key;
+		jobs[i] = &rank_jobs[i];
+	}
+
+	interface_sort_run_jobs(interface_sort_rank_job, jobs, n_threads);
+
+	// Merge the sorted parts two by two
+	src = entries;
+	dest = g_new(SortEntry *, n_entries + 1);
+
+	for (n_parts = n_threads; n_parts > 1; n_parts = (n_parts + 1) / 2)
+	{
+		for (i = 0; i < n_parts; i += 2)
+		{
+			if (i + 1 < n_parts)
+			{
+				interface_sort_merge(src, dest, bounds[i], bounds[i + 1], bounds[i + 2], key);
+			}
+			else
+			{
+				memcpy(dest + bounds[i], src + bounds[i], (bounds[i + 1] - bounds[i]) * sizeof(SortEntry *));
+			}
+		}
+
+		for (i = 0; i < n_parts; i += 2)
+		{
+			bounds[i / 2] = bounds[i];
+		}
+
+		bounds[(n_parts + 1) / 2] = n_entries;
+
+		// The merged parts are the input of the next round
+		swap = src;
+		src = dest;
+		dest = swap;
+	}
+
+	for (i = 0; i < n_entries; i++)
+	{
+		entry = src[i];
+
+		// Equal keys get an equal rank
+		if (i > 0 && strcmp(src[i - 1]->keys[key], entry->keys[key]) != 0)
+		{
+			rank++;
+		}
+
+		entry->ranks[key] = rank;
+		entry->ranked |= bit;
+	}
+
+	g_free(src);
+	g_free(dest);
+}
+
+// Run every job in a thread of its own and wait for all of them (see note [2] at module description)
+static void
+interface_sort_run_jobs(GThreadFunc func, gpointer *jobs, guint n_jobs)
+{
+	GThread *threads[SORT_MAX_THREADS];
+	guint i;
+
+	for (i = 1; i < n_jobs; i++)
+	{
+		threads[i] = g_thread_new("sort", func, jobs[i]);
+	}
+
+	// This thread takes the first job
+	func(jobs[0]);
+
+	for (i = 1; i < n_jobs; i++)
+	{
+		g_thread_join(threads[i]);
+	}
+}
+
+static guint
+interface_sort_get_n_threads(guint n_items)
+{
+	if (n_items < SORT_PARALLEL_MIN_ROWS)
+	{
+		return 1;
+	}
+
+	return CLAMP(g_get_num_processors(), 1, SORT_MAX_THREADS);
+}
+
+static gpointer
+interface_sort_key_job(gpointer data)
+{
+	SortKeyJob *job = data;
+	SortKeyItem *item;
+	guint i;
+
+	for (i = job->start; i < job->end; i++)
+	{
+		item = &job->items[i];
+		*item->key = interface_sort_create_key(item->text, job->key);
+	}
+
+	return NULL;
+}
+
+static gpointer
+interface_sort_rank_job(gpointer data)
+{
+	SortRankJob *job = data;
+
+	g_qsort_with_data(job->entries, job->length, sizeof(SortEntry *), interface_sort_compare_entries, GINT_TO_POINTER(job->key));
+
+	return NULL;
+}
+
+static gint
+interface_sort_compare_entries(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	const SortEntry *entry_a = *((SortEntry * const *) a);
+	const SortEntry *entry_b = *((SortEntry * const *) b);
+	SortKey key = GPOINTER_TO_INT(user_data);
+
+	return strcmp(entry_a->keys[key], entry_b->keys[key]);
+}
+
+// Merge the sorted ranges start-middle and middle-end of @src into @dest
+static void
+interface_sort_merge(SortEntry **src, SortEntry **dest, guint start, guint middle, guint end, SortKey key)
+{
+	guint a = start, b = middle, i = start;
+
+	while (a < middle && b < end)
+	{
+		if (strcmp(src[b]->keys[key], src[a]->keys[key]) < 0)
+		{
+			dest[i++] = src[b++];
+		}
+		else
+		{
+			dest[i++] = src[a++];
+		}
+	}
+
+	while (a < middle)
+	{
+		dest[i++] = src[a++];
+	}
+
+	while (b < end)
+	{
+		dest[i++] = src[b++];
+	}
+}
+
+static void
+interface_sort_entry_free(gpointer data)
+{
+	SortEntry *entry = data;
+	gint i;
+
+	for (i = 0; i < SORT_N_KEYS; i++)
+	{
+		g_free(entry->keys[i]);
+	}
+
+	g_slice_free(SortEntry, entry);
+}
+
+/* MODULE UTILITIES END */
+
+/* DESTRUCTORS BEGIN */
+
+void
+interface_sort_finalize(void)
+{
+	g_clear_pointer(&SortData.entries, g_hash_table_destroy);
+	g_clear_object(&SortData.sort_model);
+	g_clear_object(&SortData.model);
+
+	SortData = (SortDetails) { 0 };
+}
+
+/* DESTRUCTORS END */
+
+/* END OF FILE */
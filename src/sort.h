@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * sort.h  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+#ifndef __SORT__
+#define __SORT__
+
+/* INCLUDES BEGIN */
+
+#include <glib.h>
+#include <gtk/gtk.h>
+
+#include <woofer/song.h>
+
+#include "widgets/song_model.h"
+
+/* INCLUDES END */
+
+/* DEFINES BEGIN */
+/* DEFINES END */
+
+/* MODULE TYPES BEGIN */
+/* MODULE TYPES END */
+
+/* CONSTRUCTOR PROTOTYPES BEGIN */
+
+void interface_sort_init(WidgetSongModel *model);
+
+/* CONSTRUCTOR PROTOTYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+void interface_sort_attach(void);
+void interface_sort_detach(void);
+GtkTreeModel * interface_sort_get_model(void);
+
+void interface_sort_invalidate_song(WfSong *song);
+void interface_sort_remove_song(WfSong *song);
+
+void interface_sort_set_column(gint column, GtkSortType order);
+void interface_sort_unset(void);
+gboolean interface_sort_get_column(gint *column, GtkSortType *order);
+gboolean interface_sort_is_sorted(void);
+void interface_sort_update(void);
+
+/* FUNCTION PROTOTYPES END */
+
+/* DESTRUCTOR PROTOTYPES BEGIN */
+
+void interface_sort_finalize(void);
+
+/* DESTRUCTOR PROTOTYPES END */
+
+#endif /* __SORT__ */
+
+/* END OF FILE */
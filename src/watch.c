@@ -0,0 +1,1130 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * watch.c  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+/* INCLUDES BEGIN */
+
+// Library includes
+#include <glib.h>
+#include <gio/gio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Woofer core includes
+#include <woofer/song.h>
+#include <woofer/settings.h>
+
+// Module includes
+#include "watch.h"
+
+// Dependency includes
+#include "cache.h"
+#include "relocate.h"
+#include "settings.h"
+
+// Resource includes
+/*< none >*/
+
+/* INCLUDES END */
+
+/* DESCRIPTION BEGIN */
+
+/*
+ * This module watches folders for changes, so the library follows what
+ * happens on disk without having to add or refresh everything again.  New
+ * files are added, deleted files are removed and changed files are counted,
+ * so the user can be asked to refresh the metadata.  Every directory in a
+ * watched folder gets a file monitor (inotify only watches a single
+ * directory); The directories are found by a worker thread.
+ *
+ * Location specific notes:
+ * [1] Changes often come in bursts, like a tagger rewriting hundreds of
+ *     files or a directory being copied.  So changes are only collected,
+ *     keeping only the last change per file, and handled once no changes
+ *     have come in for a moment (or when the first change is a while ago).
+ *     The interface then handles all files of the same kind of change at
+ *     once.
+ * [2] A file that is renamed (like a tagger replacing a file by a temporary
+ *     copy) is handled as a deleted and a created file.  A created file that
+ *     is in the library already only needs its metadata read again.  The
+ *     back-end can only read the metadata of all songs at once, which takes
+ *     far too long to do for every change.  So changed files are only kept
+ *     in a set and reported, until the metadata is refreshed.
+ * [3] When a directory is deleted or moved away, only the directory itself
+ *     is reported.  A deleted file is only taken for a directory if it was
+ *     monitored, as taggers delete temporary files all the time.  The songs
+ *     in it are found using the index of the relocate module (see
+ *     relocate.c), without going through the whole library.
+ * [4] Adding runs in the background and only one import can run at once.
+ *     If the interface is busy, those changes are kept and tried again a
+ *     little later.
+ * [5] Network shares (NFS, SMB) and media that were remounted don't report
+ *     changes, so the watched folders are also rescanned every now and then.
+ *     A thread lists the directories and compares them with the library
+ *     and the file cache; The differences are handled as if they were
+ *     reported (see note [1]), so changed files are only counted (see note
+ *     [2]).  Files of songs that have no entry in the file cache yet get
+ *     one instead of counting as changed, as nothing says they did.  Files
+ *     are only missing if the directory they were in was listed under its
+ *     own URI, so an unmounted share removes nothing, and neither do the
+ *     songs behind a link to a directory that was listed elsewhere, in a
+ *     hidden directory or below the maximum depth (see note [7]).
+ * [6] Rescanning must never be noticed during playback.  The thread has the
+ *     idle I/O class and the lowest CPU priority, and it checks no more
+ *     files per second than configured, so it doesn't keep a slow share
+ *     busy either.  Both priorities are Linux only: Elsewhere, the priority
+ *     can only be set for the whole process, which would slow down playback
+ *     as well.
+ * [7] Walking and rescanning visit every directory once, identified by its
+ *     device and inode, so symbolic links can't make them go round in
+ *     circles.  Directories on file systems that don't tell the inode (like
+ *     several GVFS back-ends) are not walked deeper than a maximum depth
+ *     instead.
+ */
+
+/* DESCRIPTION END */
+
+/* DEFINES BEGIN */
+
+// Attributes needed to find directories
+#define WATCH_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+                         G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+                         G_FILE_ATTRIBUTE_ID_FILE
+
+// Directories without id::file nested deeper than this are not walked (see note [7] at module description)
+#define WATCH_MAX_DEPTH 32
+
+// Key of the depth of a directory on its GFile
+#define WATCH_DEPTH_KEY "watch-depth"
+
+// Time without new changes after which the changes are handled
+#define WATCH_DELAY_MS 2000
+
+// Maximum time a change may wait before the changes are handled
+#define WATCH_MAX_DELAY_MS 10000
+
+// Time after which changes are tried again if the interface was busy
+#define WATCH_RETRY_MS 1000
+
+// Attributes needed to compare files with the library
+#define WATCH_RESCAN_ATTRIBUTES WATCH_ATTRIBUTES "," \
+                                G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE "," \
+                                INTERFACE_CACHE_ATTRIBUTES
+
+// Idle I/O class for the rescan thread, as found in linux/ioprio.h (see note [6] at module description)
+#define WATCH_IOPRIO_WHO_PROCESS 1
+#define WATCH_IOPRIO_CLASS_IDLE 3
+#define WATCH_IOPRIO_CLASS_SHIFT 13
+
+/* DEFINES END */
+
+/* CUSTOM TYPES BEGIN */
+
+typedef enum _WatchChange WatchChange;
+typedef struct _WatchRescan WatchRescan;
+typedef struct _WatchDetails WatchDetails;
+
+enum _WatchChange
+{
+	WATCH_CHANGE_NONE,
+	WATCH_CHANGE_CREATED,
+	WATCH_CHANGE_DELETED,
+	WATCH_CHANGE_DELETED_DIRECTORY,
+	WATCH_CHANGE_CHANGED
+};
+
+// Owned by the rescan thread until it is done (see note [5] at module description)
+struct _WatchRescan
+{
+	gchar **roots;
+	gint rate;
+	GCancellable *cancellable;
+
+	// Set of the URIs in the library
+	GHashTable *library;
+
+	// Set of the files found
+	GHashTable *seen;
+	// Directories that could not be listed, ending with a slash
+	GPtrArray *failed;
+	// Directories that were not listed under their own URI, ending with a slash (see note [5] at module description)
+	GPtrArray *unlisted;
+
+	// Map of URIs to the WatchChange found
+	GHashTable *changes;
+};
+
+struct _WatchDetails
+{
+	InterfaceWatchAddFunc add_func;
+	InterfaceWatchRemoveFunc remove_func;
+	InterfaceWatchChangedFunc changed_func;
+
+	// Map of directory URIs to their GFileMonitor
+	GHashTable *monitors;
+	// Cancels finding directories
+	GCancellable *cancellable;
+
+	// Map of URIs to the last WatchChange (see note [1] at module description)
+	GHashTable *changes;
+	// Set of URIs of songs whose files changed (see note [2] at module description)
+	GHashTable *changed;
+	// Source that handles the changes; 0 if none
+	guint timeout_id;
+	// Monotonic time of the first change since they were last handled
+	gint64 first_change;
+
+	// Source that starts the next rescan; 0 if none
+	guint rescan_id;
+	// Whether a rescan thread is running
+	gboolean rescanning;
+};
+
+/* CUSTOM TYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+static void interface_watch_walk(const gchar *uri);
+static void interface_watch_walk_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable);
+static void interface_watch_walk_cb(GObject *source_object, GAsyncResult *result, gpointer user_data);
+static void interface_watch_monitor(const gchar *uri);
+static gboolean interface_watch_unmonitor(const gchar *uri);
+static void interface_watch_changed_cb(GFileMonitor *monitor, GFile *file, GFile *other_file, GFileMonitorEvent event_type, gpointer user_data);
+static void interface_watch_record(GFile *file, WatchChange change);
+static void interface_watch_schedule(guint delay);
+static gboolean interface_watch_process_cb(gpointer user_data);
+static gboolean interface_watch_has_prefix(const gchar *uri, GPtrArray *prefixes);
+static gboolean interface_watch_rescan_timeout_cb(gpointer user_data);
+static gpointer interface_watch_rescan_thread(gpointer data);
+static void interface_watch_rescan_dir(WatchRescan *rescan, GFile *dir, GQueue *pending, GHashTable *dirs, gint64 start, gint *checked);
+static void interface_watch_rescan_throttle(WatchRescan *rescan, gint64 start, gint checked);
+static gboolean interface_watch_rescan_done_cb(gpointer user_data);
+static void interface_watch_rescan_free(WatchRescan *rescan);
+static gboolean interface_watch_has_root(const gchar *uri, gchar **roots);
+
+/* FUNCTION PROTOTYPES END */
+
+/* GLOBAL VARIABLES BEGIN */
+
+static WatchDetails WatchData = { 0 };
+
+/* GLOBAL VARIABLES END */
+
+/* CONSTRUCTORS BEGIN */
+
+void
+interface_watch_init(InterfaceWatchAddFunc add_func, InterfaceWatchRemoveFunc remove_func, InterfaceWatchChangedFunc changed_func)
+{
+	gchar **folders;
+	guint i;
+
+	WatchData.add_func = add_func;
+	WatchData.remove_func = remove_func;
+	WatchData.changed_func = changed_func;
+
+	WatchData.monitors = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
+	WatchData.changes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL /* value_destroy_func */);
+	WatchData.changed = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL /* value_destroy_func */);
+	WatchData.cancellable = g_cancellable_new();
+
+	folders = g_strsplit(interface_settings_get_watch_folders(), " ", -1);
+
+	for (i = 0; folders[i] != NULL; i++)
+	{
+		if (*folders[i] != '\0')
+		{
+			interface_watch_walk(folders[i]);
+		}
+	}
+
+	g_strfreev(folders);
+
+	// Rescan folders without change notifications (see note [5] at module description)
+	if (interface_settings_get_rescan_interval() > 0)
+	{
+		WatchData.rescan_id = g_timeout_add_seconds_full(G_PRIORITY_LOW, interface_settings_get_rescan_interval() * 60,
+		                                                 interface_watch_rescan_timeout_cb, NULL /* data */, NULL /* notify */);
+	}
+}
+
+/* CONSTRUCTORS END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+// Start watching the folder of @uri and remember it for the next time
+void
+interface_watch_add_folder(const gchar *uri)
+{
+	const gchar *current;
+	gchar **folders;
+	gchar *value;
+
+	g_return_if_fail(uri != NULL);
+	g_return_if_fail(WatchData.monitors != NULL);
+
+	current = interface_settings_get_watch_folders();
+	folders = g_strsplit(current, " ", -1);
+
+	if (!g_strv_contains((const gchar * const *) folders, uri))
+	{
+		value = (*current == '\0') ? g_strdup(uri) : g_strjoin(" ", current, uri, NULL /* terminator */);
+		interface_settings_set_watch_folders(value);
+		wf_settings_write();
+		g_free(value);
+	}
+
+	g_strfreev(folders);
+
+	interface_watch_walk(uri);
+}
+
+// Stop watching all folders
+void
+interface_watch_clear(void)
+{
+	g_return_if_fail(WatchData.monitors != NULL);
+
+	interface_settings_set_watch_folders("");
+	wf_settings_write();
+
+	// Stop finding directories and start over with a new cancellable
+	g_cancellable_cancel(WatchData.cancellable);
+	g_object_unref(WatchData.cancellable);
+	WatchData.cancellable = g_cancellable_new();
+
+	g_hash_table_remove_all(WatchData.monitors);
+	g_hash_table_remove_all(WatchData.changes);
+	g_hash_table_remove_all(WatchData.changed);
+
+	if (WatchData.timeout_id != 0)
+	{
+		g_source_remove(WatchData.timeout_id);
+		WatchData.timeout_id = 0;
+	}
+}
+
+// Compare the watched folders with the library in the background (see note [5] at module description)
+gboolean
+interface_watch_rescan(void)
+{
+	WatchRescan *rescan;
+	GThread *thread;
+	WfSong *song;
+	gint rate;
+
+	g_return_val_if_fail(WatchData.monitors != NULL, FALSE);
+
+	if (WatchData.rescanning || *interface_settings_get_watch_folders() == '\0')
+	{
+		return FALSE;
+	}
+
+	rate = interface_settings_get_rescan_rate();
+
+	rescan = g_new0(WatchRescan, 1);
+	rescan->roots = g_strsplit(interface_settings_get_watch_folders(), " ", -1);
+	rescan->rate = (rate > 0) ? rate : G_MAXINT;
+	rescan->cancellable = g_object_ref(WatchData.cancellable);
+	rescan->library = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL /* value_destroy_func */);
+	rescan->seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL /* value_destroy_func */);
+	rescan->failed = g_ptr_array_new_with_free_func(g_free);
+	rescan->unlisted = g_ptr_array_new_with_free_func(g_free);
+	rescan->changes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL /* value_destroy_func */);
+
+	// The library is not thread-safe, so the thread gets a copy of the URIs
+	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
+	{
+		if (wf_song_get_uri(song) != NULL)
+		{
+			g_hash_table_add(rescan->library, g_strdup(wf_song_get_uri(song)));
+		}
+	}
+
+	WatchData.rescanning = TRUE;
+
+	thread = g_thread_new("rescan", interface_watch_rescan_thread, rescan);
+	g_thread_unref(thread);
+
+	return TRUE;
+}
+
+// Amount of directories that are being watched
+guint
+interface_watch_get_folder_count(void)
+{
+	return (WatchData.monitors == NULL) ? 0 : g_hash_table_size(WatchData.monitors);
+}
+
+// The metadata of all songs has been read again, so no changed file is left (see note [2] at module description)
+void
+interface_watch_forget_changed(void)
+{
+	if (WatchData.changed != NULL)
+	{
+		g_hash_table_remove_all(WatchData.changed);
+	}
+}
+
+/* MODULE FUNCTIONS END */
+
+/* MODULE UTILITIES BEGIN */
+
+// Find the directories in the folder of @uri and monitor them
+static void
+interface_watch_walk(const gchar *uri)
+{
+	GTask *task;
+
+	task = g_task_new(NULL /* source_object */, WatchData.cancellable, interface_watch_walk_cb, NULL /* callback_data */);
+	g_task_set_task_data(task, g_strdup(uri), g_free);
+	g_task_run_in_thread(task, interface_watch_walk_thread);
+	g_object_unref(task);
+}
+
+static void
+interface_watch_walk_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+	GFileEnumerator *enumerator;
+	GFileInfo *info;
+	GHashTable *seen;
+	GPtrArray *dirs;
+	GQueue pending = G_QUEUE_INIT;
+	GFile *dir, *child;
+	const gchar *id;
+	gint depth;
+
+	dirs = g_ptr_array_new_with_free_func(g_free);
+	seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL /* value_destroy_func */);
+
+	g_queue_push_tail(&pending, g_file_new_for_uri(task_data));
+
+	while ((dir = g_queue_pop_head(&pending)) != NULL)
+	{
+		enumerator = NULL;
+
+		if (!g_cancellable_is_cancelled(cancellable))
+		{
+			enumerator = g_file_enumerate_children(dir, WATCH_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, cancellable, NULL /* error */);
+		}
+
+		if (enumerator != NULL)
+		{
+			g_ptr_array_add(dirs, g_file_get_uri(dir));
+
+			depth = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(dir), WATCH_DEPTH_KEY)) + 1;
+
+			while ((info = g_file_enumerator_next_file(enumerator, cancellable, NULL /* error */)) != NULL)
+			{
+				id = g_file_info_get_attribute_string(info, G_FILE_ATTRIBUTE_ID_FILE);
+
+				// Walk every directory once, even if symbolic links point to it (see note [7] at module description)
+				if (g_file_info_get_file_type(info) == G_FILE_TYPE_DIRECTORY &&
+				    !g_file_info_get_is_hidden(info) &&
+				    ((id == NULL && depth <= WATCH_MAX_DEPTH) || (id != NULL && !g_hash_table_contains(seen, id))))
+				{
+					if (id != NULL)
+					{
+						g_hash_table_add(seen, g_strdup(id));
+					}
+
+					child = g_file_enumerator_get_child(enumerator, info);
+					g_object_set_data(G_OBJECT(child), WATCH_DEPTH_KEY, GINT_TO_POINTER(depth));
+					g_queue_push_tail(&pending, child);
+				}
+
+				g_object_unref(info);
+			}
+
+			g_object_unref(enumerator);
+		}
+
+		g_object_unref(dir);
+	}
+
+	g_hash_table_destroy(seen);
+
+	g_task_return_pointer(task, dirs, (GDestroyNotify) g_ptr_array_unref);
+}
+
+static void
+interface_watch_walk_cb(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+	GPtrArray *dirs;
+	GError *error = NULL;
+	guint i;
+
+	dirs = g_task_propagate_pointer(G_TASK(result), &error);
+
+	if (dirs == NULL)
+	{
+		if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		{
+			g_warning("Failed to find directories to watch: %s", error->message);
+		}
+
+		g_clear_error(&error);
+
+		return;
+	}
+
+	// Not cancelled, so still watching
+	for (i = 0; i < dirs->len; i++)
+	{
+		interface_watch_monitor(g_ptr_array_index(dirs, i));
+	}
+
+	g_debug("Watching %u directories", g_hash_table_size(WatchData.monitors));
+
+	g_ptr_array_unref(dirs);
+}
+
+static void
+interface_watch_monitor(const gchar *uri)
+{
+	GFileMonitor *monitor;
+	GError *error = NULL;
+	GFile *dir;
+
+	if (g_hash_table_contains(WatchData.monitors, uri))
+	{
+		return;
+	}
+
+	dir = g_file_new_for_uri(uri);
+	monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_WATCH_MOVES, NULL /* cancellable */, &error);
+	g_object_unref(dir);
+
+	if (monitor == NULL)
+	{
+		// Most likely the limit of inotify watches has been reached
+		g_warning("Failed to watch %s: %s", uri, error->message);
+		g_error_free(error);
+
+		return;
+	}
+
+	g_signal_connect(monitor, "changed", G_CALLBACK(interface_watch_changed_cb), NULL /* user_data */);
+	g_hash_table_insert(WatchData.monitors, g_strdup(uri), monitor);
+}
+
+// Stop monitoring the directory of @uri and every directory in it; Returns %FALSE if @uri was not a monitored directory
+static gboolean
+interface_watch_unmonitor(const gchar *uri)
+{
+	GHashTableIter iter;
+	GPtrArray *prefixes;
+	gpointer key, monitor;
+
+	// Most deleted files are no directory at all, so don't go through the monitors for them
+	if (!g_hash_table_contains(WatchData.monitors, uri))
+	{
+		return FALSE;
+	}
+
+	prefixes = g_ptr_array_new_with_free_func(g_free);
+	g_ptr_array_add(prefixes, g_strconcat(uri, "/", NULL /* terminator */));
+
+	g_hash_table_iter_init(&iter, WatchData.monitors);
+
+	while (g_hash_table_iter_next(&iter, &key, &monitor))
+	{
+		if (g_strcmp0(key, uri) == 0 || interface_watch_has_prefix(key, prefixes))
+		{
+			g_file_monitor_cancel(monitor);
+			g_hash_table_iter_remove(&iter);
+		}
+	}
+
+	g_ptr_array_unref(prefixes);
+
+	return TRUE;
+}
+
+static void
+interface_watch_changed_cb(GFileMonitor *monitor, GFile *file, GFile *other_file, GFileMonitorEvent event_type, gpointer user_data)
+{
+	WatchChange change;
+	GFileType type;
+	gchar *uri;
+
+	switch (event_type)
+	{
+		case G_FILE_MONITOR_EVENT_CREATED:
+		case G_FILE_MONITOR_EVENT_MOVED_IN:
+			type = g_file_query_file_type(file, G_FILE_QUERY_INFO_NONE, NULL /* cancellable */);
+
+			if (type == G_FILE_TYPE_DIRECTORY)
+			{
+				// Watch the new directory as well; The importer adds the files in it
+				uri = g_file_get_uri(file);
+				interface_watch_walk(uri);
+				g_free(uri);
+			}
+
+			interface_watch_record(file, WATCH_CHANGE_CREATED);
+			break;
+		case G_FILE_MONITOR_EVENT_DELETED:
+		case G_FILE_MONITOR_EVENT_MOVED_OUT:
+			// See note [3] at module description
+			uri = g_file_get_uri(file);
+			change = interface_watch_unmonitor(uri) ? WATCH_CHANGE_DELETED_DIRECTORY : WATCH_CHANGE_DELETED;
+			g_free(uri);
+
+			interface_watch_record(file, change);
+			break;
+		case G_FILE_MONITOR_EVENT_RENAMED:
+			// See notes [2] and [3] at module description
+			uri = g_file_get_uri(file);
+			change = interface_watch_unmonitor(uri) ? WATCH_CHANGE_DELETED_DIRECTORY : WATCH_CHANGE_DELETED;
+			g_free(uri);
+
+			interface_watch_record(file, change);
+
+			if (other_file != NULL)
+			{
+				interface_watch_changed_cb(monitor, other_file, NULL /* other_file */, G_FILE_MONITOR_EVENT_CREATED, user_data);
+			}
+			break;
+		case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+			interface_watch_record(file, WATCH_CHANGE_CHANGED);
+			break;
+		default:
+			// Attribute changes and the like don't matter
+			break;
+	}
+}
+
+// Remember the last change of @file (see note [1] at module description)
+static void
+interface_watch_record(GFile *file, WatchChange change)
+{
+	WatchChange previous;
+	gchar *basename, *uri;
+	gint64 now, waited;
+
+	basename = g_file_get_basename(file);
+
+	// Hidden files are never added, so only their removal can matter
+	if (basename != NULL && *basename == '.' && change != WATCH_CHANGE_DELETED && change != WATCH_CHANGE_DELETED_DIRECTORY)
+	{
+		g_free(basename);
+		return;
+	}
+
+	g_free(basename);
+
+	uri = g_file_get_uri(file);
+	previous = GPOINTER_TO_INT(g_hash_table_lookup(WatchData.changes, uri));
+
+	// A file that was just created is still new after writing to it
+	if (previous == WATCH_CHANGE_CREATED && change == WATCH_CHANGE_CHANGED)
+	{
+		change = WATCH_CHANGE_CREATED;
+	}
+
+	g_hash_table_insert(WatchData.changes, uri, GINT_TO_POINTER(change));
+
+	now = g_get_monotonic_time();
+
+	if (WatchData.timeout_id == 0)
+	{
+		WatchData.first_change = now;
+	}
+
+	// Don't let the first change wait longer than the maximum
+	waited = (now - WatchData.first_change) / 1000;
+	interface_watch_schedule((waited >= WATCH_MAX_DELAY_MS) ? 0 : MIN(WATCH_DELAY_MS, WATCH_MAX_DELAY_MS - waited));
+}
+
+static void
+interface_watch_schedule(guint delay)
+{
+	if (WatchData.timeout_id != 0)
+	{
+		g_source_remove(WatchData.timeout_id);
+	}
+
+	WatchData.timeout_id = g_timeout_add_full(G_PRIORITY_LOW, delay, interface_watch_process_cb, NULL /* data */, NULL /* notify */);
+}
+
+// Apply the collected changes to the library
+static gboolean
+interface_watch_process_cb(gpointer user_data)
+{
+	GHashTableIter iter;
+	GHashTable *changes, *songs, *gone;
+	GPtrArray *removed, *contained;
+	GSList *added = NULL;
+	gpointer key, value;
+	WfSong *song;
+	guint changed = 0;
+	guint i;
+
+	WatchData.timeout_id = 0;
+
+	changes = WatchData.changes;
+	WatchData.changes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL /* value_destroy_func */);
+
+	songs = g_hash_table_new(g_str_hash, g_str_equal);
+
+	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
+	{
+		if (wf_song_get_uri(song) != NULL)
+		{
+			g_hash_table_insert(songs, (gpointer) wf_song_get_uri(song), song);
+		}
+	}
+
+	removed = g_ptr_array_new_with_free_func(g_object_unref);
+	contained = g_ptr_array_new_with_free_func(g_object_unref);
+	gone = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	g_hash_table_iter_init(&iter, changes);
+
+	while (g_hash_table_iter_next(&iter, &key, &value))
+	{
+		song = g_hash_table_lookup(songs, key);
+
+		switch (GPOINTER_TO_INT(value))
+		{
+			case WATCH_CHANGE_DELETED:
+				if (song != NULL)
+				{
+					g_hash_table_add(gone, song);
+				}
+				break;
+			case WATCH_CHANGE_DELETED_DIRECTORY:
+				// See note [3] at module description
+				interface_relocate_collect_songs(key, contained);
+				break;
+			case WATCH_CHANGE_CREATED:
+			case WATCH_CHANGE_CHANGED:
+				// See note [2] at module description
+				if (song != NULL)
+				{
+					if (!g_hash_table_contains(WatchData.changed, key))
+					{
+						g_hash_table_add(WatchData.changed, g_strdup(key));
+						changed++;
+					}
+				}
+				else
+				{
+					added = g_slist_prepend(added, key);
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	for (i = 0; i < contained->len; i++)
+	{
+		g_hash_table_add(gone, g_ptr_array_index(contained, i));
+	}
+
+	// Every song once, even if both the song and its directory were deleted
+	g_hash_table_iter_init(&iter, gone);
+
+	while (g_hash_table_iter_next(&iter, &key, NULL /* value */))
+	{
+		g_ptr_array_add(removed, g_object_ref(key));
+		g_hash_table_remove(WatchData.changed, wf_song_get_uri(key));
+	}
+
+	g_debug("Handling %u changes on disk: %u removed, %u added, %u changed", g_hash_table_size(changes), removed->len, g_slist_length(added), changed);
+
+	if (removed->len > 0 && WatchData.remove_func != NULL)
+	{
+		WatchData.remove_func(removed);
+	}
+
+	// See note [2] at module description
+	if (changed > 0 && WatchData.changed_func != NULL)
+	{
+		WatchData.changed_func(g_hash_table_size(WatchData.changed));
+	}
+
+	// See note [4] at module description
+	if (added != NULL && WatchData.add_func != NULL && !WatchData.add_func(added))
+	{
+		// Keep what could not be done, unless something newer came in meanwhile
+		for (; added != NULL; added = g_slist_delete_link(added, added))
+		{
+			if (!g_hash_table_contains(WatchData.changes, added->data))
+			{
+				g_hash_table_insert(WatchData.changes, g_strdup(added->data), GINT_TO_POINTER(WATCH_CHANGE_CREATED));
+			}
+		}
+
+		interface_watch_schedule(WATCH_RETRY_MS);
+	}
+	else
+	{
+		g_slist_free(added);
+	}
+
+	g_ptr_array_unref(contained);
+	g_ptr_array_unref(removed);
+	g_hash_table_destroy(gone);
+	g_hash_table_destroy(songs);
+	g_hash_table_destroy(changes);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean
+interface_watch_has_prefix(const gchar *uri, GPtrArray *prefixes)
+{
+	guint i;
+
+	if (uri == NULL)
+	{
+		return FALSE;
+	}
+
+	for (i = 0; i < prefixes->len; i++)
+	{
+		if (g_str_has_prefix(uri, g_ptr_array_index(prefixes, i)))
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static gboolean
+interface_watch_rescan_timeout_cb(gpointer user_data)
+{
+	interface_watch_rescan();
+
+	return G_SOURCE_CONTINUE;
+}
+
+static gpointer
+interface_watch_rescan_thread(gpointer data)
+{
+	WatchRescan *rescan = data;
+	GHashTableIter iter;
+	GHashTable *dirs;
+	GQueue pending = G_QUEUE_INIT;
+	GFile *dir;
+	gpointer uri;
+	gint64 start;
+	gint checked = 0;
+	guint i;
+
+	// Stay out of the way of playback (see note [6] at module description)
+#ifdef __linux__
+	setpriority(PRIO_PROCESS, 0 /* calling thread */, 19);
+	syscall(SYS_ioprio_set, WATCH_IOPRIO_WHO_PROCESS, 0 /* calling thread */, WATCH_IOPRIO_CLASS_IDLE << WATCH_IOPRIO_CLASS_SHIFT);
+#endif
+
+	start = g_get_monotonic_time();
+
+	// Set of the id::file of every directory, to walk each once
+	dirs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL /* value_destroy_func */);
+
+	for (i = 0; rescan->roots[i] != NULL; i++)
+	{
+		if (*rescan->roots[i] != '\0')
+		{
+			g_queue_push_tail(&pending, g_file_new_for_uri(rescan->roots[i]));
+		}
+	}
+
+	while ((dir = g_queue_pop_head(&pending)) != NULL)
+	{
+		if (!g_cancellable_is_cancelled(rescan->cancellable))
+		{
+			interface_watch_rescan_dir(rescan, dir, &pending, dirs, start, &checked);
+		}
+
+		g_object_unref(dir);
+	}
+
+	g_hash_table_destroy(dirs);
+
+	// Songs in a listed directory that were not found are gone (see note [5] at module description)
+	g_hash_table_iter_init(&iter, rescan->library);
+
+	while (g_hash_table_iter_next(&iter, &uri, NULL /* value */) && !g_cancellable_is_cancelled(rescan->cancellable))
+	{
+		if (!g_hash_table_contains(rescan->seen, uri) &&
+		    interface_watch_has_root(uri, rescan->roots) &&
+		    !interface_watch_has_prefix(uri, rescan->failed) &&
+		    !interface_watch_has_prefix(uri, rescan->unlisted))
+		{
+			g_hash_table_insert(rescan->changes, g_strdup(uri), GINT_TO_POINTER(WATCH_CHANGE_DELETED));
+		}
+	}
+
+	g_debug("Rescanned %d files in %.1f seconds, %u differ from the library", checked, (g_get_monotonic_time() - start) / 1e6, g_hash_table_size(rescan->changes));
+
+	g_idle_add_full(G_PRIORITY_LOW, interface_watch_rescan_done_cb, rescan, NULL /* notify */);
+
+	return NULL;
+}
+
+// List @dir, queue the directories in it and compare the files in it with the library
+static void
+interface_watch_rescan_dir(WatchRescan *rescan, GFile *dir, GQueue *pending, GHashTable *dirs, gint64 start, gint *checked)
+{
+	GFileEnumerator *enumerator;
+	GFileInfo *info;
+	GError *error = NULL;
+	const gchar *id, *type;
+	gchar *uri;
+	GFile *child;
+	gint depth;
+
+	depth = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(dir), WATCH_DEPTH_KEY)) + 1;
+
+	enumerator = g_file_enumerate_children(dir, WATCH_RESCAN_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, rescan->cancellable, &error);
+
+	if (enumerator == NULL)
+	{
+		// Keep the songs in here; The share may just be unavailable right now
+		uri = g_file_get_uri(dir);
+		g_debug("Failed to rescan %s: %s", uri, error->message);
+		g_ptr_array_add(rescan->failed, g_strconcat(uri, "/", NULL /* terminator */));
+		g_free(uri);
+		g_error_free(error);
+
+		return;
+	}
+
+	while ((info = g_file_enumerator_next_file(enumerator, rescan->cancellable, &error)) != NULL)
+	{
+		child = g_file_enumerator_get_child(enumerator, info);
+
+		if (g_file_info_get_file_type(info) == G_FILE_TYPE_DIRECTORY)
+		{
+			id = g_file_info_get_attribute_string(info, G_FILE_ATTRIBUTE_ID_FILE);
+
+			// See note [7] at module description
+			if (!g_file_info_get_is_hidden(info) &&
+			    ((id == NULL && depth <= WATCH_MAX_DEPTH) || (id != NULL && !g_hash_table_contains(dirs, id))))
+			{
+				if (id != NULL)
+				{
+					g_hash_table_add(dirs, g_strdup(id));
+				}
+
+				g_object_set_data(G_OBJECT(child), WATCH_DEPTH_KEY, GINT_TO_POINTER(depth));
+				g_queue_push_tail(pending, g_object_ref(child));
+			}
+			else
+			{
+				// Songs in here may still exist, like behind a link to a directory that was listed elsewhere (see note [5] at module description)
+				uri = g_file_get_uri(child);
+				g_ptr_array_add(rescan->unlisted, g_strconcat(uri, "/", NULL /* terminator */));
+				g_free(uri);
+			}
+		}
+		else if (g_file_info_get_is_hidden(info))
+		{
+			// Hidden files are never added, but songs may have been added by hand
+			uri = g_file_get_uri(child);
+
+			if (g_hash_table_contains(rescan->library, uri))
+			{
+				g_hash_table_add(rescan->seen, uri);
+			}
+			else
+			{
+				g_free(uri);
+			}
+		}
+		else if (g_file_info_get_file_type(info) == G_FILE_TYPE_REGULAR)
+		{
+			uri = g_file_get_uri(child);
+
+			if (g_hash_table_contains(rescan->library, uri))
+			{
+				// Files without an entry are taken as they are (see note [5] at module description)
+				if (!interface_cache_seed(uri, info) && !interface_cache_is_unchanged(uri, info))
+				{
+					g_hash_table_insert(rescan->changes, g_strdup(uri), GINT_TO_POINTER(WATCH_CHANGE_CHANGED));
+				}
+
+				g_hash_table_add(rescan->seen, uri);
+			}
+			else
+			{
+				// Guessed by name only; Anything else would be refused by the importer anyway
+				type = g_file_info_get_attribute_string(info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
+
+				if (type != NULL && g_str_has_prefix(type, "audio/"))
+				{
+					g_hash_table_insert(rescan->changes, g_strdup(uri), GINT_TO_POINTER(WATCH_CHANGE_CREATED));
+				}
+
+				g_free(uri);
+			}
+
+			(*checked)++;
+			interface_watch_rescan_throttle(rescan, start, *checked);
+		}
+
+		g_object_unref(child);
+		g_object_unref(info);
+	}
+
+	if (error != NULL)
+	{
+		// Only part of the directory was listed, so nothing in it is known to be missing
+		uri = g_file_get_uri(dir);
+		g_debug("Failed to rescan %s: %s", uri, error->message);
+		g_ptr_array_add(rescan->failed, g_strconcat(uri, "/", NULL /* terminator */));
+		g_free(uri);
+		g_error_free(error);
+	}
+
+	g_object_unref(enumerator);
+}
+
+// Don't check more files per second than configured (see note [6] at module description)
+static void
+interface_watch_rescan_throttle(WatchRescan *rescan, gint64 start, gint checked)
+{
+	gint64 due;
+
+	due = start + (gint64) checked * G_USEC_PER_SEC / rescan->rate;
+
+	// Sleep in short steps, so cancelling doesn't have to wait long
+	while (g_get_monotonic_time() < due && !g_cancellable_is_cancelled(rescan->cancellable))
+	{
+		g_usleep(MIN(due - g_get_monotonic_time(), G_USEC_PER_SEC / 10));
+	}
+}
+
+static gboolean
+interface_watch_rescan_done_cb(gpointer user_data)
+{
+	WatchRescan *rescan = user_data;
+	GHashTableIter iter;
+	gpointer uri, change;
+
+	WatchData.rescanning = FALSE;
+
+	// Stopped watching in the meantime
+	if (g_cancellable_is_cancelled(rescan->cancellable))
+	{
+		interface_watch_rescan_free(rescan);
+		return G_SOURCE_REMOVE;
+	}
+
+	if (g_hash_table_size(rescan->changes) > 0)
+	{
+		// Reported changes are newer than what was found
+		g_hash_table_iter_init(&iter, rescan->changes);
+
+		while (g_hash_table_iter_next(&iter, &uri, &change))
+		{
+			if (!g_hash_table_contains(WatchData.changes, uri))
+			{
+				g_hash_table_insert(WatchData.changes, g_strdup(uri), change);
+			}
+		}
+
+		interface_watch_schedule(0);
+	}
+
+	interface_watch_rescan_free(rescan);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+interface_watch_rescan_free(WatchRescan *rescan)
+{
+	g_strfreev(rescan->roots);
+	g_object_unref(rescan->cancellable);
+	g_hash_table_destroy(rescan->library);
+	g_hash_table_destroy(rescan->seen);
+	g_ptr_array_unref(rescan->failed);
+	g_ptr_array_unref(rescan->unlisted);
+	g_hash_table_destroy(rescan->changes);
+	g_free(rescan);
+}
+
+// Whether @uri is in one of the folders of @roots
+static gboolean
+interface_watch_has_root(const gchar *uri, gchar **roots)
+{
+	gsize length;
+	guint i;
+
+	for (i = 0; roots[i] != NULL; i++)
+	{
+		length = strlen(roots[i]);
+
+		if (length > 0 && strncmp(uri, roots[i], length) == 0 && uri[length] == '/')
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* MODULE UTILITIES END */
+
+/* DESTRUCTORS BEGIN */
+
+void
+interface_watch_finalize(void)
+{
+	if (WatchData.monitors == NULL)
+	{
+		return;
+	}
+
+	if (WatchData.timeout_id != 0)
+	{
+		g_source_remove(WatchData.timeout_id);
+	}
+
+	if (WatchData.rescan_id != 0)
+	{
+		g_source_remove(WatchData.rescan_id);
+	}
+
+	// Walks and rescans that are still running find nothing to add their directories to
+	g_cancellable_cancel(WatchData.cancellable);
+	g_object_unref(WatchData.cancellable);
+
+	g_hash_table_destroy(WatchData.monitors);
+	g_hash_table_destroy(WatchData.changes);
+	g_hash_table_destroy(WatchData.changed);
+
+	WatchData = (WatchDetails) { 0 };
+}
+
+/* DESTRUCTORS END */
+
+/* END OF FILE */
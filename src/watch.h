@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * watch.h  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+#ifndef __WATCH__
+#define __WATCH__
+
+/* INCLUDES BEGIN */
+
+#include <glib.h>
+
+/* INCLUDES END */
+
+/* DEFINES BEGIN */
+/* DEFINES END */
+
+/* MODULE TYPES BEGIN */
+
+// Returns %FALSE if it can't be done right now, in which case it is tried again later
+typedef gboolean (*InterfaceWatchAddFunc)(GSList *uris);
+typedef void (*InterfaceWatchRemoveFunc)(GPtrArray *songs);
+typedef void (*InterfaceWatchChangedFunc)(guint amount);
+
+/* MODULE TYPES END */
+
+/* CONSTRUCTOR PROTOTYPES BEGIN */
+
+void interface_watch_init(InterfaceWatchAddFunc add_func, InterfaceWatchRemoveFunc remove_func, InterfaceWatchChangedFunc changed_func);
+
+/* CONSTRUCTOR PROTOTYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+void interface_watch_add_folder(const gchar *uri);
+void interface_watch_clear(void);
+gboolean interface_watch_rescan(void);
+guint interface_watch_get_folder_count(void);
+void interface_watch_forget_changed(void);
+
+/* FUNCTION PROTOTYPES END */
+
+/* DESTRUCTOR PROTOTYPES BEGIN */
+
+void interface_watch_finalize(void);
+
+/* DESTRUCTOR PROTOTYPES END */
+
+#endif /* __WATCH__ */
+
+/* END OF FILE */
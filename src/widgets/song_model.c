@@ -0,0 +1,1167 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * widgets/song_model.c  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+/*
+ * This module implements a GObject type that implements the GtkTreeModel
+ * interface for a flat list of songs.
+ *
+ * Unlike a GtkListStore or GtkTreeStore, this model does not copy any song
+ * information into its rows.  Each row only holds a reference to its WfSong
+ * and the status the interface has set for it, and the column values are
+ * fetched from the song when the tree view asks for them (which it only does
+ * for rows that are actually drawn).  Because of this, the interface only
+ * needs to tell the model when a song has changed, so it can emit the
+ * "row-changed" signal for that single row.
+ *
+ * Every row also keeps a small snapshot of the statistics of its song, so
+ * the model can tell which rows actually changed after the back-end updated
+ * the statistics of one or more songs, without emitting "row-changed" for
+ * every row.  The model also knows which columns are visible, so changes that
+ * only affect hidden columns do not cause any redraws at all.
+ *
+ * The rows are kept in a GSequence, so getting a row by its position and
+ * getting the position of a row are both O(log n).  A hash table maps every
+ * song to its row, making the look-up of a row for a song O(1).  Iters stay
+ * valid for as long as the row exists.
+ *
+ * Many rows can be removed or moved at once, which only emits a signal per
+ * removed row or a single "rows-reordered" for all moved rows.  The model is
+ * a drag source so rows can be dragged within the view, but the rows are
+ * moved by the receiver of the drop.
+ */
+
+// Library includes
+#include <glib.h>
+#include <glib-object.h>
+#include <gtk/gtk.h>
+#include <string.h>
+
+// Woofer core includes
+#include <woofer/song.h>
+#include <woofer/utils.h>
+
+// Module includes
+#include "widgets/song_model.h"
+
+// Dependency includes
+/*< none >*/
+
+// Resource includes
+/*< none >*/
+
+typedef struct _WidgetSongModelStats WidgetSongModelStats;
+typedef struct _WidgetSongModelRow WidgetSongModelRow;
+typedef struct _WidgetSongModelPosition WidgetSongModelPosition;
+
+// The statistics of a song as they were last seen by the model
+struct _WidgetSongModelStats
+{
+	gint rating;
+	gint score;
+	gint play_count;
+	gint skip_count;
+};
+
+// A single row of the model
+struct _WidgetSongModelRow
+{
+	WfSong *song;
+	gint status;
+
+	WidgetSongModelStats stats;
+};
+
+// A row together with its position, for operations on many rows at once
+struct _WidgetSongModelPosition
+{
+	GSequenceIter *seq_iter;
+	gint position;
+};
+
+// Private data structure that gets automatically allocated by GObject
+struct _WidgetSongModelPrivate
+{
+	gint stamp;
+
+	GSequence *rows;
+	GHashTable *index;
+
+	guint visible_columns;
+	gboolean last_played_timestamp;
+};
+
+/* BEGIN OF DEFINES (based on G_DEFINE_TYPE_WITH_CODE) */
+
+// Function prototypes
+static void widget_song_model_init(WidgetSongModel *self);
+static void widget_song_model_class_init(WidgetSongModelClass *klass);
+static void widget_song_model_tree_model_init(GtkTreeModelIface *iface);
+static void widget_song_model_drag_source_init(GtkTreeDragSourceIface *iface);
+static GType widget_song_model_get_type_once(void);
+
+// Statically allocated variables
+static gpointer widget_song_model_parent_class = NULL;
+static gint widget_song_model_private_offset;
+
+// Intern class initialization; GObject magic, it just works, don't bother
+static void
+widget_song_model_class_intern_init(gpointer klass)
+{
+	widget_song_model_parent_class = g_type_class_peek_parent(klass);
+
+	if (widget_song_model_private_offset != 0)
+	{
+		g_type_class_adjust_private_offset(klass, &widget_song_model_private_offset);
+	}
+
+	widget_song_model_class_init((WidgetSongModelClass *) klass);
+}
+
+// Get the private structure of this GObject instance
+static gpointer
+widget_song_model_get_instance_private(WidgetSongModel *self)
+{
+	return G_STRUCT_MEMBER_P(self, widget_song_model_private_offset);
+}
+
+// Make sure the GObject type is registered and return the GType value
+static GType
+widget_song_model_get_type_once(void)
+{
+	const GInterfaceInfo tree_model_info =
+	{
+		.interface_init = (GInterfaceInitFunc)(void (*) (void)) widget_song_model_tree_model_init,
+	};
+
+	const GInterfaceInfo drag_source_info =
+	{
+		.interface_init = (GInterfaceInitFunc)(void (*) (void)) widget_song_model_drag_source_init,
+	};
+
+	GType g_define_type_id = g_type_register_static_simple(G_TYPE_OBJECT,
+	                                                       g_intern_static_string("WidgetSongModel"),
+	                                                       sizeof(WidgetSongModelClass),
+	                                                       (GClassInitFunc)(void (*) (void)) widget_song_model_class_intern_init,
+	                                                       sizeof(WidgetSongModel),
+	                                                       (GInstanceInitFunc)(void (*) (void)) widget_song_model_init,
+	                                                       (GTypeFlags) 0);
+	{
+		{
+			widget_song_model_private_offset = g_type_add_instance_private(g_define_type_id,
+			                                                               sizeof(WidgetSongModelPrivate));
+		}
+		{
+			g_type_add_interface_static(g_define_type_id, GTK_TYPE_TREE_MODEL, &tree_model_info);
+		}
+		{
+			g_type_add_interface_static(g_define_type_id, GTK_TYPE_TREE_DRAG_SOURCE, &drag_source_info);
+		}
+	}
+	return g_define_type_id;
+}
+
+// Get this GObjects GType
+GType
+widget_song_model_get_type(void)
+{
+	static gsize static_g_define_type_id = 0;
+
+	if (g_once_init_enter(&static_g_define_type_id))
+	{
+		GType g_define_type_id = widget_song_model_get_type_once();
+		g_once_init_leave(&static_g_define_type_id, g_define_type_id);
+	}
+
+	return static_g_define_type_id;
+}
+
+/* END OF DEFINES */
+
+// Function prototypes of the GtkTreeModel implementation
+static GtkTreeModelFlags widget_song_model_get_flags(GtkTreeModel *tree_model);
+static gint widget_song_model_get_n_columns(GtkTreeModel *tree_model);
+static GType widget_song_model_get_column_type(GtkTreeModel *tree_model, gint index);
+static gboolean widget_song_model_get_iter(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreePath *path);
+static GtkTreePath * widget_song_model_get_path(GtkTreeModel *tree_model, GtkTreeIter *iter);
+static void widget_song_model_get_value(GtkTreeModel *tree_model, GtkTreeIter *iter, gint column, GValue *value);
+static gboolean widget_song_model_iter_next(GtkTreeModel *tree_model, GtkTreeIter *iter);
+static gboolean widget_song_model_iter_previous(GtkTreeModel *tree_model, GtkTreeIter *iter);
+static gboolean widget_song_model_iter_children(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent);
+static gboolean widget_song_model_iter_has_child(GtkTreeModel *tree_model, GtkTreeIter *iter);
+static gint widget_song_model_iter_n_children(GtkTreeModel *tree_model, GtkTreeIter *iter);
+static gboolean widget_song_model_iter_nth_child(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent, gint n);
+static gboolean widget_song_model_iter_parent(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *child);
+
+// Function prototypes of the GtkTreeDragSource implementation
+static gboolean widget_song_model_row_draggable(GtkTreeDragSource *drag_source, GtkTreePath *path);
+static gboolean widget_song_model_drag_data_get(GtkTreeDragSource *drag_source, GtkTreePath *path, GtkSelectionData *selection_data);
+static gboolean widget_song_model_drag_data_delete(GtkTreeDragSource *drag_source, GtkTreePath *path);
+
+static void widget_song_model_finalize(GObject *object);
+static void widget_song_model_row_free(gpointer data);
+static WidgetSongModelPosition * widget_song_model_get_positions(WidgetSongModel *model, GPtrArray *songs, guint *length);
+static gint widget_song_model_compare_positions(gconstpointer a, gconstpointer b, gpointer user_data);
+static guint widget_song_model_row_update_stats(WidgetSongModelRow *row);
+
+// The types of all columns, in order of #WidgetSongModelColumn
+static const GType *
+widget_song_model_get_column_types(void)
+{
+	static GType types[WIDGET_SONG_MODEL_N_COLUMNS] = { 0 };
+
+	if (types[0] == 0)
+	{
+		types[WIDGET_SONG_MODEL_COLUMN_STATUS] = G_TYPE_INT;
+		types[WIDGET_SONG_MODEL_COLUMN_URI] = G_TYPE_STRING;
+		types[WIDGET_SONG_MODEL_COLUMN_NAME] = G_TYPE_STRING;
+		types[WIDGET_SONG_MODEL_COLUMN_NUMBER] = G_TYPE_INT;
+		types[WIDGET_SONG_MODEL_COLUMN_TITLE] = G_TYPE_STRING;
+		types[WIDGET_SONG_MODEL_COLUMN_ARTIST] = G_TYPE_STRING;
+		types[WIDGET_SONG_MODEL_COLUMN_ALBUM] = G_TYPE_STRING;
+		types[WIDGET_SONG_MODEL_COLUMN_DURATION] = G_TYPE_STRING;
+		types[WIDGET_SONG_MODEL_COLUMN_RATING] = G_TYPE_INT;
+		types[WIDGET_SONG_MODEL_COLUMN_SCORE] = G_TYPE_INT;
+		types[WIDGET_SONG_MODEL_COLUMN_PLAYCOUNT] = G_TYPE_INT;
+		types[WIDGET_SONG_MODEL_COLUMN_SKIPCOUNT] = G_TYPE_INT;
+		types[WIDGET_SONG_MODEL_COLUMN_LASTPLAYED] = G_TYPE_STRING;
+		types[WIDGET_SONG_MODEL_COLUMN_SONGOBJ] = G_TYPE_OBJECT;
+	}
+
+	return types;
+}
+
+// Function that gets called on allocation of a GObject instance to initialize the class
+static void
+widget_song_model_class_init(WidgetSongModelClass *class)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS(class);
+
+	object_class->finalize = widget_song_model_finalize;
+}
+
+// Fill in the GtkTreeModel interface with our own functions
+static void
+widget_song_model_tree_model_init(GtkTreeModelIface *iface)
+{
+	iface->get_flags = widget_song_model_get_flags;
+	iface->get_n_columns = widget_song_model_get_n_columns;
+	iface->get_column_type = widget_song_model_get_column_type;
+	iface->get_iter = widget_song_model_get_iter;
+	iface->get_path = widget_song_model_get_path;
+	iface->get_value = widget_song_model_get_value;
+	iface->iter_next = widget_song_model_iter_next;
+	iface->iter_previous = widget_song_model_iter_previous;
+	iface->iter_children = widget_song_model_iter_children;
+	iface->iter_has_child = widget_song_model_iter_has_child;
+	iface->iter_n_children = widget_song_model_iter_n_children;
+	iface->iter_nth_child = widget_song_model_iter_nth_child;
+	iface->iter_parent = widget_song_model_iter_parent;
+}
+
+// Fill in the GtkTreeDragSource interface with our own functions
+static void
+widget_song_model_drag_source_init(GtkTreeDragSourceIface *iface)
+{
+	iface->row_draggable = widget_song_model_row_draggable;
+	iface->drag_data_get = widget_song_model_drag_data_get;
+	iface->drag_data_delete = widget_song_model_drag_data_delete;
+}
+
+// Function that gets called on allocation of a GObject instance to initialize any other object stuff
+static void
+widget_song_model_init(WidgetSongModel *model)
+{
+	WidgetSongModelPrivate *priv;
+
+	// Use our private container to store the rows
+	model->priv = priv = widget_song_model_get_instance_private(model);
+
+	priv->stamp = g_random_int();
+	priv->rows = g_sequence_new(widget_song_model_row_free);
+	priv->index = g_hash_table_new(g_direct_hash, g_direct_equal);
+	priv->visible_columns = WIDGET_SONG_MODEL_ALL_COLUMNS;
+}
+
+static void
+widget_song_model_finalize(GObject *object)
+{
+	WidgetSongModel *model = WIDGET_SONG_MODEL(object);
+	WidgetSongModelPrivate *priv = model->priv;
+
+	g_hash_table_destroy(priv->index);
+	g_sequence_free(priv->rows);
+
+	G_OBJECT_CLASS(widget_song_model_parent_class)->finalize(object);
+}
+
+static void
+widget_song_model_row_free(gpointer data)
+{
+	WidgetSongModelRow *row = data;
+
+	g_object_unref(row->song);
+
+	g_slice_free(WidgetSongModelRow, row);
+}
+
+/* GtkTreeModel implementation */
+
+static GtkTreeModelFlags
+widget_song_model_get_flags(GtkTreeModel *tree_model)
+{
+	return (GTK_TREE_MODEL_ITERS_PERSIST | GTK_TREE_MODEL_LIST_ONLY);
+}
+
+static gint
+widget_song_model_get_n_columns(GtkTreeModel *tree_model)
+{
+	return WIDGET_SONG_MODEL_N_COLUMNS;
+}
+
+static GType
+widget_song_model_get_column_type(GtkTreeModel *tree_model, gint index)
+{
+	g_return_val_if_fail(index >= 0 && index < WIDGET_SONG_MODEL_N_COLUMNS, G_TYPE_INVALID);
+
+	return widget_song_model_get_column_types()[index];
+}
+
+static gboolean
+widget_song_model_get_iter(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreePath *path)
+{
+	WidgetSongModelPrivate *priv = WIDGET_SONG_MODEL(tree_model)->priv;
+	gint index;
+
+	if (gtk_tree_path_get_depth(path) != 1)
+	{
+		return FALSE;
+	}
+
+	index = gtk_tree_path_get_indices(path)[0];
+
+	if (index < 0 || index >= g_sequence_get_length(priv->rows))
+	{
+		return FALSE;
+	}
+
+	iter->stamp = priv->stamp;
+	iter->user_data = g_sequence_get_iter_at_pos(priv->rows, index);
+
+	return TRUE;
+}
+
+static GtkTreePath *
+widget_song_model_get_path(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	WidgetSongModelPrivate *priv = WIDGET_SONG_MODEL(tree_model)->priv;
+	GtkTreePath *path;
+
+	g_return_val_if_fail(iter->stamp == priv->stamp, NULL);
+
+	if (g_sequence_iter_is_end(iter->user_data))
+	{
+		return NULL;
+	}
+
+	path = gtk_tree_path_new();
+	gtk_tree_path_append_index(path, g_sequence_iter_get_position(iter->user_data));
+
+	return path;
+}
+
+static void
+widget_song_model_get_value(GtkTreeModel *tree_model, GtkTreeIter *iter, gint column, GValue *value)
+{
+	WidgetSongModelPrivate *priv = WIDGET_SONG_MODEL(tree_model)->priv;
+	WidgetSongModelRow *row;
+	WfSong *song;
+
+	g_return_if_fail(iter->stamp == priv->stamp);
+	g_return_if_fail(column >= 0 && column < WIDGET_SONG_MODEL_N_COLUMNS);
+
+	row = g_sequence_get(iter->user_data);
+	song = row->song;
+
+	g_value_init(value, widget_song_model_get_column_types()[column]);
+
+	/*
+	 * The strings owned by the song are not copied; the cell renderers copy
+	 * them themselves and the value is unset right after that.  Numbers are
+	 * returned as-is, so the view can format them without allocating.
+	 */
+	switch (column)
+	{
+		case WIDGET_SONG_MODEL_COLUMN_STATUS:
+			g_value_set_int(value, row->status);
+			break;
+		case WIDGET_SONG_MODEL_COLUMN_URI:
+			g_value_set_static_string(value, wf_song_get_uri(song));
+			break;
+		case WIDGET_SONG_MODEL_COLUMN_NAME:
+			g_value_set_static_string(value, wf_song_get_name(song));
+			break;
+		case WIDGET_SONG_MODEL_COLUMN_NUMBER:
+			g_value_set_int(value, wf_song_get_track_number(song));
+			break;
+		case WIDGET_SONG_MODEL_COLUMN_TITLE:
+			g_value_set_static_string(value, wf_song_get_title(song));
+			break;
+		case WIDGET_SONG_MODEL_COLUMN_ARTIST:
+			g_value_set_static_string(value, wf_song_get_artist(song));
+			break;
+		case WIDGET_SONG_MODEL_COLUMN_ALBUM:
+			g_value_set_static_string(value, wf_song_get_album(song));
+			break;
+		case WIDGET_SONG_MODEL_COLUMN_DURATION:
+			g_value_take_string(value, wf_song_get_duration_string(song));
+			break;
+		case WIDGET_SONG_MODEL_COLUMN_RATING:
+			// The raw back-end rating (range 0-100)
+			g_value_set_int(value, wf_song_get_rating(song));
+			break;
+		case WIDGET_SONG_MODEL_COLUMN_SCORE:
+			// Round the float so it shows the right score in the interface
+			g_value_set_int(value, wf_utils_round(wf_song_get_score(song)));
+			break;
+		case WIDGET_SONG_MODEL_COLUMN_PLAYCOUNT:
+			g_value_set_int(value, wf_song_get_play_count(song));
+			break;
+		case WIDGET_SONG_MODEL_COLUMN_SKIPCOUNT:
+			g_value_set_int(value, wf_song_get_skip_count(song));
+			break;
+		case WIDGET_SONG_MODEL_COLUMN_LASTPLAYED:
+			if (model->priv->last_played_timestamp)
+			{
+				g_value_take_string(value, wf_song_get_played_on_as_string(song));
+			}
+			else
+			{
+				g_value_take_string(value, wf_song_get_last_played_as_string(song));
+			}
+			break;
+		case WIDGET_SONG_MODEL_COLUMN_SONGOBJ:
+			g_value_set_object(value, song);
+			break;
+		default:
+			break;
+	}
+}
+
+static gboolean
+widget_song_model_iter_next(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	WidgetSongModelPrivate *priv = WIDGET_SONG_MODEL(tree_model)->priv;
+
+	g_return_val_if_fail(iter->stamp == priv->stamp, FALSE);
+
+	iter->user_data = g_sequence_iter_next(iter->user_data);
+
+	if (g_sequence_iter_is_end(iter->user_data))
+	{
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+widget_song_model_iter_previous(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	WidgetSongModelPrivate *priv = WIDGET_SONG_MODEL(tree_model)->priv;
+
+	g_return_val_if_fail(iter->stamp == priv->stamp, FALSE);
+
+	if (g_sequence_iter_is_begin(iter->user_data))
+	{
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	iter->user_data = g_sequence_iter_prev(iter->user_data);
+
+	return TRUE;
+}
+
+static gboolean
+widget_song_model_iter_children(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent)
+{
+	WidgetSongModelPrivate *priv = WIDGET_SONG_MODEL(tree_model)->priv;
+
+	// This is a list, so only the root has children
+	if (parent != NULL || g_sequence_is_empty(priv->rows))
+	{
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	iter->stamp = priv->stamp;
+	iter->user_data = g_sequence_get_begin_iter(priv->rows);
+
+	return TRUE;
+}
+
+static gboolean
+widget_song_model_iter_has_child(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	return FALSE;
+}
+
+static gint
+widget_song_model_iter_n_children(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	WidgetSongModelPrivate *priv = WIDGET_SONG_MODEL(tree_model)->priv;
+
+	if (iter == NULL)
+	{
+		return g_sequence_get_length(priv->rows);
+	}
+
+	return 0;
+}
+
+static gboolean
+widget_song_model_iter_nth_child(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent, gint n)
+{
+	WidgetSongModelPrivate *priv = WIDGET_SONG_MODEL(tree_model)->priv;
+
+	if (parent != NULL || n < 0 || n >= g_sequence_get_length(priv->rows))
+	{
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	iter->stamp = priv->stamp;
+	iter->user_data = g_sequence_get_iter_at_pos(priv->rows, n);
+
+	return TRUE;
+}
+
+static gboolean
+widget_song_model_iter_parent(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *child)
+{
+	iter->stamp = 0;
+
+	return FALSE;
+}
+
+/* GtkTreeDragSource implementation */
+
+static gboolean
+widget_song_model_row_draggable(GtkTreeDragSource *drag_source, GtkTreePath *path)
+{
+	return TRUE;
+}
+
+// The receiver moves the rows itself, so only tell which row is being dragged
+static gboolean
+widget_song_model_drag_data_get(GtkTreeDragSource *drag_source, GtkTreePath *path, GtkSelectionData *selection_data)
+{
+	gchar *str;
+
+	if (gtk_tree_set_row_drag_data(selection_data, GTK_TREE_MODEL(drag_source), path))
+	{
+		return TRUE;
+	}
+
+	str = gtk_tree_path_to_string(path);
+	gtk_selection_data_set(selection_data, gtk_selection_data_get_target(selection_data), 8, (const guchar *) str, strlen(str));
+	g_free(str);
+
+	return TRUE;
+}
+
+// Rows are only ever moved, never deleted by dragging them
+static gboolean
+widget_song_model_drag_data_delete(GtkTreeDragSource *drag_source, GtkTreePath *path)
+{
+	return FALSE;
+}
+
+/* Public functions */
+
+// Creates a new, empty song model
+WidgetSongModel *
+widget_song_model_new(void)
+{
+	return WIDGET_SONG_MODEL(g_object_new(WIDGET_TYPE_SONG_MODEL, NULL));
+}
+
+// Add a row for @song with status @status at the end of the model
+void
+widget_song_model_append(WidgetSongModel *model, WfSong *song, gint status)
+{
+	WidgetSongModelPrivate *priv;
+	WidgetSongModelRow *row;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+
+	g_return_if_fail(WIDGET_IS_SONG_MODEL(model));
+	g_return_if_fail(WF_IS_SONG(song));
+
+	priv = model->priv;
+
+	if (g_hash_table_contains(priv->index, song))
+	{
+		g_warning("Song is already present in the model");
+		return;
+	}
+
+	row = g_slice_new0(WidgetSongModelRow);
+	row->song = g_object_ref(song);
+	row->status = status;
+	widget_song_model_row_update_stats(row);
+
+	iter.stamp = priv->stamp;
+	iter.user_data = g_sequence_append(priv->rows, row);
+	g_hash_table_insert(priv->index, song, iter.user_data);
+
+	path = widget_song_model_get_path(GTK_TREE_MODEL(model), &iter);
+	gtk_tree_model_row_inserted(GTK_TREE_MODEL(model), path, &iter);
+	gtk_tree_path_free(path);
+}
+
+// Remove the row of @song from the model
+void
+widget_song_model_remove(WidgetSongModel *model, WfSong *song)
+{
+	WidgetSongModelPrivate *priv;
+	GSequenceIter *seq_iter;
+	GtkTreePath *path;
+
+	g_return_if_fail(WIDGET_IS_SONG_MODEL(model));
+
+	priv = model->priv;
+
+	seq_iter = g_hash_table_lookup(priv->index, song);
+
+	if (seq_iter == NULL)
+	{
+		return;
+	}
+
+	path = gtk_tree_path_new();
+	gtk_tree_path_append_index(path, g_sequence_iter_get_position(seq_iter));
+
+	// Removing the row also releases the reference to the song
+	g_hash_table_remove(priv->index, song);
+	g_sequence_remove(seq_iter);
+
+	gtk_tree_model_row_deleted(GTK_TREE_MODEL(model), path);
+	gtk_tree_path_free(path);
+}
+
+// Remove the rows of all @songs in one go; Returns the amount of rows removed
+gint
+widget_song_model_remove_songs(WidgetSongModel *model, GPtrArray *songs)
+{
+	WidgetSongModelPrivate *priv;
+	WidgetSongModelPosition *removals;
+	GtkTreePath *path;
+	guint i, n;
+	gint removed = 0;
+
+	g_return_val_if_fail(WIDGET_IS_SONG_MODEL(model), 0);
+	g_return_val_if_fail(songs != NULL, 0);
+
+	priv = model->priv;
+
+	removals = widget_song_model_get_positions(model, songs, &n);
+
+	path = gtk_tree_path_new_first();
+
+	// Remove the last row first, so the positions of the other rows stay the same
+	for (i = n; i-- > 0;)
+	{
+		gtk_tree_path_get_indices(path)[0] = removals[i].position;
+
+		// Removing the row also releases the reference to the song
+		g_hash_table_remove(priv->index, ((WidgetSongModelRow *) g_sequence_get(removals[i].seq_iter))->song);
+		g_sequence_remove(removals[i].seq_iter);
+
+		gtk_tree_model_row_deleted(GTK_TREE_MODEL(model), path);
+		removed++;
+	}
+
+	gtk_tree_path_free(path);
+	g_free(removals);
+
+	return removed;
+}
+
+// Move the rows of all @songs as one block right before (or after) the row of @sibling, keeping their order
+gboolean
+widget_song_model_move_songs(WidgetSongModel *model, GPtrArray *songs, WfSong *sibling, gboolean after)
+{
+	WidgetSongModelPrivate *priv;
+	WidgetSongModelPosition *moves;
+	GSequenceIter *anchor;
+	GHashTable *moving;
+	GtkTreePath *path;
+	gint *new_order;
+	gint length, insert, position, j = 0;
+	guint i, m = 0, n;
+	gboolean changed = FALSE;
+
+	g_return_val_if_fail(WIDGET_IS_SONG_MODEL(model), FALSE);
+	g_return_val_if_fail(songs != NULL, FALSE);
+
+	priv = model->priv;
+
+	anchor = (sibling == NULL) ? NULL : g_hash_table_lookup(priv->index, sibling);
+
+	g_return_val_if_fail(anchor != NULL, FALSE);
+
+	moves = widget_song_model_get_positions(model, songs, &n);
+	moving = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	for (i = 0; i < n; i++)
+	{
+		g_hash_table_add(moving, moves[i].seq_iter);
+	}
+
+	// The block goes right before the first row after the anchor that doesn't move itself
+	if (after)
+	{
+		anchor = g_sequence_iter_next(anchor);
+	}
+
+	while (!g_sequence_iter_is_end(anchor) && g_hash_table_contains(moving, anchor))
+	{
+		anchor = g_sequence_iter_next(anchor);
+	}
+
+	length = g_sequence_get_length(priv->rows);
+	insert = g_sequence_iter_get_position(anchor);
+	new_order = g_new(gint, length + 1);
+
+	// new_order[new_position] = old_position; Rows that don't move keep their order around the block
+	for (position = 0; position < insert; position++)
+	{
+		if (m < n && moves[m].position == position)
+		{
+			m++;
+		}
+		else
+		{
+			new_order[j++] = position;
+		}
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		new_order[j++] = moves[i].position;
+	}
+
+	for (position = insert; position < length; position++)
+	{
+		if (m < n && moves[m].position == position)
+		{
+			m++;
+		}
+		else
+		{
+			new_order[j++] = position;
+		}
+	}
+
+	for (position = 0; position < length && !changed; position++)
+	{
+		changed = (new_order[position] != position);
+	}
+
+	if (changed)
+	{
+		// Splice the rows in front of the anchor; The anchor itself never moves
+		for (i = 0; i < n; i++)
+		{
+			g_sequence_move(moves[i].seq_iter, anchor);
+		}
+
+		// Tell about all moved rows at once
+		path = gtk_tree_path_new();
+		gtk_tree_model_rows_reordered(GTK_TREE_MODEL(model), path, NULL /* iter */, new_order);
+		gtk_tree_path_free(path);
+	}
+
+	g_hash_table_destroy(moving);
+	g_free(new_order);
+	g_free(moves);
+
+	return changed;
+}
+
+gint
+widget_song_model_get_length(WidgetSongModel *model)
+{
+	g_return_val_if_fail(WIDGET_IS_SONG_MODEL(model), 0);
+
+	return g_sequence_get_length(model->priv->rows);
+}
+
+// Set @iter to the row of @song.  Returns %TRUE on success, %FALSE otherwise
+gboolean
+widget_song_model_get_iter_for_song(WidgetSongModel *model, WfSong *song, GtkTreeIter *iter)
+{
+	WidgetSongModelPrivate *priv;
+	GSequenceIter *seq_iter;
+
+	g_return_val_if_fail(WIDGET_IS_SONG_MODEL(model), FALSE);
+	g_return_val_if_fail(iter != NULL, FALSE);
+
+	priv = model->priv;
+
+	seq_iter = (song == NULL) ? NULL : g_hash_table_lookup(priv->index, song);
+
+	if (seq_iter == NULL)
+	{
+		return FALSE;
+	}
+
+	iter->stamp = priv->stamp;
+	iter->user_data = seq_iter;
+
+	return TRUE;
+}
+
+// Get the song of a row without increasing its reference count
+WfSong *
+widget_song_model_get_song(WidgetSongModel *model, GtkTreeIter *iter)
+{
+	WidgetSongModelRow *row;
+
+	g_return_val_if_fail(WIDGET_IS_SONG_MODEL(model), NULL);
+	g_return_val_if_fail(iter != NULL && iter->stamp == model->priv->stamp, NULL);
+
+	row = g_sequence_get(iter->user_data);
+
+	return row->song;
+}
+
+// Get the position of a row in the model
+gint
+widget_song_model_get_position(WidgetSongModel *model, GtkTreeIter *iter)
+{
+	g_return_val_if_fail(WIDGET_IS_SONG_MODEL(model), -1);
+	g_return_val_if_fail(iter != NULL && iter->stamp == model->priv->stamp, -1);
+
+	return g_sequence_iter_get_position(iter->user_data);
+}
+
+gint
+widget_song_model_get_status(WidgetSongModel *model, WfSong *song)
+{
+	GSequenceIter *seq_iter;
+	WidgetSongModelRow *row;
+
+	g_return_val_if_fail(WIDGET_IS_SONG_MODEL(model), 0);
+
+	seq_iter = g_hash_table_lookup(model->priv->index, song);
+
+	if (seq_iter == NULL)
+	{
+		return 0;
+	}
+
+	row = g_sequence_get(seq_iter);
+
+	return row->status;
+}
+
+// Set the status of a row; Only emits "row-changed" if the status is different
+gboolean
+widget_song_model_set_status(WidgetSongModel *model, WfSong *song, gint status)
+{
+	GtkTreeIter iter;
+	WidgetSongModelRow *row;
+
+	g_return_val_if_fail(WIDGET_IS_SONG_MODEL(model), FALSE);
+
+	if (!widget_song_model_get_iter_for_song(model, song, &iter))
+	{
+		return FALSE;
+	}
+
+	row = g_sequence_get(iter.user_data);
+
+	if (row->status == status)
+	{
+		return FALSE;
+	}
+
+	row->status = status;
+
+	widget_song_model_song_changed(model, song);
+
+	return TRUE;
+}
+
+// Let any views know that the information of @song has changed
+void
+widget_song_model_song_changed(WidgetSongModel *model, WfSong *song)
+{
+	GtkTreePath *path;
+	GtkTreeIter iter;
+
+	g_return_if_fail(WIDGET_IS_SONG_MODEL(model));
+
+	if (!widget_song_model_get_iter_for_song(model, song, &iter))
+	{
+		return;
+	}
+
+	path = widget_song_model_get_path(GTK_TREE_MODEL(model), &iter);
+	gtk_tree_model_row_changed(GTK_TREE_MODEL(model), path, &iter);
+	gtk_tree_path_free(path);
+}
+
+// Check if the statistics of @song changed and emit "row-changed" if they did
+gboolean
+widget_song_model_refresh_stats(WidgetSongModel *model, WfSong *song)
+{
+	GSequenceIter *seq_iter;
+	guint changed;
+
+	g_return_val_if_fail(WIDGET_IS_SONG_MODEL(model), FALSE);
+
+	seq_iter = (song == NULL) ? NULL : g_hash_table_lookup(model->priv->index, song);
+
+	if (seq_iter == NULL)
+	{
+		return FALSE;
+	}
+
+	changed = widget_song_model_row_update_stats(g_sequence_get(seq_iter));
+
+	return widget_song_model_columns_changed(model, song, changed);
+}
+
+// Check all rows for changed statistics; Returns the number of rows that changed
+gint
+widget_song_model_refresh_all_stats(WidgetSongModel *model)
+{
+	GSequenceIter *seq_iter;
+	WidgetSongModelRow *row;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	gint changed = 0;
+
+	g_return_val_if_fail(WIDGET_IS_SONG_MODEL(model), 0);
+
+	iter.stamp = model->priv->stamp;
+
+	for (seq_iter = g_sequence_get_begin_iter(model->priv->rows);
+	     !g_sequence_iter_is_end(seq_iter);
+	     seq_iter = g_sequence_iter_next(seq_iter))
+	{
+		row = g_sequence_get(seq_iter);
+
+		// Changes in hidden columns don't need a redraw
+		if ((widget_song_model_row_update_stats(row) & model->priv->visible_columns) != 0)
+		{
+			iter.user_data = seq_iter;
+
+			path = widget_song_model_get_path(GTK_TREE_MODEL(model), &iter);
+			gtk_tree_model_row_changed(GTK_TREE_MODEL(model), path, &iter);
+			gtk_tree_path_free(path);
+
+			changed++;
+		}
+	}
+
+	return changed;
+}
+
+// Take a new snapshot of the statistics of a row; Returns a mask of the columns that changed
+static guint
+widget_song_model_row_update_stats(WidgetSongModelRow *row)
+{
+	WidgetSongModelStats stats;
+	guint changed = 0;
+
+	stats.rating = wf_song_get_rating(row->song);
+	stats.score = wf_utils_round(wf_song_get_score(row->song));
+	stats.play_count = wf_song_get_play_count(row->song);
+	stats.skip_count = wf_song_get_skip_count(row->song);
+
+	if (stats.rating != row->stats.rating)
+	{
+		changed |= WIDGET_SONG_MODEL_COLUMN_MASK(WIDGET_SONG_MODEL_COLUMN_RATING);
+	}
+	if (stats.score != row->stats.score)
+	{
+		changed |= WIDGET_SONG_MODEL_COLUMN_MASK(WIDGET_SONG_MODEL_COLUMN_SCORE);
+	}
+	if (stats.play_count != row->stats.play_count)
+	{
+		// Playing a song also changes when it was last played
+		changed |= WIDGET_SONG_MODEL_COLUMN_MASK(WIDGET_SONG_MODEL_COLUMN_PLAYCOUNT);
+		changed |= WIDGET_SONG_MODEL_COLUMN_MASK(WIDGET_SONG_MODEL_COLUMN_LASTPLAYED);
+	}
+	if (stats.skip_count != row->stats.skip_count)
+	{
+		changed |= WIDGET_SONG_MODEL_COLUMN_MASK(WIDGET_SONG_MODEL_COLUMN_SKIPCOUNT);
+		changed |= WIDGET_SONG_MODEL_COLUMN_MASK(WIDGET_SONG_MODEL_COLUMN_LASTPLAYED);
+	}
+
+	row->stats = stats;
+
+	return changed;
+}
+
+// Let the model know whether a column is shown, so changes to it can be ignored when it isn't
+void
+widget_song_model_set_column_visible(WidgetSongModel *model, gint column, gboolean visible)
+{
+	g_return_if_fail(WIDGET_IS_SONG_MODEL(model));
+	g_return_if_fail(column >= 0 && column < WIDGET_SONG_MODEL_N_COLUMNS);
+
+	// The status is always needed
+	if (column == WIDGET_SONG_MODEL_COLUMN_STATUS)
+	{
+		return;
+	}
+
+	if (visible)
+	{
+		model->priv->visible_columns |= WIDGET_SONG_MODEL_COLUMN_MASK(column);
+	}
+	else
+	{
+		model->priv->visible_columns &= ~WIDGET_SONG_MODEL_COLUMN_MASK(column);
+	}
+}
+
+gboolean
+widget_song_model_get_column_visible(WidgetSongModel *model, gint column)
+{
+	g_return_val_if_fail(WIDGET_IS_SONG_MODEL(model), FALSE);
+	g_return_val_if_fail(column >= 0 && column < WIDGET_SONG_MODEL_N_COLUMNS, FALSE);
+
+	return (model->priv->visible_columns & WIDGET_SONG_MODEL_COLUMN_MASK(column)) != 0;
+}
+
+// Show when a song was last played as a timestamp instead of as the time since
+void
+widget_song_model_set_last_played_timestamp(WidgetSongModel *model, gboolean timestamp)
+{
+	GSequenceIter *seq_iter;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+
+	g_return_if_fail(WIDGET_IS_SONG_MODEL(model));
+
+	if (model->priv->last_played_timestamp == timestamp)
+	{
+		return;
+	}
+
+	model->priv->last_played_timestamp = timestamp;
+
+	if (!widget_song_model_get_column_visible(model, WIDGET_SONG_MODEL_COLUMN_LASTPLAYED))
+	{
+		return;
+	}
+
+	iter.stamp = model->priv->stamp;
+
+	for (seq_iter = g_sequence_get_begin_iter(model->priv->rows);
+	     !g_sequence_iter_is_end(seq_iter);
+	     seq_iter = g_sequence_iter_next(seq_iter))
+	{
+		iter.user_data = seq_iter;
+
+		path = widget_song_model_get_path(GTK_TREE_MODEL(model), &iter);
+		gtk_tree_model_row_changed(GTK_TREE_MODEL(model), path, &iter);
+		gtk_tree_path_free(path);
+	}
+}
+
+gboolean
+widget_song_model_get_last_played_timestamp(WidgetSongModel *model)
+{
+	g_return_val_if_fail(WIDGET_IS_SONG_MODEL(model), FALSE);
+
+	return model->priv->last_played_timestamp;
+}
+
+// Emit "row-changed" for @song, but only if any of the @columns (a mask) is visible
+gboolean
+widget_song_model_columns_changed(WidgetSongModel *model, WfSong *song, guint columns)
+{
+	g_return_val_if_fail(WIDGET_IS_SONG_MODEL(model), FALSE);
+
+	if ((columns & model->priv->visible_columns) == 0)
+	{
+		return FALSE;
+	}
+
+	widget_song_model_song_changed(model, song);
+
+	return TRUE;
+}
+
+// Look up the rows of @songs, sorted by position and without duplicates; Free returned value
+static WidgetSongModelPosition *
+widget_song_model_get_positions(WidgetSongModel *model, GPtrArray *songs, guint *length)
+{
+	WidgetSongModelPosition *positions;
+	GSequenceIter *seq_iter;
+	guint i, n = 0;
+
+	positions = g_new(WidgetSongModelPosition, songs->len + 1);
+
+	for (i = 0; i < songs->len; i++)
+	{
+		seq_iter = g_hash_table_lookup(model->priv->index, g_ptr_array_index(songs, i));
+
+		if (seq_iter != NULL)
+		{
+			positions[n].seq_iter = seq_iter;
+			positions[n].position = g_sequence_iter_get_position(seq_iter);
+			n++;
+		}
+	}
+
+	g_qsort_with_data(positions, n, sizeof(WidgetSongModelPosition), widget_song_model_compare_positions, NULL /* user_data */);
+
+	// Drop songs that were given more than once
+	for (i = 0, *length = 0; i < n; i++)
+	{
+		if (*length == 0 || positions[i].position != positions[*length - 1].position)
+		{
+			positions[(*length)++] = positions[i];
+		}
+	}
+
+	return positions;
+}
+
+static gint
+widget_song_model_compare_positions(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	gint position_a = ((const WidgetSongModelPosition *) a)->position;
+	gint position_b = ((const WidgetSongModelPosition *) b)->position;
+
+	return (position_a > position_b) - (position_a < position_b);
+}
+
+/* END OF FILE */
@@ -0,0 +1,111 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * widgets/song_model.h  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+#ifndef __WIDGETS_SONG_MODEL__
+#define __WIDGETS_SONG_MODEL__
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gtk/gtk.h>
+
+#include <woofer/song.h>
+
+#define WIDGET_TYPE_SONG_MODEL (widget_song_model_get_type())
+#define WIDGET_SONG_MODEL(ptr) G_TYPE_CHECK_INSTANCE_CAST(ptr, widget_song_model_get_type(), WidgetSongModel)
+#define WIDGET_SONG_MODEL_CLASS(ptr) G_TYPE_CHECK_CLASS_CAST(ptr, widget_song_model_get_type(), WidgetSongModelClass)
+#define WIDGET_IS_SONG_MODEL(ptr) G_TYPE_CHECK_INSTANCE_TYPE(ptr, widget_song_model_get_type())
+#define WIDGET_IS_SONG_MODEL_CLASS(ptr) G_TYPE_CHECK_CLASS_TYPE(ptr, widget_song_model_get_type())
+#define WIDGET_SONG_MODEL_GET_CLASS(ptr) G_TYPE_INSTANCE_GET_CLASS(ptr, widget_song_model_get_type(), WidgetSongModelClass)
+
+typedef struct _WidgetSongModel WidgetSongModel;
+typedef struct _WidgetSongModelClass WidgetSongModelClass;
+typedef struct _WidgetSongModelPrivate WidgetSongModelPrivate;
+
+typedef enum _WidgetSongModelColumn WidgetSongModelColumn;
+
+enum _WidgetSongModelColumn
+{
+	WIDGET_SONG_MODEL_COLUMN_STATUS,
+	WIDGET_SONG_MODEL_COLUMN_URI,
+	WIDGET_SONG_MODEL_COLUMN_NAME,
+	WIDGET_SONG_MODEL_COLUMN_NUMBER,
+	WIDGET_SONG_MODEL_COLUMN_TITLE,
+	WIDGET_SONG_MODEL_COLUMN_ARTIST,
+	WIDGET_SONG_MODEL_COLUMN_ALBUM,
+	WIDGET_SONG_MODEL_COLUMN_DURATION,
+	WIDGET_SONG_MODEL_COLUMN_RATING,
+	WIDGET_SONG_MODEL_COLUMN_SCORE,
+	WIDGET_SONG_MODEL_COLUMN_PLAYCOUNT,
+	WIDGET_SONG_MODEL_COLUMN_SKIPCOUNT,
+	WIDGET_SONG_MODEL_COLUMN_LASTPLAYED,
+	WIDGET_SONG_MODEL_COLUMN_SONGOBJ,
+	WIDGET_SONG_MODEL_N_COLUMNS
+};
+
+// Mask bit of a single column, used to tell which columns have changed
+#define WIDGET_SONG_MODEL_COLUMN_MASK(column) (1u << (column))
+#define WIDGET_SONG_MODEL_ALL_COLUMNS (WIDGET_SONG_MODEL_COLUMN_MASK(WIDGET_SONG_MODEL_N_COLUMNS) - 1)
+
+struct _WidgetSongModel
+{
+	/*< public >*/
+	GObject parent_instance;
+
+	/*< private >*/
+	WidgetSongModelPrivate *priv;
+};
+
+struct _WidgetSongModelClass
+{
+	GObjectClass parent_class;
+};
+
+GType widget_song_model_get_type(void);
+
+WidgetSongModel * widget_song_model_new(void);
+
+void widget_song_model_append(WidgetSongModel *model, WfSong *song, gint status);
+void widget_song_model_remove(WidgetSongModel *model, WfSong *song);
+gint widget_song_model_remove_songs(WidgetSongModel *model, GPtrArray *songs);
+gboolean widget_song_model_move_songs(WidgetSongModel *model, GPtrArray *songs, WfSong *sibling, gboolean after);
+
+gint widget_song_model_get_length(WidgetSongModel *model);
+gboolean widget_song_model_get_iter_for_song(WidgetSongModel *model, WfSong *song, GtkTreeIter *iter);
+WfSong * widget_song_model_get_song(WidgetSongModel *model, GtkTreeIter *iter);
+gint widget_song_model_get_position(WidgetSongModel *model, GtkTreeIter *iter);
+
+gint widget_song_model_get_status(WidgetSongModel *model, WfSong *song);
+gboolean widget_song_model_set_status(WidgetSongModel *model, WfSong *song, gint status);
+
+void widget_song_model_song_changed(WidgetSongModel *model, WfSong *song);
+gboolean widget_song_model_refresh_stats(WidgetSongModel *model, WfSong *song);
+gint widget_song_model_refresh_all_stats(WidgetSongModel *model);
+
+void widget_song_model_set_column_visible(WidgetSongModel *model, gint column, gboolean visible);
+gboolean widget_song_model_get_column_visible(WidgetSongModel *model, gint column);
+gboolean widget_song_model_columns_changed(WidgetSongModel *model, WfSong *song, guint columns);
+
+void widget_song_model_set_last_played_timestamp(WidgetSongModel *model, gboolean timestamp);
+gboolean widget_song_model_get_last_played_timestamp(WidgetSongModel *model);
+
+#endif /* __WIDGETS_SONG_MODEL__ */
+
+/* END OF FILE */
@@ -0,0 +1,235 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * writer.c  This file is part of Woofer GTK
+ * Copyright (C) 2022  Quico Augustijn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this program.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+/* INCLUDES BEGIN */
+
+// Library includes
+#include <glib.h>
+
+// Woofer core includes
+#include <woofer/library.h>
+
+// Module includes
+#include "writer.h"
+
+// Dependency includes
+/*< none >*/
+
+// Resource includes
+/*< none >*/
+
+/* INCLUDES END */
+
+/* DESCRIPTION BEGIN */
+
+/*
+ * This module writes the library file on behalf of the interface.  Instead
+ * of writing the library after every single change, the interface requests
+ * a write and this module performs it once no more requests have come in for
+ * a short while, so a burst of changes results in a single write.  Once the
+ * first request of a burst is a while ago, the library is written anyway, so
+ * a constant stream of changes can't postpone writing forever.
+ *
+ * Location specific notes:
+ * [1] The back-end serializes and writes the library itself, using data
+ *     that is owned by the main thread, so writing can't be moved to another
+ *     thread.  The write is done from a low priority source instead, so any
+ *     pending input and redraws are handled first.
+ * [2] A pending write must not get lost, so it is done right away when the
+ *     interface is shut down.
+ */
+
+/* DESCRIPTION END */
+
+/* DEFINES BEGIN */
+
+// Time without new requests after which the library is written
+#define WRITER_DELAY_MS 1500
+
+// Maximum time a request may wait before the library is written
+#define WRITER_MAX_DELAY_MS 10000
+
+/* DEFINES END */
+
+/* CUSTOM TYPES BEGIN */
+
+typedef struct _WriterDetails WriterDetails;
+
+struct _WriterDetails
+{
+	InterfaceWriterReportFunc report_func;
+
+	// Source that writes the library; 0 if none
+	guint timeout_id;
+	// Monotonic time of the first request since the last write
+	gint64 first_request;
+	// Whether there is a request that has not been written yet
+	gboolean pending;
+	// Argument for wf_library_write(); %TRUE if any request asked for it
+	gboolean force;
+};
+
+/* CUSTOM TYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+static gboolean interface_writer_timeout_cb(gpointer user_data);
+static gboolean interface_writer_write(void);
+
+/* FUNCTION PROTOTYPES END */
+
+/* GLOBAL VARIABLES BEGIN */
+
+static WriterDetails WriterData = { 0 };
+
+/* GLOBAL VARIABLES END */
+
+/* CONSTRUCTORS BEGIN */
+
+void
+interface_writer_init(InterfaceWriterReportFunc report_func)
+{
+	WriterData.report_func = report_func;
+}
+
+/* CONSTRUCTORS END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+// Ask for the library to be written soon; @force is passed on to wf_library_write()
+void
+interface_writer_request(gboolean force)
+{
+	gint64 now, waited;
+	guint delay;
+
+	now = g_get_monotonic_time();
+
+	if (!WriterData.pending)
+	{
+		WriterData.pending = TRUE;
+		WriterData.first_request = now;
+		WriterData.force = force;
+	}
+	else
+	{
+		WriterData.force |= force;
+	}
+
+	// Don't let the first request wait longer than the maximum
+	waited = (now - WriterData.first_request) / 1000;
+	delay = (waited >= WRITER_MAX_DELAY_MS) ? 0 : MIN(WRITER_DELAY_MS, WRITER_MAX_DELAY_MS - waited);
+
+	if (WriterData.timeout_id != 0)
+	{
+		g_source_remove(WriterData.timeout_id);
+	}
+
+	// See note [1] at module description
+	WriterData.timeout_id = g_timeout_add_full(G_PRIORITY_LOW, delay, interface_writer_timeout_cb, NULL /* data */, NULL /* notify */);
+}
+
+// Write the library right now if there is anything to write; Returns %FALSE if writing failed
+gboolean
+interface_writer_flush(void)
+{
+	if (WriterData.timeout_id != 0)
+	{
+		g_source_remove(WriterData.timeout_id);
+		WriterData.timeout_id = 0;
+	}
+
+	if (!WriterData.pending)
+	{
+		return TRUE;
+	}
+
+	return interface_writer_write();
+}
+
+gboolean
+interface_writer_is_pending(void)
+{
+	return WriterData.pending;
+}
+
+/* MODULE FUNCTIONS END */
+
+/* MODULE UTILITIES BEGIN */
+
+static gboolean
+interface_writer_timeout_cb(gpointer user_data)
+{
+	WriterData.timeout_id = 0;
+
+	interface_writer_write();
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean
+interface_writer_write(void)
+{
+	GTimer *timer;
+	gboolean force, success;
+
+	force = WriterData.force;
+
+	// Requests made from now on need another write
+	WriterData.pending = FALSE;
+	WriterData.force = FALSE;
+
+	timer = g_timer_new();
+
+	success = wf_library_write(force);
+
+	g_debug("Library %s in %.3f ms", success ? "written" : "failed to write", g_timer_elapsed(timer, NULL /* microseconds */) * 1000.0);
+	g_timer_destroy(timer);
+
+	if (!success)
+	{
+		g_warning("Failed to write library");
+	}
+
+	if (WriterData.report_func != NULL)
+	{
+		WriterData.report_func(success, force);
+	}
+
+	return success;
+}
+
+/* MODULE UTILITIES END */
+
+/* DESTRUCTORS BEGIN */
+
+void
+interface_writer_finalize(void)
+{
+	// Don't lose any changes (see note [2] at module description)
+	interface_writer_flush();
+
+	WriterData = (WriterDetails) { 0 };
+}
+
+/* DESTRUCTORS END */
+
+/* END OF FILE */